@@ -162,12 +162,13 @@ class InstructionGenerator(CodeGenerator):
         header_file_src = self.flatten([
             self.generate_header_guard("INSTRUCTIONS", [
                 self.generate_local_includes(["interpreter.hxx"]),
-                self.generate_global_includes(["array", "cstdint", "variant"]),
+                self.generate_global_includes(["array", "cstdint", "string", "variant"]),
                 self.generate_namespace("VM", [
                     self.generate_struct("OpCodes", [
                         self.generate_opcode_enumerations(),
                     ]),
                     self.generate_instruction_keyword_array_define(),
+                    self.generate_operand_kind_table(),
                     self.generate_namespace("parameters", [
                         self.generate_parameter_list_types(),
                         self.generate_parameter_variant_alias(),
@@ -175,7 +176,10 @@ class InstructionGenerator(CodeGenerator):
                     self.generate_namespace("callbacks", [
                         self.generate_callback_declarations(),
                     ]),
-                    self.generate_vm_declarations()
+                    self.generate_vm_declarations(),
+                    self.generate_namespace("aot", [
+                        self.generate_aot_declarations(),
+                    ])
                 ])
             ])
         ])
@@ -184,7 +188,8 @@ class InstructionGenerator(CodeGenerator):
             self.generate_instruction_executor(),
             self.generate_instruction_keyword_array(),
             self.generate_parameter_parse_functions(),
-            self.generate_parameter_parser()
+            self.generate_parameter_parser(),
+            self.generate_aot_emitter()
         ])
 
         self.header_file.write(header_file_src)
@@ -222,7 +227,7 @@ class InstructionGenerator(CodeGenerator):
             parse_args = ["args." + name  + " = " + self.parse_functions[data_type] + "(buffer, pc);\n" for name, data_type in zip(pv.keys(), pv.values())]
 
             structs += """\n
-                void parse_parameters(
+                Trap parse_parameters(
                    MemoryBank::MemoryBuffer &buffer,
                    uint32_t &pc,
                    ParameterList<%s> &out
@@ -246,18 +251,45 @@ class InstructionGenerator(CodeGenerator):
             parse_args = ["""
                out.%s = %s(buffer, pc);
                pc += sizeof(out.%s);\n
-            """ % (name, self.parse_functions[data_type], name) for name, data_type in zip(pv.keys(), pv.values())]
+               %s
+            """ % (name, self.parse_functions[data_type], name, self.generate_register_check(name, data_type))
+                for name, data_type in zip(pv.keys(), pv.values())]
 
             structs += """\n
-                void VM::parameters::parse_parameters(MemoryBank::MemoryBuffer &buffer, uint32_t &pc, VM::parameters::ParameterList<%s> &out) {
+                Trap VM::parameters::parse_parameters(MemoryBank::MemoryBuffer &buffer, uint32_t &pc, VM::parameters::ParameterList<%s> &out) {
                     %s
+                    %s
+                    return Trap::NONE;
                 }
-            \n""" % (opcode, self.flatten(parse_args))
+            \n""" % (opcode, self.generate_bounds_check(pv), self.flatten(parse_args))
 
 
         return structs
 
 
+    ## The operands are only read once the whole instruction is known to be
+    ## inside of the memory, so the individual reads don't check anything.
+
+    def generate_bounds_check(self, args):
+        if len(args) == 0:
+            return ""
+        length = self.flatten(["sizeof(out." + name + ")" for name in args.keys()], separator=" + ")
+        return """\
+            if (pc + %s > buffer.size()) [[unlikely]] {
+                return Trap::INVALID_ADDRESS;
+            }
+        """ % length
+
+    def generate_register_check(self, name, data_type):
+        counts = {"reg" : "GP_REGS_32_COUNT", "fl_reg" : "FL_REGS_32_COUNT"}
+        if data_type not in counts:
+            return ""
+        return """\
+            if (out.%s >= MemoryBank::%s) [[unlikely]] {
+                return Trap::INVALID_REGISTER;
+            }
+        """ % (name, counts[data_type])
+
     def generate_parameter_variant_alias(self):
         return "using ParameterListAny = std::variant<\n%s\n>;" \
                 % self.flatten(["ParameterList<OpCodes::"+self.opcode_enums[x]+">\n "
@@ -286,7 +318,7 @@ class InstructionGenerator(CodeGenerator):
         for i in self.data["instructions"].keys():
             instruction_keyword_str_literals += "\t\"" + self.data["instructions"][i]["keyword"] + "\",\n"
 
-        return self.generate_array("const char*", keyword_count, "instruction_keywords", instruction_keyword_str_literals)
+        return self.generate_array("const char*", keyword_count, "VM::instruction_keywords", instruction_keyword_str_literals)
 
     def generate_instruction_keyword_array_define(self):
         keyword_count = len(self.data["instructions"].keys())
@@ -295,13 +327,111 @@ class InstructionGenerator(CodeGenerator):
         \n""" % keyword_count
         return source
 
+    operand_kinds = {
+        "reg" : "REGISTER",
+        "fl_reg" : "FLOAT_REGISTER",
+        "addr" : "ADDRESS",
+        "u8" : "U8",
+        "u16" : "U16",
+        "u32" : "U32",
+        "i8" : "I8",
+        "i16" : "I16",
+        "i32" : "I32",
+        "float" : "FLOAT"
+    }
+
+    operand_sizes = {
+        "reg" : 1,
+        "fl_reg" : 1,
+        "addr" : 4,
+        "u8" : 1,
+        "u16" : 2,
+        "u32" : 4,
+        "i8" : 1,
+        "i16" : 2,
+        "i32" : 4,
+        "float" : 4
+    }
+
+    ## Generate a constexpr table with the keyword, operand kinds and operand
+    ## layout of every instruction, so tools (the assembler, the disassembler)
+    ## can encode and decode instructions without linking the interpreter.
+
+    def operand_offsets(self, args):
+        offsets = []
+        offset = 1
+        for kind in args.values():
+            offsets.append(offset)
+            offset += self.operand_sizes[kind]
+        return offsets, offset
+
+    def generate_operand_kind_table(self):
+        instructions = self.data["instructions"]
+        max_operands = max(len(x["args"]) for x in instructions.values())
+        kinds = list(dict.fromkeys(self.operand_kinds.values()))
+        kind_sizes = {self.operand_kinds[kind] : size for kind, size in self.operand_sizes.items()}
+
+        entries = ""
+        lengths = [0] * 256
+        for opcode, instruction in enumerate(instructions.values()):
+            offsets, length = self.operand_offsets(instruction["args"])
+            lengths[opcode] = length
+            entries += "{\"%s\", %d, {%s}, {%s}, %d},\n" % (
+                instruction["keyword"], len(instruction["args"]),
+                self.flatten(["OperandKind::" + self.operand_kinds[kind]
+                              for kind in instruction["args"].values()], separator=", "),
+                self.flatten([str(offset) for offset in offsets], separator=", "),
+                length)
+
+        # flatten consumes the list it is given.
+        kind_names = self.flatten(list(kinds), separator=",\n")
+        kind_size_list = self.flatten([str(kind_sizes[kind]) for kind in kinds], separator=", ")
+
+        return """
+        enum struct OperandKind : uint8_t {
+            %s
+        };
+
+        constexpr size_t MAX_OPERAND_COUNT = %d;
+
+        // NOTE: Encoded size of an operand, indexed by its kind.
+        inline constexpr std::array<uint8_t, %d> operand_sizes {{
+            %s
+        }};
+
+        // NOTE: The operands follow the opcode byte in the order of
+        // instructions.json, offsets are counted from the opcode byte and
+        // length includes it.
+        struct InstructionInfo {
+            const char *keyword;
+            uint8_t operand_count;
+            std::array<OperandKind, MAX_OPERAND_COUNT> operands;
+            std::array<uint8_t, MAX_OPERAND_COUNT> offsets;
+            uint8_t length;
+        };
+
+        inline constexpr std::array<InstructionInfo, %d> instruction_info {{
+            %s
+        }};
+
+        // NOTE: Encoded length of the instruction starting with any byte, 0
+        // for bytes that are not opcodes.
+        inline constexpr std::array<uint8_t, 256> instruction_lengths {{
+            %s
+        }};
+        \n""" % (kind_names,
+                 max_operands,
+                 len(kinds), kind_size_list,
+                 len(instructions), entries,
+                 self.flatten([str(length) for length in lengths], separator=", "))
+
     def generate_parameter_lists_array(self):
         return ""
 
     def generate_callback_declarations(self):
 
         cb = """
-        void %s_cb(Interpreter& vm, const parameters::ParameterList<VM::OpCodes::%s>& params);
+        Trap %s_cb(Interpreter& vm, const parameters::ParameterList<VM::OpCodes::%s>& params);
         """
 
         callback_declarations = self.flatten([
@@ -311,7 +441,57 @@ class InstructionGenerator(CodeGenerator):
         return callback_declarations
 
     def generate_vm_declarations(self):
-        return "void run_next_instruction (Interpreter &interp);"
+        return "Trap run_next_instruction (Interpreter &interp);"
+
+    def generate_aot_declarations(self):
+        return """
+        // Decodes the instruction at pc and returns the C++ expression that executes it,
+        // the expression evaluates to the instruction's trap. Empty when the
+        // instruction can't be decoded.
+        std::string emit_instruction(uint8_t op, MemoryBank::MemoryBuffer &buffer, uint32_t &pc);
+        """
+
+    ## Generate the function the ahead-of-time compiler uses to translate a decoded
+    ## instruction into a call to its callback with the parameters as literals.
+
+    def generate_aot_emitter(self):
+        source = """\n
+        template <typename T> static std::string aot_literal(T value) {
+            return std::to_string(+value) + (std::is_signed_v<T> ? "" : "u");
+        }
+
+        static std::string aot_literal(float value) {
+            return "std::bit_cast<float>(" + std::to_string(std::bit_cast<uint32_t>(value)) + "u)";
+        }
+
+        std::string VM::aot::emit_instruction(uint8_t op, MemoryBank::MemoryBuffer &buffer, uint32_t &pc) {
+            switch(op) {
+                %s\
+            default:
+                return "";
+            }
+        }
+        """
+
+        case = """\
+            case VM::OpCodes::%s: {
+                VM::parameters::ParameterList<VM::OpCodes::%s> params;
+                if (VM::parameters::parse_parameters(buffer, pc, params) != Trap::NONE) {
+                    return "";
+                }
+                return "VM::callbacks::%s(interp, {"%s"})";
+            }
+        """
+
+        cases = self.flatten([
+            case % (opcode, opcode, self.data["instructions"][opcode]["keyword"] + "_cb",
+                    self.flatten([" + aot_literal(params." + name + ") + "
+                                  for name in self.data["instructions"][opcode]["args"].keys()],
+                                 separator='", "'))
+            for opcode in self.data["instructions"].keys()
+        ])
+
+        return source % cases
 
     def generate_parameter_parser(self):
         source = """\n
@@ -344,47 +524,77 @@ class InstructionGenerator(CodeGenerator):
         run_next_instruction_code = """\
         #include "interpreter.hxx"
         #include "instructions.hxx"
+        #include "trace.hxx"
+        #include <bit>
         #include <stdexcept>
+        #include <type_traits>
 
-        void VM::run_next_instruction (Interpreter &interp) {
+        Trap VM::run_next_instruction (Interpreter &interp) {
 
         auto& pc = interp.m_mb.gp_regs_32[MemoryBank::PROGRAM_COUNTER_REG];
         auto& mem = interp.m_mb.memory;
 
-        uint8_t opcode = mem[pc++];
-
-        if(!interp.is_running()) {
-            throw std::runtime_error("Cannot run next instruction, interpreter not running!");
+        if(!interp.is_running()) [[unlikely]] {
+            return Trap::NOT_RUNNING;
         }
 
+        uint32_t instruction_pc = pc;
+        uint8_t opcode = mem[pc++];
+
         switch (opcode) {
             %s
             default:
-                throw std::runtime_error(
-                    (boost::format("Invalid instruction (OPCODE: %%1\%%, PC: %%2\%%)") %%
-                    mem[pc] %% pc)
-                        .str());
-                break;
-
+                return Trap::INVALID_INSTRUCTION;
         }
         }
         """
 
         case = """\
         case VM::OpCodes::%s: {
+           #ifdef DEBUG_EXTRA_INFO
            std::cout << "INSTRUCTION: %s" << std::endl;
+           #endif
            VM::parameters::ParameterList<VM::OpCodes::%s> params;
-           VM::parameters::parse_parameters(mem, pc, params);
-           VM::callbacks::%s(interp, params);
-           break;
+           if (Trap trap = VM::parameters::parse_parameters(mem, pc, params); trap != Trap::NONE) [[unlikely]] {
+               return trap;
+           }
+           Trap trap = VM::callbacks::%s(interp, params);
+           %s
+           return trap;
         };
         """
         switch_cases_code = self.flatten([
-             case %  (opcode, opcode, opcode, self.data["instructions"][opcode]["keyword"] + "_cb") for opcode in self.data["instructions"]
+             case %  (opcode, opcode, opcode, self.data["instructions"][opcode]["keyword"] + "_cb",
+                      self.generate_trace_record(opcode)) for opcode in self.data["instructions"]
         ])
 
         return run_next_instruction_code % switch_cases_code
 
+    ## Append the executed instruction to the binary trace. The register written
+    ## is the "destination" register and the memory address is the first address
+    ## parameter that is not a jump target.
+
+    def generate_trace_record(self, opcode):
+        reg = "TraceRecord::NO_REGISTER"
+        reg_value = "0"
+        address = "TraceRecord::NO_ADDRESS"
+
+        for name, data_type in self.data["instructions"][opcode]["args"].items():
+            if name == "destination" and data_type == "reg":
+                reg = "params.destination"
+                reg_value = "interp.m_mb.gp_regs_32[params.destination]"
+            elif name == "destination" and data_type == "fl_reg":
+                reg = "(params.destination | TraceRecord::FLOAT_REGISTER_BIT)"
+                reg_value = "std::bit_cast<uint32_t>(interp.m_mb.fl_regs_32[params.destination])"
+            elif data_type == "addr" and name != "jump_address" and address == "TraceRecord::NO_ADDRESS":
+                address = "params." + name
+
+        return """\
+           if (interp.m_trace && trap == Trap::NONE) {
+               interp.m_trace->record(instruction_pc, VM::OpCodes::%s, %s, %s, %s);
+           }
+        """ % (opcode, reg, reg_value, address)
+
 
 # We might use stdin to send the code directly to the process and than let it write it to a file
 
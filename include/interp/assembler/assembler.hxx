@@ -1,16 +1,30 @@
 #ifndef ASSEMBLER_HXX
 #define ASSEMBLER_HXX
+#include "object.hxx"
+#include <interp/parse/line_reader.hxx>
+#include <cstdint>
 #include <iostream>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace assembler {
 
-class Label {
-  std::string name;
-  uint32_t offset;
-};
+// NOTE: Syntax, one statement per line, ';' starts a comment:
+//
+//   loop:                  label, defines a symbol at the current offset
+//   .global loop           exports symbols to other modules
+//   .word $10, loop        raw 32-bit values, .byte for single bytes
+//   addi r1, $1, r1        keyword followed by the operands in the order of
+//                          instructions.json, rN/fN are registers, $ marks
+//                          an immediate, addresses are numbers or symbols
+//   ldi $loop, r2          a 32-bit immediate may also name a symbol
+//
+// Symbols that are not defined in the module are imports, the linker
+// resolves them against the other modules' globals.
 
 struct Token {
   enum {
@@ -18,7 +32,8 @@ struct Token {
     KEYWORD,
     REGISTER_ID,
     IMMEDIATE_VALUE,
-    MEMORY_ADDRESS
+    MEMORY_ADDRESS,
+    SYMBOL
   } type;
 
   std::string value;
@@ -27,38 +42,35 @@ struct Token {
 using TokenVector = std::vector<Token>;
 using MaybeTokenVector = std::optional<TokenVector>;
 
-class Tokenizer {
-  enum struct State {
-    STATEMENT_BEGINING,
-    FOUND_LABEL_COLUMN,
-    FOUND_KEYWORD,
-    EXPECTING_REGISTER_ID,
-    EXPECTING_IMMEDIATE_VALUE,
-    FOUND_DECIMAL,
-    READING_DECIMAL,
-    FOUND_ARGUMENT_SEPARATOR
-  };
-
-  void clear_errors();
-  void clear_all();
-
-private:
-  std::vector<std::string> errors;
-};
-
 class Assembler {
 public:
+  // Assembles one or more lines of source.
   Assembler &operator<<(const std::string &str);
+  // Assembles the reader's lines as they come, only the object is kept in
+  // memory.
+  Assembler &operator<<(generic_ling::LineReader &reader);
 
-  MaybeTokenVector tokenize(const std::string &str);
+  // Splits a single line into tokens, nullopt on a malformed line.
+  MaybeTokenVector tokenize(std::string_view str);
+
+  const ObjectFile &object() const { return m_object; }
 
   const std::vector<std::string> get_errors() const { return m_errors; };
 
 private:
-  std::vector<Label> m_labels;
-  std::vector<uint8_t> m_bytecode;
+  void assemble(const TokenVector &tokens);
+  void emit_instruction(uint8_t opcode, const TokenVector &tokens);
+  void emit_data(const TokenVector &operands, uint32_t size);
+  void emit_value(const Token &token, uint32_t size);
+  void emit_number(int64_t value, uint32_t size);
+  uint32_t symbol_index(const std::string &name);
+  void error(const std::string &message);
+
+  ObjectFile m_object;
+  std::unordered_map<std::string, uint32_t> m_symbol_indices;
+  std::unordered_set<uint32_t> m_exported;
+  uint32_t m_line = 0;
   std::vector<std::string> m_errors;
-  Tokenizer m_tokinizer;
 };
 } // namespace assembler
 
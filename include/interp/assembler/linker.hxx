@@ -0,0 +1,56 @@
+#ifndef LINKER_HXX
+#define LINKER_HXX
+#include "object.hxx"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace assembler {
+
+// NOTE: Builds an image out of several source modules. Every module is
+// assembled into an object file next to its source (foo.s -> foo.o), on the
+// next build only the modules whose source is newer than their object file
+// are assembled again. Assembling runs on `jobs` threads, one module at a
+// time per thread.
+//
+// Modules are placed in the image in the order they were added, the first
+// one at address 0 (where the interpreter starts executing). Global symbols
+// are collected into a single hash table and every relocation is applied in
+// one pass over the modules.
+class Linker {
+public:
+  explicit Linker(size_t jobs);
+
+  void add_module(const std::string &source_path);
+
+  // Assembles the out of date modules and loads the rest from their object
+  // files. Returns false if any module failed, see get_errors.
+  bool build_objects();
+
+  // Lays out the modules and resolves their relocations.
+  bool link(std::vector<uint8_t> &image);
+
+  const std::vector<std::string> &get_errors() const { return m_errors; }
+  size_t assembled_count() const { return m_assembled_count; }
+
+private:
+  struct Module {
+    std::string source_path;
+    std::string object_path;
+    ObjectFile object;
+    uint32_t base = 0;
+    bool assembled = false;
+    std::vector<std::string> errors;
+  };
+
+  void build_module(Module &module);
+
+  size_t m_jobs;
+  size_t m_assembled_count = 0;
+  std::vector<Module> m_modules;
+  std::vector<std::string> m_errors;
+};
+
+} // namespace assembler
+
+#endif // LINKER_HXX
@@ -0,0 +1,53 @@
+#ifndef OBJECT_HXX
+#define OBJECT_HXX
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace assembler {
+
+// NOTE: Relocatable object file, the output of assembling one module.
+// Code is assembled as if the module was loaded at address 0, every address
+// that depends on where the module (or the symbol it names) ends up in the
+// image gets a relocation that the linker patches.
+//
+// On disk: header ("MRTO", version, section sizes), code, symbols (value,
+// binding, length prefixed name) and relocations, all little-endian.
+
+struct Symbol {
+  enum Binding : uint8_t { LOCAL, GLOBAL, UNDEFINED };
+
+  std::string name;
+  uint32_t value; // Offset into the module's code.
+  Binding binding;
+};
+
+struct Relocation {
+  enum Type : uint8_t {
+    ABS32 // Absolute 32-bit address of the symbol.
+  };
+
+  uint32_t offset; // Offset into the module's code.
+  uint32_t symbol; // Index into the module's symbol table.
+  int32_t addend;
+  Type type;
+};
+
+struct ObjectFile {
+  constexpr static char MAGIC[4] = {'M', 'R', 'T', 'O'};
+  constexpr static uint16_t VERSION = 1;
+
+  std::vector<uint8_t> code;
+  std::vector<Symbol> symbols;
+  std::vector<Relocation> relocations;
+
+  void write(std::ostream &out) const;
+  // Throws std::runtime_error on a malformed object file, the stream has to
+  // be seekable.
+  static ObjectFile read(std::istream &in);
+};
+
+} // namespace assembler
+
+#endif // OBJECT_HXX
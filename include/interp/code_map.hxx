@@ -0,0 +1,113 @@
+#ifndef CODE_MAP_HXX
+#define CODE_MAP_HXX
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+// NOTE: Code and data share the guest memory, so anything that caches a
+// decoded form of the program (native code, optimized blocks) has to know
+// when the guest overwrites it. The memory is split into 64-byte lines and
+// a bitmap records the lines some cache has decoded. Every store tests the
+// bitmap, a store into a data-only line costs a single bit test. A store
+// into a cached line clears its code bit, marks it stale and tells the
+// listeners which lines changed, so only the blocks decoded from those
+// lines have to be dropped.
+//
+// Memory mapped devices use the same path, a watched line traps stores just
+// like a code line and the store is handed to the device's watcher. Watches
+// survive clear(), they belong to the devices and not to the program.
+class CodeMap {
+public:
+  constexpr static uint32_t LINE_SHIFT = 6;
+  constexpr static uint32_t LINE_SIZE = 1u << LINE_SHIFT;
+
+  // Called with the first and the last line (inclusive) a store invalidated.
+  using Listener = std::function<void(uint32_t first_line, uint32_t last_line)>;
+  // Called after the store wrote the memory.
+  using Watcher = std::function<void(uint64_t address, uint64_t size)>;
+
+  explicit CodeMap(uint64_t memory_size)
+      : m_line_count(memory_size >> LINE_SHIFT),
+        m_code((m_line_count + 63) / 64), m_stale((m_line_count + 63) / 64),
+        m_watched((m_line_count + 63) / 64), m_trap((m_line_count + 63) / 64) {}
+
+  // Lines touched by [begin, end) hold decoded code.
+  void mark_code(uint64_t begin, uint64_t end);
+  void clear();
+
+  // Returns an id for remove_listener.
+  uint32_t add_listener(Listener listener) {
+    m_listeners.push_back({m_next_listener_id, std::move(listener)});
+    return m_next_listener_id++;
+  }
+
+  void remove_listener(uint32_t id) {
+    std::erase_if(m_listeners, [id](auto &entry) { return entry.first == id; });
+  }
+
+  // NOTE: Stores into [begin, end) are passed to the watcher. The whole lines
+  // the range touches trap, keep devices' registers apart from their data
+  // so plain data stores don't have to go through the slow path. Returns an
+  // id for unwatch.
+  uint32_t watch(uint64_t begin, uint64_t end, Watcher watcher);
+  void unwatch(uint32_t id);
+
+  void note_store(uint64_t address, uint64_t size) {
+    uint64_t first = line_of(address);
+    uint64_t last = line_of(address + size - 1);
+
+    // NOTE: Word and byte stores touch at most two lines.
+    if (last - first <= 1 && !test(m_trap, first) && !test(m_trap, last)) {
+      return;
+    }
+    trap(address, size, first, last);
+  }
+
+  bool is_code(uint64_t address) const {
+    return test(m_code, line_of(address));
+  }
+
+  // Whether anything decoded from [begin, end) has been overwritten.
+  bool is_stale(uint64_t begin, uint64_t end) const {
+    return test(m_stale, line_of(begin)) || test(m_stale, line_of(end - 1));
+  }
+
+  uint32_t line_count() const { return m_line_count; }
+
+private:
+  uint64_t line_of(uint64_t address) const {
+    uint64_t line = address >> LINE_SHIFT;
+    return line < m_line_count ? line : m_line_count - 1;
+  }
+
+  static bool test(const std::vector<uint64_t> &bits, uint64_t line) {
+    return (bits[line / 64] >> (line % 64)) & 1;
+  }
+
+  void trap(uint64_t address, uint64_t size, uint64_t first, uint64_t last);
+  void invalidate(uint64_t first, uint64_t last);
+  void update_trap(uint64_t line) {
+    m_trap[line / 64] = m_code[line / 64] | m_watched[line / 64];
+  }
+
+  struct Watch {
+    uint32_t id;
+    uint64_t begin;
+    uint64_t end;
+    Watcher watcher;
+  };
+
+  uint32_t m_line_count;
+  std::vector<uint64_t> m_code;
+  std::vector<uint64_t> m_stale;
+  std::vector<uint64_t> m_watched;
+  // NOTE: Code or watched, the only bitmap the fast path looks at.
+  std::vector<uint64_t> m_trap;
+  std::vector<std::pair<uint32_t, Listener>> m_listeners;
+  uint32_t m_next_listener_id = 0;
+  std::vector<Watch> m_watches;
+  uint32_t m_next_watch_id = 0;
+};
+
+#endif // CODE_MAP_HXX
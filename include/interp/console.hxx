@@ -0,0 +1,82 @@
+#ifndef CONSOLE_HXX
+#define CONSOLE_HXX
+#include "interpreter.hxx"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+// NOTE: Memory mapped console, the fast way to get a stream of results out of
+// a guest. The guest writes its output into a ring buffer in its own memory
+// and publishes it by storing the new head into the doorbell, a host thread
+// then writes everything between the last published head and the new one to
+// the file descriptor with a single writev (two pieces when the batch wraps
+// around the ring) and moves the tail forward. Nothing is dispatched per
+// byte and nothing is flushed.
+//
+// Guest layout, all words little-endian:
+//
+//   CONSOLE_BASE + 0   doorbell, the guest stores its head here
+//   CONSOLE_BASE + 4   tail, written by the host, the guest must not write
+//                      the bytes between the tail and the head. Updated
+//                      whenever the guest rings the doorbell, a guest
+//                      waiting for room rings it again with the same head
+//                      to see how far the host got.
+//   RING_BASE          RING_SIZE bytes of data, byte n of the stream lives
+//                      at RING_BASE + n % RING_SIZE
+//
+// Head and tail are free running byte counts, head - tail is what is in
+// flight. The registers and the ring are on separate lines so only the
+// doorbell store leaves the fast store path.
+class ConsoleDevice {
+public:
+  constexpr static MemPtr CONSOLE_BASE = MemoryBank::DEVICE_LOWER_LIMIT;
+  constexpr static MemPtr DOORBELL = CONSOLE_BASE;
+  constexpr static MemPtr TAIL = CONSOLE_BASE + 4;
+  constexpr static MemPtr RING_BASE = CONSOLE_BASE + 2048;
+  constexpr static uint32_t RING_SIZE = 2048;
+
+  static_assert(RING_BASE + RING_SIZE <= MemoryBank::MEMORY_SIZE);
+
+  // NOTE: The descriptor is not closed by the device.
+  ConsoleDevice(Interpreter &interp, int fd);
+  ~ConsoleDevice();
+
+  ConsoleDevice(const ConsoleDevice &) = delete;
+  ConsoleDevice &operator=(const ConsoleDevice &) = delete;
+
+  // Blocks until everything published so far has been written. Like reset,
+  // only while the machine is not running, it updates the tail in guest
+  // memory.
+  void flush();
+  // NOTE: Resetting the machine clears the registers in guest memory, the
+  // device has to start over with it.
+  void reset();
+
+  // NOTE: The first write error (EINVAL when the guest rang the doorbell with
+  // a head past the ring), the device stops writing after it. 0 when there
+  // was none.
+  int error() const { return m_error.load(std::memory_order_relaxed); }
+
+private:
+  void doorbell(uint64_t address, uint64_t size);
+  void publish_tail();
+  void drain();
+
+  Interpreter &m_interp;
+  int m_fd;
+  uint32_t m_watch_id;
+
+  std::atomic<uint32_t> m_head{0};
+  std::atomic<uint32_t> m_tail{0};
+  std::atomic<int> m_error{0};
+  bool m_stop = false;
+
+  std::mutex m_mutex;
+  std::condition_variable m_published;
+  std::condition_variable m_drained;
+  std::thread m_thread;
+};
+
+#endif // CONSOLE_HXX
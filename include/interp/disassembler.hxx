@@ -0,0 +1,61 @@
+#ifndef DISASSEMBLER_HXX
+#define DISASSEMBLER_HXX
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+
+// NOTE: Linear sweep disassembler over the generated instruction tables (see
+// instruction_info and instruction_lengths in instructions.hxx), for program
+// images, live guest memory, crash dumps and profiles.
+//
+// Lines are formatted straight into one reusable buffer, the sink gets the
+// text whenever the buffer is full and on flush, so a listing of any size
+// takes a constant amount of memory and one call per buffer. Listings use
+// the assembler's operand syntax:
+//
+//   00000012  addi r1, $1, r1
+//   00000019  jgt 0x12
+//
+// Bytes that don't start an instruction (unknown opcodes, an instruction cut
+// off by the end of the code) are listed as .byte, runs of zero bytes as one
+// line. With hit counts every line starts with the count of its address.
+class Disassembler {
+public:
+  using Sink = std::function<void(std::string_view)>;
+
+  constexpr static size_t DEFAULT_BUFFER_SIZE = 64 * 1024;
+  // NOTE: Zero bytes are opcodes (invalid), shorter runs are listed as
+  // instructions.
+  constexpr static size_t MIN_ZERO_RUN = 16;
+
+  explicit Disassembler(Sink sink, size_t buffer_size = DEFAULT_BUFFER_SIZE);
+  ~Disassembler();
+
+  Disassembler(const Disassembler &) = delete;
+  Disassembler &operator=(const Disassembler &) = delete;
+
+  // NOTE: Indexed by address, for example counted from a trace. Addresses
+  // past the end of the counts have none.
+  void set_hit_counts(std::span<const uint64_t> hits) { m_hits = hits; }
+
+  // Lists the code, base is the address of its first byte.
+  void disassemble(std::span<const uint8_t> code, uint32_t base);
+  void flush();
+
+private:
+  // NOTE: Longest line: hit count, address, keyword and four operands.
+  constexpr static size_t MAX_LINE_SIZE = 160;
+
+  char *begin_line(uint32_t address);
+  void end_line(char *end);
+
+  Sink m_sink;
+  std::string m_buffer;
+  size_t m_used = 0;
+  std::span<const uint64_t> m_hits;
+};
+
+#endif // DISASSEMBLER_HXX
@@ -0,0 +1,105 @@
+#ifndef HEAP_HXX
+#define HEAP_HXX
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// NOTE: Guest heap allocator. The heap region of the guest memory is split
+// into pages, a page either serves blocks of a single size class (16 to 1024
+// bytes, powers of two) or is part of a run of pages backing one large block.
+// Small allocations and frees are O(1): every size class page keeps its own
+// host side free list and every size class a list of its pages with free
+// blocks, a fresh page is carved up only when a size class runs dry. Freeing
+// the last live block of a page gives the page back (dropping its free list
+// at once), so a burst of small blocks doesn't keep pages from the large
+// ones. Large blocks search the page map for a free run.
+//
+// All bookkeeping lives on the host, the guest only ever sees addresses. Frees
+// of addresses that are not live blocks are ignored.
+class GuestHeap {
+public:
+  constexpr static uint32_t PAGE_SIZE = 1024;
+  constexpr static uint32_t MIN_BLOCK_SIZE = 16;
+  constexpr static uint32_t SIZE_CLASS_COUNT = 7; // 16, 32, ..., 1024
+  constexpr static uint32_t MAX_PAGE_COUNT = 64;
+
+  struct Stats {
+    uint32_t bytes_in_use = 0;     // Capacity of all the live blocks.
+    uint32_t bytes_requested = 0;  // What the guest asked for.
+    uint32_t high_water = 0;       // Largest bytes_in_use seen so far.
+    uint32_t live_blocks = 0;
+    uint32_t free_pages = 0;
+    uint32_t free_block_bytes = 0; // Free blocks held by size class pages.
+
+    // Share of the used bytes lost to rounding up to a size class.
+    double internal_fragmentation() const {
+      return bytes_in_use ? 1.0 - double(bytes_requested) / bytes_in_use : 0.0;
+    }
+
+    // Share of the free bytes not available as whole pages.
+    double external_fragmentation() const {
+      uint32_t free_bytes = free_block_bytes + free_pages * PAGE_SIZE;
+      return free_bytes ? double(free_block_bytes) / free_bytes : 0.0;
+    }
+  };
+
+  GuestHeap(uint32_t lower_limit, uint32_t upper_limit);
+
+  // Returns 0 when the request cannot be satisfied.
+  uint32_t allocate(uint32_t size);
+  void free(uint32_t address);
+  // NOTE: Moves the contents within the guest memory when the block has to
+  // grow, memory points at the beginning of the guest memory.
+  uint32_t reallocate(uint8_t *memory, uint32_t address, uint32_t size);
+
+  // Releases every block at once, for arena style lifetimes.
+  void reset();
+
+  Stats stats() const;
+
+private:
+  constexpr static uint8_t FREE_PAGE = 0xff;
+  constexpr static uint8_t LARGE_RUN = 0xfe;
+  constexpr static uint8_t LARGE_RUN_TAIL = 0xfd;
+  constexpr static uint8_t NO_PAGE = 0xff;
+
+  static uint32_t size_class(uint32_t size);
+  static uint32_t class_size(uint32_t size_class) {
+    return MIN_BLOCK_SIZE << size_class;
+  }
+
+  bool refill(uint32_t size_class);
+  uint32_t allocate_pages(uint32_t count);
+  void release_pages(uint32_t first_page, uint32_t count);
+  void link_page(uint32_t page);
+  void unlink_page(uint32_t page);
+  uint32_t block_capacity(uint32_t address) const;
+  uint32_t granule(uint32_t address) const {
+    return (address - m_lower_limit) / MIN_BLOCK_SIZE;
+  }
+  uint32_t page(uint32_t address) const {
+    return (address - m_lower_limit) / PAGE_SIZE;
+  }
+
+  uint32_t m_lower_limit;
+  uint32_t m_page_count;
+  uint64_t m_free_page_mask;
+
+  std::array<uint8_t, MAX_PAGE_COUNT> m_page_kind;
+  std::array<uint16_t, MAX_PAGE_COUNT> m_run_pages;
+  // Live blocks of the size class pages.
+  std::array<uint16_t, MAX_PAGE_COUNT> m_live_blocks;
+  std::array<std::vector<uint32_t>, MAX_PAGE_COUNT> m_page_free_blocks;
+  // Per size class the pages with free blocks, linked through the page
+  // numbers.
+  std::array<uint8_t, SIZE_CLASS_COUNT> m_class_pages;
+  std::array<uint8_t, MAX_PAGE_COUNT> m_next_page;
+  std::array<uint8_t, MAX_PAGE_COUNT> m_prev_page;
+  // Per MIN_BLOCK_SIZE granule, set for the first granule of a live block.
+  std::vector<bool> m_allocated;
+  std::vector<uint16_t> m_requested;
+
+  Stats m_stats;
+};
+
+#endif // HEAP_HXX
@@ -1,11 +1,18 @@
 #ifndef INTERPRETER_H
 #define INTERPRETER_H
+#include "code_map.hxx"
+#include "heap.hxx"
+#include "metrics.hxx"
 #include <array>
 #include <bitset>
 #include <boost/format.hpp>
+#include <chrono>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <memory>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
 // TODO: Reorder expression tokens into mathematically accurate order.
@@ -16,16 +23,55 @@ namespace tests {
 class InstructionTester;
 }
 
+class TraceBuffer;
+class PerfCounters;
+class OptimizingTier;
+
 using MemPtr = uint32_t;
 using RegID = uint8_t; // Register ID
 using FL_RegID = uint8_t;
 
+// NOTE: Faults raised by instructions. Instructions return a trap instead of
+// throwing, the run loop only leaves its hot path when one comes back and
+// keeps the state of the fault in the interpreter (Interpreter::last_trap),
+// so a supervisor can inspect or restart a failed machine cheaply.
+enum struct Trap : uint8_t {
+  NONE = 0,
+  INVALID_INSTRUCTION,
+  INVALID_REGISTER,
+  INVALID_ADDRESS,
+  INVALID_OPERAND,
+  DIVIDE_BY_ZERO,
+  STACK_OVERFLOW,
+  STACK_UNDERFLOW,
+  NOT_RUNNING,
+  COUNT
+};
+
+const char *trap_name(Trap trap);
+
+struct TrapState {
+  Trap trap = Trap::NONE;
+  MemPtr pc = 0;      // The instruction that trapped.
+  MemPtr address = 0; // The faulting address, the pc when there is none.
+};
+
 struct MemoryBank {
 public:
   constexpr static uint64_t MEMORY_SIZE = 64 * 1024; // 64 kilobytes
   // NOTE: Stack grows down
   constexpr static uint64_t STACK_LOWER_LIMIT = 0;               // 64 kilobytes
   constexpr static uint64_t STACK_UPPER_LIMIT = MEMORY_SIZE / 2; // 64 kilobytes
+  // NOTE: The top of the memory is reserved for memory mapped devices, see
+  // console.hxx.
+  constexpr static uint64_t DEVICE_REGION_SIZE = 4 * 1024;
+  constexpr static uint64_t DEVICE_LOWER_LIMIT =
+      MEMORY_SIZE - DEVICE_REGION_SIZE;
+  // NOTE: The heap occupies the upper half of the memory, below the devices.
+  // Pushes pre-decrement the stack pointer, the stack's first byte is right
+  // below the heap.
+  constexpr static uint64_t HEAP_LOWER_LIMIT = STACK_UPPER_LIMIT;
+  constexpr static uint64_t HEAP_UPPER_LIMIT = DEVICE_LOWER_LIMIT;
   using MemoryBuffer = std::array<uint8_t, MEMORY_SIZE>;
 
   // NOTE: It might be a good idea to store memory buffers as uint32_t and
@@ -38,7 +84,9 @@ public:
   // NOTE: It might be a good idea to use virtual ROM's to store programs
   // and when neccessary load parts of the program into the working memory.
   //
-  // NOTE: Heap allocation will be handled by the kernel.
+  // NOTE: Heap allocation is handled by the host, see GuestHeap. The
+  // allocator's bookkeeping is kept outside of the guest memory so the guest
+  // cannot corrupt it.
   //
   // FIXME: Memory Alignment: Most CPU's don't access memory byte at a time
   // but rather in "words". We need a way to keep the memory accessible byte
@@ -53,6 +101,12 @@ public:
   std::array<float, FL_REGS_32_COUNT>
       fl_regs_32; /* 15 floating-point 32-bit registers */
   MemoryBuffer memory;
+  // NOTE: Every store into memory has to go through note_store, see
+  // code_map.hxx.
+  CodeMap code_map{MEMORY_SIZE};
+  // NOTE: Lowest the stack pointer got since the last clear, for the metrics.
+  // Taken when the stack grows, once per frame for the word sized operations.
+  uint32_t stack_low = STACK_UPPER_LIMIT;
 
   static const RegID GP_A = 0;
   static const RegID GP_B = 1;
@@ -60,6 +114,7 @@ public:
   static const RegID GP_D = 3;
   static const RegID GP_E = 4;
   static const RegID GP_F = 5;
+  static const RegID FRAME_PTR_REG = 15;
   static const RegID STACK_PTR_REG = 12;
   static const RegID PROGRAM_COUNTER_REG = 13;
   static const RegID FLAGS_REG = 14;
@@ -80,44 +135,104 @@ public:
     fl_regs_32[PROGRAM_COUNTER_REG] = 0;
     gp_regs_32[STACK_PTR_REG] = STACK_UPPER_LIMIT;
     std::fill(memory.begin(), memory.end(), 0);
+    code_map.clear();
+    stack_low = STACK_UPPER_LIMIT;
   }
 
-  void push_register_to_stack(RegID rid) {
-    // FIXME: MAybe validate regid here
+  // NOTE: Register ids are validated when the instruction is decoded. The
+  // byte sized pushes pre-decrement the stack pointer like the word sized
+  // ones below, so the two can be mixed on the same stack.
+  Trap push_register_to_stack(RegID rid) {
+    if (gp_regs_32[STACK_PTR_REG] > STACK_UPPER_LIMIT) {
+      return Trap::STACK_UNDERFLOW;
+    }
     if (gp_regs_32[STACK_PTR_REG] <= STACK_LOWER_LIMIT) {
-      throw std::runtime_error("Stack underflow!");
+      return Trap::STACK_OVERFLOW;
     }
-    memory[gp_regs_32[STACK_PTR_REG]] = gp_regs_32[rid];
     gp_regs_32[STACK_PTR_REG]--;
+    memory[gp_regs_32[STACK_PTR_REG]] = gp_regs_32[rid];
+    code_map.note_store(gp_regs_32[STACK_PTR_REG], 1);
+    stack_low = gp_regs_32[STACK_PTR_REG] < stack_low
+                    ? gp_regs_32[STACK_PTR_REG]
+                    : stack_low;
+    return Trap::NONE;
   }
 
-  void push_float_register_to_stack(RegID rid) {
-    // FIXME: MAybe validate regid here
-    if (fl_regs_32[STACK_PTR_REG] <= STACK_LOWER_LIMIT) {
-      throw std::runtime_error("Stack underflow!");
+  // NOTE: The float stack pointer is a float, the checks are written so a NaN
+  // fails them.
+  Trap push_float_register_to_stack(RegID rid) {
+    if (!(fl_regs_32[STACK_PTR_REG] <= STACK_UPPER_LIMIT)) {
+      return Trap::STACK_UNDERFLOW;
+    }
+    if (fl_regs_32[STACK_PTR_REG] < STACK_LOWER_LIMIT + 1) {
+      return Trap::STACK_OVERFLOW;
     }
-    memory[fl_regs_32[STACK_PTR_REG]] = fl_regs_32[rid];
     fl_regs_32[STACK_PTR_REG]--;
+    memory[fl_regs_32[STACK_PTR_REG]] = fl_regs_32[rid];
+    code_map.note_store(fl_regs_32[STACK_PTR_REG], 1);
+    return Trap::NONE;
   }
 
-  void pop_register_from_stack(RegID rid) {
-    // FIXME: MAybe validate regid here
+  Trap pop_register_from_stack(RegID rid) {
     if (gp_regs_32[STACK_PTR_REG] >= STACK_UPPER_LIMIT) {
-      throw std::runtime_error("Stack overflow!");
+      return Trap::STACK_UNDERFLOW;
     }
 
     gp_regs_32[rid] = memory[gp_regs_32[STACK_PTR_REG]];
     gp_regs_32[STACK_PTR_REG]++;
+    return Trap::NONE;
   }
 
-  void pop_float_register_from_stack(RegID rid) {
-    // FIXME: MAybe validate regid here
-    if (fl_regs_32[STACK_PTR_REG] >= STACK_UPPER_LIMIT) {
-      throw std::runtime_error("Stack overflow!");
+  Trap pop_float_register_from_stack(RegID rid) {
+    if (fl_regs_32[STACK_PTR_REG] < STACK_LOWER_LIMIT) {
+      return Trap::STACK_OVERFLOW;
+    }
+    if (!(fl_regs_32[STACK_PTR_REG] < STACK_UPPER_LIMIT)) {
+      return Trap::STACK_UNDERFLOW;
     }
 
     fl_regs_32[rid] = memory[fl_regs_32[STACK_PTR_REG]];
     fl_regs_32[STACK_PTR_REG]++;
+    return Trap::NONE;
+  }
+
+  // NOTE: Word sized stack operations (call, ret, enter, leave, pushm, popm)
+  // pre-decrement the stack pointer, so it always points at the last word
+  // pushed. The stack limits are checked once per frame with reserve_stack and
+  // release_stack, the individual words are then moved without any checks.
+  //
+  // The guest can load anything into the stack pointer, a pointer above the
+  // stack is treated like popping an empty stack.
+  Trap reserve_stack(uint32_t bytes) {
+    if (gp_regs_32[STACK_PTR_REG] > STACK_UPPER_LIMIT) {
+      return Trap::STACK_UNDERFLOW;
+    }
+    if (gp_regs_32[STACK_PTR_REG] < STACK_LOWER_LIMIT + bytes) {
+      return Trap::STACK_OVERFLOW;
+    }
+    uint32_t low = gp_regs_32[STACK_PTR_REG] - bytes;
+    stack_low = low < stack_low ? low : stack_low;
+    return Trap::NONE;
+  }
+
+  Trap release_stack(uint32_t bytes) const {
+    if (uint64_t(gp_regs_32[STACK_PTR_REG]) + bytes > STACK_UPPER_LIMIT) {
+      return Trap::STACK_UNDERFLOW;
+    }
+    return Trap::NONE;
+  }
+
+  void push_stack_word(uint32_t value) {
+    gp_regs_32[STACK_PTR_REG] -= sizeof(uint32_t);
+    std::memcpy(&memory[gp_regs_32[STACK_PTR_REG]], &value, sizeof(uint32_t));
+    code_map.note_store(gp_regs_32[STACK_PTR_REG], sizeof(uint32_t));
+  }
+
+  uint32_t pop_stack_word() {
+    uint32_t value;
+    std::memcpy(&value, &memory[gp_regs_32[STACK_PTR_REG]], sizeof(uint32_t));
+    gp_regs_32[STACK_PTR_REG] += sizeof(uint32_t);
+    return value;
   }
 
   bool check_flag(uint32_t flag_bit) const {
@@ -126,33 +241,52 @@ public:
 
   void set_flag(uint32_t flag_bit) { gp_regs_32[FLAGS_REG] |= flag_bit; }
 
-  void unset_flag(uint32_t flag_bit) { gp_regs_32[FLAGS_REG] ^= flag_bit; }
+  void unset_flag(uint32_t flag_bit) { gp_regs_32[FLAGS_REG] &= ~flag_bit; }
 
+  // NOTE: Only ever used for debugging, '\n' instead of std::endl so the
+  // dump isn't flushed line by line.
   void print_registers() const {
     for (uint32_t i = 0; i < GP_REGS_32_COUNT; i++) {
-      std::cout << "GP_REGISTER[0x" << i << "] = " << gp_regs_32[i]
-                << std::endl;
+      std::cout << "GP_REGISTER[0x" << i << "] = " << gp_regs_32[i] << '\n';
     }
 
     std::cout << "\n";
 
-    std::cout << "STACK_PTR: " << gp_regs_32[STACK_PTR_REG] << std::endl;
+    std::cout << "STACK_PTR: " << gp_regs_32[STACK_PTR_REG] << '\n';
     std::cout << "PROGRAM_COUNTER: " << gp_regs_32[PROGRAM_COUNTER_REG]
-              << std::endl;
+              << '\n';
     std::cout << "FLAGS: " << std::bitset<32>(gp_regs_32[PROGRAM_COUNTER_REG])
-              << std::endl;
+              << '\n';
 
     std::cout << "\n";
 
     for (uint32_t i = 0; i < FL_REGS_32_COUNT; i++) {
       std::cout << "FLOAT_REGISTER[0x" << i << "] = " << fl_regs_32[i]
-                << std::endl;
+                << '\n';
     }
   }
 };
 
 struct Interpreter {
-  void reset() { m_mb.clear(); }
+  // NOTE: The attached tools and the metrics totals stay, everything else
+  // starts over, so a machine that was preempted or suspended on I/O can run
+  // a new program.
+  void reset() {
+    m_mb.clear();
+    m_heap.reset();
+    m_preempted = false;
+    m_budget = 0;
+    m_async_io = false;
+    m_waiting_for_io = false;
+    m_pending_io = {};
+    m_io_handles.clear();
+    m_fault_address = NO_FAULT_ADDRESS;
+    m_trapped = false;
+    m_trap_state = {};
+    m_trap_vectors.fill(NO_TRAP_VECTOR);
+    m_native_entry = nullptr;
+    m_return_stack_depth = 0;
+  }
 
   using BytecodeBuffer = std::vector<uint8_t>;
   // NOTE: The program can be excecuted in terms of reading byte at
@@ -164,15 +298,218 @@ struct Interpreter {
   void start() { m_is_running = true; }
   void stop() { m_is_running = false; }
   bool is_running() const { return m_is_running; }
-  void run();
+
+  enum struct RunStatus {
+    HALTED,        // The guest executed halt or the interpreter was stopped.
+    PREEMPTED,     // The budget or the deadline ran out, run can be resumed.
+    WAITING_FOR_IO, // Suspended on an I/O instruction, see complete_io.
+    END_OF_MEMORY, // The program counter ran off the end of memory.
+    TRAPPED        // A trap no guest handler took, see last_trap.
+  };
+
+  using Clock = std::chrono::steady_clock;
+
+  // NOTE: The budget is not counted per instruction, it is charged once per
+  // control transfer (jump, call and return). A straight line of code always
+  // runs to its end and a runaway guest has to loop to run away, so every
+  // iteration of a guest loop costs exactly one unit of budget.
+  RunStatus run();
+  RunStatus run_for(uint64_t budget);
+  RunStatus run_until(Clock::time_point deadline);
+
+  // NOTE: Loads a program translated ahead of time by the aot tool. The
+  // native code runs every instruction it knows, whenever the program counter
+  // leaves the translated image (for example a register jump into data that
+  // was later turned into code) the interpreter takes over until it reaches
+  // a translated instruction again. The shared object stays loaded for the
+  // lifetime of the process, reset() goes back to interpreting.
+  void load_native(const std::string &path);
+
+  // NOTE: Hot patching, for guests that are already running. Only call these
+  // while the machine is not executing an instruction (between run_for
+  // slices or before resuming a preempted machine). The patched lines are
+  // invalidated in the code map, caches drop just the blocks decoded from
+  // them and the next run picks up the new code.
+  void patch_code(MemPtr address, const BytecodeBuffer &code);
+  // Overwrites the entry of a function with a jump to its replacement, calls
+  // to the old entry land in the new function. The old function has to be at
+  // least as long as a jump instruction.
+  void redirect_function(MemPtr entry, MemPtr replacement);
+
+  // NOTE: Records the faulting address of the trap an instruction is about to
+  // return, return interp.fault(trap, address).
+  Trap fault(Trap trap, MemPtr address) {
+    m_fault_address = address;
+    return trap;
+  }
+
+  const TrapState &last_trap() const { return m_trap_state; }
+
+  // NOTE: Guest trap handlers, installed with the trapv instruction. A trap
+  // with a vector is delivered like a call to the handler with the address
+  // of the faulting instruction as the return address, returning retries
+  // it. The vector is disarmed on delivery so a handler that faults itself
+  // stops the machine instead of looping, a handler that wants the next trap
+  // too installs itself again. The address 0 is the program's entry point,
+  // it stands for no handler.
+  constexpr static MemPtr NO_TRAP_VECTOR = 0;
+
+  void set_trap_vector(Trap trap, MemPtr handler) {
+    m_trap_vectors[static_cast<size_t>(trap)] = handler;
+  }
+
+  // NOTE: Called by the control transfer instructions.
+  void charge_block() {
+    if (--m_budget == 0) {
+      m_is_running = false;
+      m_preempted = true;
+    }
+  }
+
+  // NOTE: The return stack is a host side shadow of the return addresses
+  // pushed on the guest stack by call instructions. It works like the return
+  // address predictor on hardware: ret takes the predicted target and checks
+  // it against the guest's return address. The guest stack always stays
+  // authoritative, a guest that rewrites its return address or returns
+  // without a matching call (a trap handler) simply mispredicts. The ring
+  // only keeps the innermost RETURN_STACK_SIZE calls, deeper returns find it
+  // empty and fall back to the guest stack too.
+  constexpr static uint32_t RETURN_STACK_SIZE = 64;
+
+  struct ReturnStackStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+  };
+
+  void push_return_address(MemPtr return_address) {
+    m_return_stack[m_return_stack_top] = return_address;
+    m_return_stack_top = (m_return_stack_top + 1) % RETURN_STACK_SIZE;
+    if (m_return_stack_depth < RETURN_STACK_SIZE) {
+      m_return_stack_depth++;
+    }
+  }
+
+  MemPtr pop_return_address(MemPtr guest_return_address) {
+    if (m_return_stack_depth > 0) {
+      m_return_stack_top =
+          (m_return_stack_top + RETURN_STACK_SIZE - 1) % RETURN_STACK_SIZE;
+      m_return_stack_depth--;
+      MemPtr predicted = m_return_stack[m_return_stack_top];
+      if (predicted == guest_return_address) [[likely]] {
+        m_return_stack_stats.hits++;
+        return predicted;
+      }
+      // The shadow entries no longer line up with the guest stack, drop them.
+      m_return_stack_depth = 0;
+    }
+    m_return_stack_stats.misses++;
+    return guest_return_address;
+  }
+
+  const ReturnStackStats &return_stack_stats() const {
+    return m_return_stack_stats;
+  }
+
+  // NOTE: Guests don't see host file descriptors, the host attaches them and
+  // hands the returned handle to the guest (usually through a register).
+  //
+  // I/O instructions are blocking by default. With async I/O enabled the
+  // instruction only records the request and suspends the machine, run
+  // returns WAITING_FOR_IO and whoever drives the machine performs the request
+  // and passes its result to complete_io. All of the machine's state already
+  // lives in the MemoryBank so nothing else has to be saved while it waits.
+  struct IoRequest {
+    enum Kind { READ, WRITE } kind;
+    int fd;
+    MemPtr buffer;
+    uint32_t length;
+    RegID destination;
+  };
+
+  uint32_t attach_handle(int fd);
+  int handle_to_fd(uint32_t handle) const;
+  void set_async_io(bool async_io) { m_async_io = async_io; }
+  bool is_async_io() const { return m_async_io; }
+
+  // Performs the request right away, returns the transferred byte count or a
+  // negative errno value.
+  int32_t perform_io(const IoRequest &request);
+  void suspend_for_io(const IoRequest &request);
+  const IoRequest &pending_io() const { return m_pending_io; }
+  void complete_io(int32_t result);
 
 private:
   using MemoryBuffer = decltype(MemoryBank::memory);
 
-  bool m_is_running;
+  // NOTE: The run loops return the number of instructions they ran, which
+  // they only count for the metrics (COUNTED), so the loops without metrics
+  // attached don't pay for it.
+  template <bool COUNTED> uint64_t run_loop();
+  template <bool COUNTED> uint64_t run_plain();
+  // NOTE: The run loop with the performance counters around it, kept apart
+  // so the plain loop doesn't pay for the instrumentation.
+  template <bool COUNTED> uint64_t run_instrumented();
+  // NOTE: The run loop with the optimizing tier, looks for optimized blocks
+  // at the block heads only. Also counts for the performance counters, so
+  // attaching them doesn't turn the tier off.
+  template <bool COUNTED> uint64_t run_tiered();
+  void deliver_trap(Trap trap, MemPtr pc);
+  // NOTE: Stores the counters into the metrics segment.
+  void publish_metrics();
+
+  constexpr static MemPtr NO_FAULT_ADDRESS = 0xffffffff;
+
+  // NOTE: How many budget units run_until spends between two reads of the
+  // clock.
+  constexpr static uint64_t DEADLINE_CHECK_INTERVAL = 1024;
+  // NOTE: How many budget units (control transfers) the run loops spend
+  // between two publications of the metrics.
+  constexpr static uint64_t METRICS_INTERVAL = 1024;
+
+  // NOTE: Returns once the program counter is not a translated instruction or
+  // the interpreter stopped running, with the number of guest instructions it
+  // ran.
+  using NativeEntry = uint64_t (*)(Interpreter &);
+  NativeEntry m_native_entry = nullptr;
+
+  bool m_is_running = false;
+  bool m_preempted = false;
+  bool m_async_io = false;
+  bool m_waiting_for_io = false;
+  bool m_trapped = false;
+  TrapState m_trap_state;
+  MemPtr m_fault_address = NO_FAULT_ADDRESS;
+  std::array<MemPtr, static_cast<size_t>(Trap::COUNT)> m_trap_vectors{};
+  IoRequest m_pending_io{};
+  std::vector<int> m_io_handles;
+  uint64_t m_budget = 0;
+  std::array<MemPtr, RETURN_STACK_SIZE> m_return_stack{};
+  uint32_t m_return_stack_top = 0;
+  uint32_t m_return_stack_depth = 0;
+  ReturnStackStats m_return_stack_stats;
+
+  // NOTE: Totals of the finished slices, see metrics.hxx.
+  uint64_t m_instructions = 0;
+  uint64_t m_blocks = 0;
+  uint64_t m_slices = 0;
+  uint64_t m_traps = 0;
+  uint64_t m_slice_budget = 0;
+  uint32_t m_stack_low = MemoryBank::STACK_UPPER_LIMIT;
+  Clock::duration m_run_time{};
+  Clock::time_point m_slice_start;
 
 public:
   MemoryBank m_mb;
+  // NOTE: When set every executed instruction is recorded, see trace.hxx.
+  TraceBuffer *m_trace = nullptr;
+  // NOTE: When set runs are measured with host counters, see perf_counters.hxx.
+  PerfCounters *m_perf = nullptr;
+  // NOTE: When set hot blocks run optimized, see optimizer.hxx. Not used
+  // while a trace is attached.
+  OptimizingTier *m_tier = nullptr;
+  // NOTE: When set the machine's counters are published, see metrics.hxx.
+  VmMetrics *m_metrics = nullptr;
+  GuestHeap m_heap{MemoryBank::HEAP_LOWER_LIMIT, MemoryBank::HEAP_UPPER_LIMIT};
 };
 
 class VirtualMachine {
@@ -181,6 +518,13 @@ class VirtualMachine {
 public:
   void reset() { m_interp.reset(); }
 
+  // NOTE: Publishes the machine's counters in the shared memory segment name
+  // for as long as the machine lives.
+  void export_metrics(const std::string &name) {
+    m_metrics = std::make_unique<VmMetrics>(name);
+    m_interp.m_metrics = m_metrics.get();
+  }
+
   struct Instruction {
     // NOTE: Assign instruction opcodes with specific values.
     // TODO: We might need byte, half world operations as well,
@@ -191,10 +535,10 @@ public:
   // FIXME: In the future we want to make this private
 public:
   Interpreter m_interp;
-};
 
-void check_bytes_ahead(MemoryBank::MemoryBuffer &buffer, size_t index,
-                       size_t count);
+private:
+  std::unique_ptr<VmMetrics> m_metrics;
+};
 
 // NOTE: This is an auxilary function to make the code more readable.
 template <typename Type> Type *looking_at_cast(uint8_t *ptr) {
@@ -203,6 +547,9 @@ template <typename Type> Type *looking_at_cast(uint8_t *ptr) {
 
 template <typename IntType> IntType vm_to_host_number(IntType n) { return n; }
 
+// NOTE: The operand readers don't check anything, the generated
+// parse_parameters checks the whole instruction is inside of the memory
+// before reading it and validates the register ids.
 RegID read_valid_regid(MemoryBank::MemoryBuffer &buffer, uint32_t &pc);
 RegID read_valid_float_regid(MemoryBank::MemoryBuffer &buffer, uint32_t &pc);
 MemPtr read_valid_mem_address(MemoryBank::MemoryBuffer &buffer, uint32_t &pc);
@@ -210,14 +557,11 @@ MemPtr read_valid_mem_address(MemoryBank::MemoryBuffer &buffer, uint32_t &pc);
 template <typename IntType>
 IntType read_valid_int_immediate_val(MemoryBank::MemoryBuffer &buffer,
                                      uint32_t &pc) {
-
-  check_bytes_ahead(buffer, pc, sizeof(IntType));
-  int32_t res =
-      vm_to_host_number<IntType>(*looking_at_cast<IntType>(&buffer[pc]));
-  return res;
+  IntType res;
+  std::memcpy(&res, &buffer[pc], sizeof(IntType));
+  return vm_to_host_number<IntType>(res);
 }
 float read_valid_float_immediate_val(MemoryBank::MemoryBuffer &buffer,
                                      uint32_t &pc);
-MemPtr check_mem_address_with_throw(MemPtr mem_ptr);
 
 #endif // INTERPRETER_H
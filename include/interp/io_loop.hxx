@@ -0,0 +1,83 @@
+#ifndef IO_LOOP_HXX
+#define IO_LOOP_HXX
+#include "interpreter.hxx"
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <functional>
+
+// NOTE: The I/O loop drives many I/O bound virtual machines from a single
+// thread. Every machine runs inside a coroutine wrapped around
+// Interpreter::run_for, when the guest executes an I/O instruction the
+// coroutine suspends until the file descriptor is ready (epoll) and the
+// thread moves on to the next runnable machine. Regular files are always
+// ready so their requests complete without a trip through epoll.
+//
+// A file descriptor can only be waited on by one machine at a time.
+class IoLoop {
+public:
+  using RunStatus = Interpreter::RunStatus;
+  using FinishedCallback = std::function<void(VirtualMachine &, RunStatus)>;
+
+  // NOTE: Budget a machine gets before it yields to the other runnable ones.
+  constexpr static uint64_t TIME_SLICE_BUDGET = 4096;
+
+  IoLoop();
+  ~IoLoop();
+
+  IoLoop(const IoLoop &) = delete;
+  IoLoop &operator=(const IoLoop &) = delete;
+
+  // Makes the descriptor non-blocking and attaches it to the machine.
+  uint32_t attach_handle(VirtualMachine &vm, int fd);
+
+  // NOTE: The machine has to have a program loaded and be started.
+  void spawn(VirtualMachine &vm, FinishedCallback on_finished = {});
+
+  // Runs until every spawned machine has finished.
+  void run();
+
+private:
+  struct Task {
+    struct promise_type {
+      Task get_return_object() {
+        return {std::coroutine_handle<promise_type>::from_promise(*this)};
+      }
+      std::suspend_always initial_suspend() noexcept { return {}; }
+      std::suspend_never final_suspend() noexcept { return {}; }
+      void return_void() {}
+      void unhandled_exception() { std::terminate(); }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+  };
+
+  struct Waiter {
+    IoLoop &loop;
+    Interpreter &interp;
+    int32_t result;
+    std::coroutine_handle<> handle;
+
+    bool await_ready();
+    void await_suspend(std::coroutine_handle<> h);
+    int32_t await_resume() const { return result; }
+  };
+
+  struct Yield {
+    IoLoop &loop;
+
+    bool await_ready() const { return false; }
+    void await_suspend(std::coroutine_handle<> h) { loop.m_ready.push_back(h); }
+    void await_resume() const {}
+  };
+
+  Task drive(VirtualMachine &vm, FinishedCallback on_finished);
+  void wait_for_events();
+
+  int m_epoll_fd;
+  std::deque<std::coroutine_handle<>> m_ready;
+  size_t m_live_tasks = 0;
+  size_t m_waiting = 0;
+};
+
+#endif // IO_LOOP_HXX
@@ -0,0 +1,100 @@
+#ifndef METRICS_HXX
+#define METRICS_HXX
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// NOTE: Live counters of a running machine, published in a POSIX shared
+// memory segment so monitors (see vm_metrics) can sample them at any rate
+// without stopping the machine or taking a lock.
+//
+// The machine is the only writer. Every counter is a relaxed atomic, the
+// writer stores plain values into them (no read-modify-write). A reader never
+// sees a torn counter, the counters just aren't consistent with each other.
+// The run loop publishes every Interpreter::METRICS_INTERVAL control transfers
+// and at the end of every run slice, traps are published as they are
+// delivered.
+//
+// The layout only grows: new counters are appended, VERSION is bumped and
+// size tells a reader how much of the layout the writer knows about.
+struct MetricsLayout {
+  constexpr static uint32_t VERSION = 1;
+
+  // NOTE: RunStatus of the last slice, RUNNING while a slice runs.
+  enum State : uint64_t {
+    HALTED,
+    PREEMPTED,
+    WAITING_FOR_IO,
+    END_OF_MEMORY,
+    TRAPPED,
+    RUNNING,
+    IDLE
+  };
+
+  char magic[4] = {'M', 'R', 'V', 'M'};
+  uint32_t version = VERSION;
+  uint32_t size = sizeof(MetricsLayout);
+  uint32_t pid = 0;
+
+  std::atomic<uint64_t> state{IDLE};
+  std::atomic<uint64_t> publications{0};
+  // Interpreted instructions and instructions run by the optimizing tier or
+  // by native code, counted while the metrics are attached.
+  std::atomic<uint64_t> instructions{0};
+  // Control transfers, the budget units spent.
+  std::atomic<uint64_t> blocks{0};
+  std::atomic<uint64_t> slices{0};
+  std::atomic<uint64_t> traps{0};
+  std::atomic<uint64_t> run_nanoseconds{0};
+  // Deepest the stack got in bytes, taken whenever the stack grows.
+  std::atomic<uint64_t> stack_high_water{0};
+  std::atomic<uint64_t> heap_bytes_in_use{0};
+  std::atomic<uint64_t> heap_high_water{0};
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+// NOTE: Creates the segment (replacing a stale one of the same name) and
+// removes it again when destroyed. Names follow shm_open, "/name".
+class VmMetrics {
+public:
+  explicit VmMetrics(const std::string &name);
+  ~VmMetrics();
+
+  VmMetrics(const VmMetrics &) = delete;
+  VmMetrics &operator=(const VmMetrics &) = delete;
+
+  MetricsLayout &layout() { return *m_layout; }
+  const std::string &name() const { return m_name; }
+
+  // NOTE: Single writer, the counters never need an atomic increment.
+  static void store(std::atomic<uint64_t> &counter, uint64_t value) {
+    counter.store(value, std::memory_order_relaxed);
+  }
+
+private:
+  std::string m_name;
+  MetricsLayout *m_layout;
+};
+
+// NOTE: Maps an existing segment read only.
+class MetricsReader {
+public:
+  explicit MetricsReader(const std::string &name);
+  ~MetricsReader();
+
+  MetricsReader(const MetricsReader &) = delete;
+  MetricsReader &operator=(const MetricsReader &) = delete;
+
+  const MetricsLayout &layout() const { return *m_layout; }
+
+  static uint64_t load(const std::atomic<uint64_t> &counter) {
+    return counter.load(std::memory_order_relaxed);
+  }
+
+private:
+  const MetricsLayout *m_layout;
+  size_t m_size;
+};
+
+#endif // METRICS_HXX
@@ -0,0 +1,58 @@
+#ifndef NUMERIC_HXX
+#define NUMERIC_HXX
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+// NOTE: Numeric literal conversion shared by the expression parser, the
+// assembler and the tools.
+//
+// Decimal digits are converted eight at a time, the eight bytes are loaded
+// into one word, checked for being digits and combined with three
+// multiplications (SWAR) instead of a multiplication per digit. Floats are
+// parsed with std::from_chars so they are correctly rounded.
+//
+// Like std::from_chars the parse functions stop at the first character that
+// doesn't belong to the literal and return where they stopped, the callers
+// decide what may follow a literal. The value is only written when the
+// status is OK.
+namespace numeric {
+
+enum struct Status : uint8_t { OK, INVALID, OUT_OF_RANGE };
+
+struct Result {
+  const char *end;
+  Status status;
+
+  bool ok() const { return status == Status::OK; }
+};
+
+Result parse_decimal(const char *first, const char *last, uint64_t &value);
+Result parse_hex(const char *first, const char *last, uint64_t &value);
+Result parse_binary(const char *first, const char *last, uint64_t &value);
+
+// Optionally negative decimal.
+Result parse_i32(const char *first, const char *last, int32_t &value);
+Result parse_u32(const char *first, const char *last, uint32_t &value);
+// Optionally negative, decimal, 0x prefixed hexadecimal or 0b prefixed
+// binary. The immediates of the assembler.
+Result parse_integer(const char *first, const char *last, int64_t &value);
+
+// Optionally negative, fixed or scientific notation. Infinities and NaNs are
+// not literals.
+Result parse_double(const char *first, const char *last, double &value);
+Result parse_float(const char *first, const char *last, float &value);
+
+// NOTE: Bulk conversion of whole literals (nothing may follow them), for
+// data tables and columns of numbers. Literals of up to eight digits are
+// converted without a digit loop. Returns how many literals were converted,
+// the first one that isn't a valid literal stops the conversion.
+size_t parse_integers(std::span<const std::string_view> literals,
+                      std::span<int64_t> values);
+size_t parse_doubles(std::span<const std::string_view> literals,
+                     std::span<double> values);
+
+} // namespace numeric
+
+#endif // NUMERIC_HXX
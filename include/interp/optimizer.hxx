@@ -0,0 +1,159 @@
+#ifndef OPTIMIZER_HXX
+#define OPTIMIZER_HXX
+#include "interpreter.hxx"
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// NOTE: Optimizing tier, sits between the interpreter and native code (see
+// aot). The run loop counts how often every block head (the target of a
+// control transfer) is entered, once a head gets hot the straight-line code
+// starting at it is lifted into SSA values, optimized and lowered into a
+// stream of micro-ops the tier runs instead of the guest instructions.
+//
+// The optimizations are the ones naive front ends (the expression compiler)
+// make worth it:
+//  - constant propagation and folding, copies (ori r, 0, d, addi r, 0, d)
+//    disappear, loads of the same address share one value and a store
+//    forwards its value to the loads after it;
+//  - register writes a later instruction overwrites are never done, the
+//    registers live in the block's slots and only the final values are
+//    written back when the block exits;
+//  - a compare whose flags no jump reads is dropped, compare only replaces
+//    the zero and sign bits so compare after compare doesn't need the first
+//    one at all;
+//  - a block that jumps back to its own head is run as a loop, everything
+//    that only depends on registers the loop doesn't write is computed once
+//    before the first iteration, the registers stay in slots between the
+//    iterations.
+//
+// Regions never contain an instruction that could trap (stack operations,
+// division by a register, out of bounds or device memory) or one the
+// interpreter has to see (I/O, heap, calls), they end before it and the
+// interpreter runs it. Every iteration of a loop is charged to the budget
+// like the jump it replaces.
+//
+// The decoded lines are registered in the code map, a store into them drops
+// the blocks decoded from them. The tier doesn't record the binary trace, the
+// run loop doesn't use it when a trace is attached.
+class OptimizingTier {
+public:
+  // NOTE: How many times a block head is entered before it is optimized.
+  constexpr static uint16_t HOT_THRESHOLD = 16;
+  constexpr static uint32_t MAX_REGION_INSTRUCTIONS = 256;
+
+  enum struct MicroOpcode : uint8_t {
+    CONST,
+    GET_GP,
+    GET_FL,
+    MOVE,
+    ADD,
+    SUB,
+    MUL,
+    DIV, // The divisor is known not to be zero.
+    SHL,
+    SHR,
+    OR,
+    AND,
+    XOR,
+    NOT,
+    LOGICAL_NOT,
+    FADD,
+    FSUB,
+    FMUL,
+    FDIV,
+    CMP,  // dst = flags a with the zero and sign bits of comparing b and c.
+    FCMP,
+    LOAD32,
+    LOAD16,
+    LOAD8,
+    STORE32,
+    STORE8
+  };
+
+  // NOTE: Operands are slots of the block, imm holds constants, addresses
+  // and register ids.
+  struct MicroOp {
+    MicroOpcode op;
+    uint16_t dst;
+    uint16_t a;
+    uint16_t b;
+    uint16_t c;
+    uint32_t imm;
+  };
+
+  enum struct Condition : uint8_t { NEVER, ALWAYS, ZERO, LESS, GREATER };
+
+  struct Block {
+    MemPtr start;
+    MemPtr end; // One past the last guest instruction.
+    // Run once on entry: register reads, constants and loop invariants.
+    std::vector<MicroOp> preheader;
+    // Run once, or once per iteration of a loop.
+    std::vector<MicroOp> body;
+    std::vector<std::pair<RegID, uint16_t>> gp_out;
+    std::vector<std::pair<RegID, uint16_t>> fl_out;
+    // NOTE: Loops carry the registers they write from one iteration to the
+    // next in the slots, (final value, register's input slot).
+    std::vector<std::pair<uint16_t, uint16_t>> loop_moves;
+    bool loop_moves_overlap = false;
+    bool loops = false;
+    Condition condition = Condition::NEVER;
+    uint16_t flags = 0;
+    MemPtr target = 0;
+    MemPtr fallthrough = 0;
+    uint16_t slot_count = 0;
+    uint32_t guest_instructions = 0;
+  };
+
+  struct Stats {
+    uint64_t blocks_compiled = 0;
+    uint64_t blocks_invalidated = 0;
+    uint64_t block_runs = 0;
+    // Summed over the compiled blocks.
+    uint64_t guest_instructions = 0;
+    uint64_t body_micro_ops = 0;
+  };
+
+  explicit OptimizingTier(Interpreter &interp);
+  ~OptimizingTier();
+  OptimizingTier(const OptimizingTier &) = delete;
+  OptimizingTier &operator=(const OptimizingTier &) = delete;
+
+  // NOTE: Called by the run loop whenever the program counter is a block
+  // head. Returns the optimized block starting there once it got hot.
+  const Block *enter(MemPtr pc) {
+    if (auto it = m_blocks.find(pc); it != m_blocks.end()) {
+      return it->second.get();
+    }
+    if (m_heat[pc] == NEVER || ++m_heat[pc] < HOT_THRESHOLD) {
+      return nullptr;
+    }
+    return compile(pc);
+  }
+
+  // Runs the block, leaves the machine's state as running its guest
+  // instructions would have. Returns how many times the body ran.
+  uint64_t execute(const Block &block);
+  void clear();
+
+  const Stats &stats() const { return m_stats; }
+
+private:
+  // NOTE: Marks heads that don't start a region worth optimizing.
+  constexpr static uint16_t NEVER = 0xffff;
+
+  const Block *compile(MemPtr pc);
+  void invalidate(uint32_t first_line, uint32_t last_line);
+  void run(const std::vector<MicroOp> &ops);
+
+  Interpreter &m_interp;
+  uint32_t m_listener;
+  std::unordered_map<MemPtr, std::unique_ptr<Block>> m_blocks;
+  std::vector<uint16_t> m_heat;
+  std::vector<uint32_t> m_slots;
+  Stats m_stats;
+};
+
+#endif // OPTIMIZER_HXX
@@ -0,0 +1,98 @@
+#ifndef LINE_READER_HXX
+#define LINE_READER_HXX
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace generic_ling {
+
+class LineIterator;
+
+// NOTE: Streams lines (or any delimiter separated records) out of a file or
+// a descriptor without copying them into strings, so parsers can go through
+// inputs much larger than the memory in a constant amount of it.
+//
+// Files are mapped, a line is a view straight into the mapping and the
+// pages that were already consumed are handed back to the kernel as the
+// reader moves on. Pipes and stdin can't be mapped, they are read into two
+// buffers, when a line runs past the end of the current buffer its start is
+// moved to the other one and the rest is read after it. A line that doesn't
+// fit grows the buffers.
+//
+// Either way a line is only valid until the next call to next().
+class LineReader {
+public:
+  // Maps the file, falls back to reading when it can't be mapped. Throws
+  // std::runtime_error if the file can't be opened.
+  explicit LineReader(const std::string &path, char delimiter = '\n');
+  // Reads from an already open descriptor, it is not closed by the reader.
+  explicit LineReader(int fd, char delimiter = '\n');
+  ~LineReader();
+
+  LineReader(const LineReader &) = delete;
+  LineReader &operator=(const LineReader &) = delete;
+
+  // The next line without its delimiter, nullopt at the end of the input.
+  std::optional<std::string_view> next();
+
+  LineIterator begin();
+  LineIterator end();
+
+private:
+  constexpr static size_t BUFFER_SIZE = 256 * 1024;
+  // NOTE: Consumed pages are released in steps of this many bytes.
+  constexpr static size_t RELEASE_INTERVAL = 16 * 1024 * 1024;
+
+  std::optional<std::string_view> next_mapped();
+  std::optional<std::string_view> next_buffered();
+
+  int m_fd = -1;
+  bool m_owns_fd = false;
+  char m_delimiter;
+
+  const char *m_map = nullptr;
+  size_t m_map_size = 0;
+  size_t m_offset = 0;
+  size_t m_released = 0;
+
+  std::array<std::vector<char>, 2> m_buffers;
+  int m_current = 0;
+  size_t m_begin = 0;
+  size_t m_end = 0;
+  bool m_eof = false;
+};
+
+// NOTE: Single pass input iterator over a LineReader.
+class LineIterator {
+public:
+  LineIterator() = default;
+  explicit LineIterator(LineReader *reader) : m_reader(reader) { ++*this; }
+
+  LineIterator &operator++() {
+    m_line = m_reader->next();
+    if (!m_line) {
+      m_reader = nullptr;
+    }
+    return *this;
+  }
+
+  std::string_view operator*() const { return *m_line; }
+
+  bool operator==(const LineIterator &other) const {
+    return m_reader == other.m_reader;
+  }
+
+private:
+  LineReader *m_reader = nullptr;
+  std::optional<std::string_view> m_line;
+};
+
+inline LineIterator LineReader::begin() { return LineIterator(this); }
+inline LineIterator LineReader::end() { return LineIterator(); }
+
+} // namespace generic_ling
+
+#endif // LINE_READER_HXX
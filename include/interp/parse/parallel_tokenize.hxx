@@ -0,0 +1,72 @@
+#ifndef PARALLEL_TOKENIZE_HXX
+#define PARALLEL_TOKENIZE_HXX
+#include "syntax.hxx"
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// NOTE: Tokens of a newline separated batch of expressions, record i's
+// tokens are tokens[offsets[i], offsets[i + 1]).
+struct TokenizedRecords {
+  std::vector<ExpressionToken> tokens;
+  std::vector<size_t> offsets{0};
+
+  size_t record_count() const { return offsets.size() - 1; }
+};
+
+// NOTE: Tokenizes batches of expressions, one per line, on several threads.
+//
+// The input is cut into one chunk per job, every cut is moved forward to the
+// next newline so no record is split. Each chunk is tokenized into its own
+// buffer with its own symbol table, the chunks' symbols are then interned
+// into the shared table in chunk order (so the ids are the same the serial
+// tokenizer would give out) and the buffers are copied into place with the
+// ids remapped, again one thread per chunk.
+//
+// The worker threads are started once and wait for the next batch, the
+// calling thread works on a chunk as well. One batch is tokenized at a time.
+//
+// On error the records before the failing one are kept and the error's
+// position is relative to the start of the input.
+class ParallelTokenizer {
+public:
+  explicit ParallelTokenizer(
+      unsigned jobs = std::thread::hardware_concurrency());
+  ~ParallelTokenizer();
+
+  ParallelTokenizer(const ParallelTokenizer &) = delete;
+  ParallelTokenizer &operator=(const ParallelTokenizer &) = delete;
+
+  TokenizeError tokenize(std::string_view input, TokenizedRecords &output,
+                         SymbolTable &symbols);
+
+private:
+  // Runs task(i) for every i below count and waits for all of them.
+  void for_each(size_t count, const std::function<void(size_t)> &task);
+  void run_tasks(std::unique_lock<std::mutex> &lock);
+  void worker_loop();
+
+  unsigned m_jobs;
+  std::vector<std::thread> m_workers;
+  std::mutex m_mutex;
+  std::condition_variable m_work_ready;
+  std::condition_variable m_work_done;
+  const std::function<void(size_t)> *m_task = nullptr;
+  size_t m_count = 0;
+  size_t m_next = 0;
+  size_t m_finished = 0;
+  uint64_t m_generation = 0;
+  bool m_stopping = false;
+};
+
+// NOTE: One batch on threads of its own, keep a ParallelTokenizer around to
+// tokenize several.
+TokenizeError tokenize_parallel(std::string_view input,
+                                TokenizedRecords &output, SymbolTable &symbols,
+                                unsigned jobs = std::thread::hardware_concurrency());
+
+#endif // PARALLEL_TOKENIZE_HXX
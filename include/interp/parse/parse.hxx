@@ -1,6 +1,7 @@
 #ifndef PARSE_HXX
 #define PARSE_HXX
 #include <string>
+#include <string_view>
 #include <iostream>
 #include <stdexcept>
 
@@ -12,12 +13,18 @@ class ParseError : public std::runtime_error {
   using std::runtime_error::runtime_error;
 };
 
-using CharIter = decltype(std::declval<std::string>().begin());
+// NOTE: Parsing works on views so the input can come straight out of a
+// mapped file or a read buffer, see line_reader.hxx.
+using CharIter = std::string_view::const_iterator;
 
 void skip_whitespaces(CharIter& begin_iter, CharIter end_iter);
 std::pair<MathOperator, CharIter> parse_operator(CharIter begin_iter, CharIter end_iter);
 std::pair<int, CharIter> parse_int(CharIter begin_iter, CharIter end_iter);
 std::pair<double, CharIter> parse_float(CharIter begin_iter, CharIter end_iter);
 
+bool is_identifier_start(char c);
+// NOTE: The view points into the parsed string.
+std::pair<std::string_view, CharIter> parse_identifier(CharIter begin_iter, CharIter end_iter);
+
 std::ostream& operator<<(std::ostream& out_strm, MathOperator op);
 #endif // PARSE_HXX
@@ -0,0 +1,49 @@
+#ifndef SYMBOL_TABLE_HXX
+#define SYMBOL_TABLE_HXX
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+using SymbolId = uint32_t;
+
+// NOTE: Interns identifiers, every distinct name gets a 32-bit id and
+// comparing identifiers becomes an integer compare.
+//
+// The names are copied into a bump allocated arena, chunks are never moved
+// or freed before the table, so the views handed out stay valid. Lookups go
+// through an open addressing table (linear probing) of hash and id pairs,
+// a probe only touches the arena when the hashes match.
+class SymbolTable {
+public:
+  constexpr static SymbolId NO_SYMBOL = 0xffffffff;
+
+  SymbolTable();
+
+  SymbolId intern(std::string_view name);
+  // NO_SYMBOL if the name was never interned.
+  SymbolId find(std::string_view name) const;
+  std::string_view name(SymbolId id) const { return m_names[id]; }
+  size_t size() const { return m_names.size(); }
+
+private:
+  constexpr static size_t CHUNK_SIZE = 4096;
+  constexpr static size_t INITIAL_SLOT_COUNT = 64;
+
+  struct Slot {
+    uint32_t hash;
+    SymbolId id;
+  };
+
+  static uint32_t hash(std::string_view name);
+  size_t probe(std::string_view name, uint32_t hash) const;
+  std::string_view store(std::string_view name);
+  void grow();
+
+  std::vector<Slot> m_slots;
+  std::vector<std::string_view> m_names;
+  std::vector<std::unique_ptr<char[]>> m_chunks;
+  size_t m_chunk_used = 0;
+};
+
+#endif // SYMBOL_TABLE_HXX
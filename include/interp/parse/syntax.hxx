@@ -1,8 +1,12 @@
 #ifndef SYNTAX_HXX
 #define SYNTAX_HXX
+#include "line_reader.hxx"
 #include "parse.hxx"
+#include "symbol_table.hxx"
 #include <cstring>
 #include <iostream>
+#include <string>
+#include <type_traits>
 #include <vector>
 
 /*
@@ -15,20 +19,6 @@
   accessible to them.
 */
 
-namespace generic_ling {
-
-class LineIterator {
-public:
-  LineIterator operator++();
-  LineIterator operator--();
-  const std::string &operator*() const;
-
-private:
-  std::istream input_strm;
-};
-
-} // namespace generic_ling
-
 namespace math_ling {
 
 struct Value {};
@@ -44,7 +34,12 @@ struct SetOfTerms {
 
 struct TokenizeError {
 
-  enum Type { Nothing = 0, FailedParsing } type;
+  enum Type { Nothing = 0, FailedParsing, InternalTokenizerBugOrError } type;
+  // NOTE: Offset of the token that failed from the start of the input.
+  size_t position = 0;
+  // NOTE: What the parser complained about, the tokenizer never prints so
+  // it can run on any thread.
+  std::string message;
 };
 
 struct ExpressionToken {
@@ -53,8 +48,9 @@ struct ExpressionToken {
   union Value {
     double number;
     MathOperator math_operator;
-    // NOTE: All identifiers will be stored in a single block of memory
-    const char *identifier;
+    // NOTE: Identifiers are interned, the name lives in the SymbolTable the
+    // tokenizer was given.
+    SymbolId identifier;
 
     Value() { std::memset(this, 0, sizeof(Value)); }
   } value;
@@ -71,26 +67,46 @@ struct ExpressionToken {
     return t;
   }
 
+  static ExpressionToken MakeIdentifier(SymbolId id) {
+    auto t = ExpressionToken{IDENTIFIER, {}};
+    t.value.identifier = id;
+    return t;
+  }
+
   friend std::ostream &operator<<(std::ostream &, ExpressionToken);
 };
 
+static_assert(std::is_trivially_copyable_v<ExpressionToken>);
+
 // I would much prefer for this function to be in the source file but MSVC seems
 // to not like specialization of templates. The program doesn't seem to link
 // under MSVC if the implementation is in the source file.
 template <class Container>
 TokenizeError tokenize(CharIter begin_iter, CharIter end_iter,
-                       Container &output) {
+                       Container &output, SymbolTable &symbols) {
+  const CharIter input_begin = begin_iter;
 
   enum TokenizeState {
-    LOOKING_FOR_NUMBER,
+    LOOKING_FOR_OPERAND,
     LOOKING_FOR_OPERATOR
-  } ts = LOOKING_FOR_NUMBER;
+  } ts = LOOKING_FOR_OPERAND;
 
   while (begin_iter != end_iter) {
 
     try {
       switch (ts) {
-      case LOOKING_FOR_NUMBER: {
+      case LOOKING_FOR_OPERAND: {
+        skip_whitespaces(begin_iter, end_iter);
+        if (begin_iter != end_iter && is_identifier_start(*begin_iter)) {
+          auto res = parse_identifier(begin_iter, end_iter);
+          begin_iter = res.second;
+          auto token =
+              ExpressionToken::MakeIdentifier(symbols.intern(res.first));
+          output.push_back(token);
+          ts = LOOKING_FOR_OPERATOR;
+          continue;
+        }
+
         auto res = parse_float(begin_iter, end_iter);
         begin_iter = res.second;
         auto token = ExpressionToken::MakeNumber(res.first);
@@ -103,7 +119,7 @@ TokenizeError tokenize(CharIter begin_iter, CharIter end_iter,
         begin_iter = res.second;
         auto token = ExpressionToken::MakeMathOperator(res.first);
         output.push_back(token);
-        ts = LOOKING_FOR_NUMBER;
+        ts = LOOKING_FOR_OPERAND;
         continue;
       }
       default:
@@ -111,9 +127,33 @@ TokenizeError tokenize(CharIter begin_iter, CharIter end_iter,
       }
 
     } catch (ParseError pe) {
-      std::cout << "Error while parsing: " << pe.what() << std::endl;
-      return TokenizeError{.type = TokenizeError::Type::FailedParsing};
+      return TokenizeError{
+          .type = TokenizeError::Type::FailedParsing,
+          .position = static_cast<size_t>(begin_iter - input_begin),
+          .message = pe.what()};
+    }
+  }
+  return TokenizeError{.type = TokenizeError::Type::Nothing};
+}
+
+// NOTE: Tokenizes one expression per line, on_line gets each line's tokens.
+// The token buffer is reused and the lines are never copied, so memory only
+// grows with the number of distinct identifiers, not with the input.
+template <class Callback>
+TokenizeError tokenize_lines(generic_ling::LineReader &reader,
+                             SymbolTable &symbols, Callback &&on_line) {
+  std::vector<ExpressionToken> tokens;
+  size_t consumed = 0;
+
+  while (auto line = reader.next()) {
+    tokens.clear();
+    auto err = tokenize(line->begin(), line->end(), tokens, symbols);
+    if (err.type != TokenizeError::Type::Nothing) {
+      err.position += consumed;
+      return err;
     }
+    on_line(tokens);
+    consumed += line->size() + 1;
   }
   return TokenizeError{.type = TokenizeError::Type::Nothing};
 }
@@ -0,0 +1,91 @@
+#ifndef PERF_COUNTERS_HXX
+#define PERF_COUNTERS_HXX
+#include <array>
+#include <cstdint>
+#include <iostream>
+
+// NOTE: Host performance counters around interpreter runs, to tell why one
+// dispatch strategy beats another instead of only that it does.
+//
+// The counters are opened with perf_event_open for the calling thread (user
+// space only, so the default perf_event_paranoid level is enough). Every
+// counter is opened on its own, a CPU without an L1-I miss event still gets
+// the other ones. When none of them can be opened (containers, other
+// kernels) only the time stamp counter is read, which is always done anyway.
+//
+// Attached to an interpreter (Interpreter::m_perf) the whole run is counted,
+// unless the guest marks a region with perfm, then only the marked regions
+// are. Guest instructions run by the blocks of the optimizing tier or by
+// native code are counted as compiled instead of dispatched.
+class PerfCounters {
+public:
+  enum Counter {
+    CYCLES,
+    INSTRUCTIONS,
+    BRANCH_MISSES,
+    L1I_MISSES,
+    L1D_MISSES,
+    ITLB_MISSES,
+    COUNTER_COUNT
+  };
+
+  // NOTE: Actions of the perfm instruction.
+  enum MarkAction : uint8_t { BEGIN_REGION = 0, END_REGION = 1 };
+
+  PerfCounters();
+  ~PerfCounters();
+
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters &operator=(const PerfCounters &) = delete;
+
+  bool has_hardware_counters() const;
+  bool is_available(Counter counter) const { return m_fds[counter] >= 0; }
+
+  // Starts and stops counting, the counts of all the intervals add up.
+  void start();
+  void stop();
+  bool is_counting() const { return m_counting; }
+  void reset();
+
+  // NOTE: The perfm instruction checks the action before it gets here.
+  void mark(MarkAction action);
+  bool has_marks() const { return m_marked; }
+
+  // NOTE: Called by the instrumented run loops. Instructions that ran in
+  // compiled code (the blocks of the optimizing tier and native code from
+  // the aot tool) are counted in bulk.
+  void count_dispatch() { m_dispatches += m_counting; }
+  void count_native_entry() { m_native_entries += m_counting; }
+  void count_compiled(uint64_t guest_instructions) {
+    m_compiled_instructions += m_counting ? guest_instructions : 0;
+  }
+
+  // Scaled for multiplexing, 0 when the counter is not available.
+  uint64_t value(Counter counter) const { return m_values[counter]; }
+  uint64_t tsc_ticks() const { return m_tsc_ticks; }
+  uint64_t dispatches() const { return m_dispatches; }
+  uint64_t guest_instructions() const {
+    return m_dispatches + m_compiled_instructions;
+  }
+
+  // Host cycles (time stamp counter ticks without counters) per guest
+  // instruction and branch mispredictions per dispatch.
+  double cycles_per_instruction() const;
+  double mispredicts_per_dispatch() const;
+
+  // NOTE: One flat object, unavailable counters are null.
+  void write_json(std::ostream &out) const;
+
+private:
+  std::array<int, COUNTER_COUNT> m_fds;
+  std::array<uint64_t, COUNTER_COUNT> m_values{};
+  uint64_t m_tsc_start = 0;
+  uint64_t m_tsc_ticks = 0;
+  uint64_t m_dispatches = 0;
+  uint64_t m_native_entries = 0;
+  uint64_t m_compiled_instructions = 0;
+  bool m_counting = false;
+  bool m_marked = false;
+};
+
+#endif // PERF_COUNTERS_HXX
@@ -0,0 +1,58 @@
+#ifndef SCHEDULER_HXX
+#define SCHEDULER_HXX
+#include "interpreter.hxx"
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// NOTE: The scheduler multiplexes many virtual machines over a fixed set of
+// worker threads. Every machine gets the same time slice and a preempted
+// machine goes to the back of the run queue, so a runaway guest can only ever
+// delay the others by a single slice.
+class Scheduler {
+public:
+  using RunStatus = Interpreter::RunStatus;
+  using FinishedCallback = std::function<void(VirtualMachine &, RunStatus)>;
+
+  Scheduler(size_t worker_count, std::chrono::microseconds time_slice);
+  // NOTE: Machines that haven't finished yet are handed to their callbacks
+  // as PREEMPTED after at most one more slice, they can be resumed
+  // elsewhere. A guest that never halts doesn't keep the destructor waiting.
+  ~Scheduler();
+
+  Scheduler(const Scheduler &) = delete;
+  Scheduler &operator=(const Scheduler &) = delete;
+
+  // NOTE: The machine has to have a program loaded and be started. It must
+  // not be touched by the caller until on_finished has been called.
+  void submit(VirtualMachine &vm, FinishedCallback on_finished = {});
+
+  // Blocks until every submitted machine has finished.
+  void wait_idle();
+
+private:
+  struct Job {
+    VirtualMachine *vm;
+    FinishedCallback on_finished;
+  };
+
+  void worker_loop();
+
+  std::chrono::microseconds m_time_slice;
+
+  std::mutex m_mutex;
+  std::condition_variable m_work_available;
+  std::condition_variable m_idle;
+  std::deque<Job> m_run_queue;
+  size_t m_unfinished = 0;
+  bool m_stopping = false;
+
+  std::vector<std::thread> m_workers;
+};
+
+#endif // SCHEDULER_HXX
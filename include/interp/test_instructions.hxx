@@ -4,10 +4,37 @@
 #define NOT_IMPLEMENTED FAIL_TEST("Test not implemented");
 #include "instructions.hxx"
 #include "interpreter.hxx"
+#include "assembler/assembler.hxx"
+#include "assembler/linker.hxx"
+#include "console.hxx"
+#include "disassembler.hxx"
+#include "io_loop.hxx"
+#include "metrics.hxx"
+#include "numeric.hxx"
+#include "optimizer.hxx"
+#include "parse/parallel_tokenize.hxx"
+#include "parse/syntax.hxx"
+#include "perf_counters.hxx"
+#include "scheduler.hxx"
+#include "trace.hxx"
+#include "wide_interpreter.hxx"
+#include <arpa/inet.h>
 #include <boost/format.hpp>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <netinet/in.h>
 #include <optional>
+#include <sstream>
 #include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
 
 // NOTE: Implement interface for Testers so that we can use the
 // same technique for other part of the program. This way testing the program
@@ -129,6 +156,1878 @@ public:
        [](VirtualMachine &vm) -> std::vector<TestError> { NOT_IMPLEMENTED; }},
       {"test_jump_instructions",
        [](VirtualMachine &vm) -> std::vector<TestError> { NOT_IMPLEMENTED; }},
+      {"test_call_instructions",
+       [](VirtualMachine &vm) -> std::vector<TestError> {
+         using OPS = VM::OpCodes;
+         using RunStatus = Interpreter::RunStatus;
+         vm.reset();
+
+         std::vector<TestError> test_errors;
+         auto &interp = vm.m_interp;
+         auto &regs = interp.m_mb.gp_regs_32;
+
+         auto expect = [&](const char *what, uint32_t expected, uint32_t found) {
+           if (expected != found) {
+             test_errors.push_back((boost::format("Invalid %1%:\n\t"
+                                                  "Expected: %2%\n\t"
+                                                  "Found: %3%\n") %
+                                    what % expected % found)
+                                       .str());
+           }
+         };
+
+         // clang-format off
+         Interpreter::BytecodeBuffer bb{
+                OPS::CALL, LITTLE_U32(0x00, 0x00, 0x00, 0x06),        // 0x00
+                OPS::HALT,                                            // 0x05
+                OPS::ENTER, 0x08, 0x00,                               // 0x06
+                OPS::PUSH_MULTIPLE_STACK, 0x06, 0x00,                 // 0x09
+                OPS::LOAD_IMMEDIATE, LITTLE_U32(0x00, 0x00, 0x00, 0x07), 0x01,
+                OPS::ADD_INT, 0x01, 0x02, 0x03,
+                OPS::POP_MULTIPLE_STACK, 0x06, 0x00,
+                OPS::LEAVE,
+                OPS::RETURN
+         };
+         // clang-format on
+
+         interp.load_program(bb);
+         regs[1] = 5;
+         regs[2] = 9;
+         interp.start();
+         interp.run();
+
+         expect("sum register", 16, regs[3]);
+         expect("restored register", 5, regs[1]);
+         expect("restored register", 9, regs[2]);
+         expect("stack pointer", MemoryBank::STACK_UPPER_LIMIT,
+                regs[MemoryBank::STACK_PTR_REG]);
+         expect("frame pointer", 0, regs[MemoryBank::FRAME_PTR_REG]);
+
+         // NOTE: A register call, a return to an address the guest pushed
+         // itself and a return out of a trap handler, none of them has a
+         // matching call.
+         // clang-format off
+         bb = {
+                OPS::LOAD_IMMEDIATE, LITTLE_U32(0x00, 0x00, 0x00, 0x18), 0x04,
+                OPS::CALL_REGISTER, 0x04,                             // 0x06
+                OPS::PUSH_MULTIPLE_STACK, 0x20, 0x00,                 // 0x08
+                OPS::RETURN,                                          // 0x0b
+                OPS::HALT,                                            // 0x0c
+                OPS::TRAP_VECTOR, static_cast<uint8_t>(Trap::DIVIDE_BY_ZERO),
+                LITTLE_U32(0x00, 0x00, 0x00, 0x1f),                   // 0x0d
+                OPS::DIV_INT, 0x01, 0x02, 0x03,                       // 0x13
+                OPS::HALT,                                            // 0x17
+                OPS::LOAD_IMMEDIATE, LITTLE_U32(0x00, 0x00, 0x00, 0x07), 0x06,
+                OPS::RETURN,                                          // 0x1e
+                OPS::LOAD_IMMEDIATE, LITTLE_U32(0x00, 0x00, 0x00, 0x01), 0x02,
+                OPS::RETURN                                           // 0x25
+         };
+         // clang-format on
+
+         vm.reset();
+         interp.load_program(bb);
+         regs[1] = 42;
+         regs[5] = 0x0d;
+         auto predictions = interp.return_stack_stats();
+         interp.start();
+         RunStatus status = interp.run();
+
+         // The function at 0x18 loads 7 and returns to 0x08, which pushes
+         // 0x0d and returns there. The handler of the divide by zero at 0x1f
+         // returns into the division again.
+         expect("register call status", static_cast<uint32_t>(RunStatus::HALTED),
+                static_cast<uint32_t>(status));
+         expect("register call result", 7, regs[6]);
+         expect("retried division", 42, regs[3]);
+         expect("stack pointer", MemoryBank::STACK_UPPER_LIMIT,
+                regs[MemoryBank::STACK_PTR_REG]);
+         // Only the register call's return was predicted.
+         expect("predicted returns", 1,
+                interp.return_stack_stats().hits - predictions.hits);
+         expect("mispredicted returns", 2,
+                interp.return_stack_stats().misses - predictions.misses);
+
+         // NOTE: 100 nested calls, the return stack predicts the innermost
+         // RETURN_STACK_SIZE returns, the rest come from the guest stack.
+         // clang-format off
+         bb = {
+                OPS::LOAD_IMMEDIATE, LITTLE_U32(0x00, 0x00, 0x00, 0x64), 0x01,
+                OPS::CALL, LITTLE_U32(0x00, 0x00, 0x00, 0x0c),        // 0x06
+                OPS::HALT,                                            // 0x0b
+                OPS::SUB_INT_IMMEDIATE, 0x01, LITTLE_U32(0x00, 0x00, 0x00, 0x01), 0x01,
+                OPS::COMPARE, 0x01, 0x00,                             // 0x13
+                OPS::JUMP_EQUAL, LITTLE_U32(0x00, 0x00, 0x00, 0x20),  // 0x16
+                OPS::CALL, LITTLE_U32(0x00, 0x00, 0x00, 0x0c),        // 0x1b
+                OPS::RETURN                                           // 0x20
+         };
+         // clang-format on
+
+         vm.reset();
+         interp.load_program(bb);
+         predictions = interp.return_stack_stats();
+         interp.start();
+         status = interp.run();
+
+         expect("recursion status", static_cast<uint32_t>(RunStatus::HALTED),
+                static_cast<uint32_t>(status));
+         expect("stack pointer", MemoryBank::STACK_UPPER_LIMIT,
+                regs[MemoryBank::STACK_PTR_REG]);
+         expect("predicted returns", Interpreter::RETURN_STACK_SIZE,
+                interp.return_stack_stats().hits - predictions.hits);
+         expect("mispredicted returns", 100 - Interpreter::RETURN_STACK_SIZE,
+                interp.return_stack_stats().misses - predictions.misses);
+
+         // NOTE: The byte sized push and pop share the stack with the return
+         // address, a balanced pair in the function must leave it intact.
+         // clang-format off
+         bb = {
+                OPS::LOAD_IMMEDIATE, LITTLE_U32(0x00, 0x00, 0x00, 0xc8), 0x01,
+                OPS::CALL, LITTLE_U32(0x00, 0x00, 0x00, 0x0c),        // 0x06
+                OPS::HALT,                                            // 0x0b
+                OPS::PUSH_STACK, 0x01,                                // 0x0c
+                OPS::POP_STACK, 0x02,                                 // 0x0e
+                OPS::RETURN                                           // 0x10
+         };
+         // clang-format on
+
+         vm.reset();
+         interp.load_program(bb);
+         interp.start();
+         status = interp.run();
+
+         expect("push in a call status",
+                static_cast<uint32_t>(RunStatus::HALTED),
+                static_cast<uint32_t>(status));
+         expect("popped register", 200, regs[2]);
+         expect("stack pointer", MemoryBank::STACK_UPPER_LIMIT,
+                regs[MemoryBank::STACK_PTR_REG]);
+
+         // NOTE: Everything below has to trap before it touches the stack.
+         // The operand is the register mask, the frame size or the register
+         // pushed or popped. The frame pointer starts where the stack pointer
+         // does. A full stack overflows, an empty one (or a pointer above it)
+         // underflows.
+         auto expect_trap = [&](const char *what, uint8_t opcode,
+                                uint32_t stack_ptr, Trap expected,
+                                uint16_t operand = 0) {
+           Interpreter::BytecodeBuffer code{opcode};
+           if (opcode == OPS::CALL) {
+             code.insert(code.end(), {LITTLE_U32(0x00, 0x00, 0x00, 0x00)});
+           } else if (opcode == OPS::PUSH_STACK || opcode == OPS::POP_STACK) {
+             code.insert(code.end(), {static_cast<uint8_t>(operand)});
+           } else if (opcode != OPS::RETURN && opcode != OPS::LEAVE) {
+             code.insert(code.end(), {static_cast<uint8_t>(operand & 0xff),
+                                      static_cast<uint8_t>(operand >> 8)});
+           }
+           code.insert(code.end(), {OPS::HALT});
+
+           vm.reset();
+           interp.load_program(code);
+           regs[MemoryBank::STACK_PTR_REG] = stack_ptr;
+           regs[MemoryBank::FRAME_PTR_REG] = stack_ptr;
+           interp.start();
+           RunStatus status = interp.run();
+
+           if (status != RunStatus::TRAPPED || interp.last_trap().pc != 0 ||
+               interp.last_trap().trap != expected ||
+               regs[MemoryBank::STACK_PTR_REG] != stack_ptr) {
+             test_errors.push_back(
+                 (boost::format("%1% was not trapped:\n\t"
+                                "Trap: %2% (expected %3%), Stack pointer: "
+                                "%4%\n") %
+                  what % trap_name(interp.last_trap().trap) %
+                  trap_name(expected) % regs[MemoryBank::STACK_PTR_REG])
+                     .str());
+           }
+         };
+
+         expect_trap("Call on a full stack", OPS::CALL, 2,
+                     Trap::STACK_OVERFLOW);
+         expect_trap("Pushm on a full stack", OPS::PUSH_MULTIPLE_STACK, 8,
+                     Trap::STACK_OVERFLOW, 0x0007);
+         expect_trap("Enter on a full stack", OPS::ENTER, 2,
+                     Trap::STACK_OVERFLOW);
+         expect_trap("Push on a full stack", OPS::PUSH_STACK,
+                     MemoryBank::STACK_LOWER_LIMIT, Trap::STACK_OVERFLOW, 1);
+         expect_trap("Return on an empty stack", OPS::RETURN,
+                     MemoryBank::STACK_UPPER_LIMIT, Trap::STACK_UNDERFLOW);
+         expect_trap("Popm on an empty stack", OPS::POP_MULTIPLE_STACK,
+                     MemoryBank::STACK_UPPER_LIMIT - 4, Trap::STACK_UNDERFLOW,
+                     0x0003);
+         expect_trap("Pop on an empty stack", OPS::POP_STACK,
+                     MemoryBank::STACK_UPPER_LIMIT, Trap::STACK_UNDERFLOW, 1);
+         expect_trap("Leave on an empty stack", OPS::LEAVE,
+                     MemoryBank::STACK_UPPER_LIMIT, Trap::STACK_UNDERFLOW);
+         expect_trap("Call with the stack pointer out of memory", OPS::CALL,
+                     0xfffffff0, Trap::STACK_UNDERFLOW);
+         expect_trap("Push with the stack pointer out of memory",
+                     OPS::PUSH_STACK, 0xfffffff0, Trap::STACK_UNDERFLOW, 1);
+
+         // NOTE: Popping the stack pointer would move it anywhere, the
+         // special registers can't be saved with pushm and popm.
+         for (uint8_t opcode :
+              {OPS::PUSH_MULTIPLE_STACK, OPS::POP_MULTIPLE_STACK}) {
+           for (RegID r = MemoryBank::STACK_PTR_REG;
+                r < MemoryBank::GP_REGS_32_COUNT; r++) {
+             expect_trap("Special register in the mask", opcode,
+                         MemoryBank::STACK_UPPER_LIMIT - 64,
+                         Trap::INVALID_OPERAND, (1u << r) | 1u);
+           }
+         }
+
+         vm.reset();
+         return test_errors;
+       }},
+      {"test_budgeted_runs",
+       [](VirtualMachine &vm) -> std::vector<TestError> {
+         using OPS = VM::OpCodes;
+         using RunStatus = Interpreter::RunStatus;
+         vm.reset();
+
+         std::vector<TestError> test_errors;
+
+         auto expect = [&](const char *what, RunStatus status,
+                           RunStatus expected_status, uint32_t iterations,
+                           uint32_t expected_iterations) {
+           if (status != expected_status || iterations != expected_iterations) {
+             test_errors.push_back(
+                 (boost::format("Invalid %1%:\n\t"
+                                "Status: %2%, Iterations: %3% (expected %4%, "
+                                "%5%)\n") %
+                  what % static_cast<int>(status) % iterations %
+                  static_cast<int>(expected_status) % expected_iterations)
+                     .str());
+           }
+         };
+
+         // NOTE: Every iteration is one jump, one unit of budget.
+         // clang-format off
+         Interpreter::BytecodeBuffer runaway{
+                OPS::ADD_INT_IMMEDIATE, 0x01, LITTLE_U32(0x00, 0x00, 0x00, 0x01), 0x01,
+                OPS::JUMP, LITTLE_U32(0x00, 0x00, 0x00, 0x00)
+         };
+         Interpreter::BytecodeBuffer counter{
+                OPS::LOAD_IMMEDIATE, LITTLE_U32(0x00, 0x00, 0x27, 0x10), 0x02,
+                OPS::ADD_INT_IMMEDIATE, 0x01, LITTLE_U32(0x00, 0x00, 0x00, 0x01), 0x01, // 6
+                OPS::COMPARE, 0x02, 0x01,
+                OPS::JUMP_GREATER_THAN, LITTLE_U32(0x00, 0x00, 0x00, 0x06),
+                OPS::HALT
+         };
+         // clang-format on
+
+         auto &interp = vm.m_interp;
+         auto &regs = interp.m_mb.gp_regs_32;
+         interp.load_program(runaway);
+         interp.start();
+
+         RunStatus status = interp.run_for(0);
+         expect("empty budget", status, RunStatus::PREEMPTED, regs[1], 0);
+         status = interp.run_for(10);
+         expect("budgeted run", status, RunStatus::PREEMPTED, regs[1], 10);
+         status = interp.run_for(5);
+         expect("resumed run", status, RunStatus::PREEMPTED, regs[1], 15);
+
+         auto deadline =
+             Interpreter::Clock::now() + std::chrono::milliseconds(5);
+         status = interp.run_until(deadline);
+         if (status != RunStatus::PREEMPTED ||
+             Interpreter::Clock::now() < deadline || regs[1] <= 15) {
+           test_errors.push_back("Deadline was not kept.\n");
+         }
+
+         // NOTE: The counter needs several slices, the runaway machine
+         // never finishes and is handed back when the scheduler goes away.
+         auto finite = std::make_unique<VirtualMachine>();
+         auto endless = std::make_unique<VirtualMachine>();
+         finite->m_interp.load_program(counter);
+         finite->m_interp.start();
+         endless->m_interp.load_program(runaway);
+         endless->m_interp.start();
+
+         std::mutex mutex;
+         std::vector<std::pair<VirtualMachine *, RunStatus>> finished;
+         auto on_finished = [&](VirtualMachine &machine, RunStatus status) {
+           std::lock_guard<std::mutex> lock(mutex);
+           finished.push_back({&machine, status});
+         };
+
+         {
+           Scheduler scheduler(2, std::chrono::microseconds(50));
+           scheduler.submit(*finite, on_finished);
+           scheduler.wait_idle();
+           scheduler.submit(*endless, on_finished);
+           std::this_thread::sleep_for(std::chrono::milliseconds(5));
+         }
+
+         if (finished.size() != 2 || finished[0].first != finite.get() ||
+             finished[1].first != endless.get()) {
+           test_errors.push_back("Scheduler did not hand back every machine.\n");
+         } else {
+           expect("scheduled counter", finished[0].second, RunStatus::HALTED,
+                  finite->m_interp.m_mb.gp_regs_32[1], 10000);
+           expect("stopped scheduler", finished[1].second,
+                  RunStatus::PREEMPTED, 0, 0);
+         }
+
+         uint32_t before = endless->m_interp.m_mb.gp_regs_32[1];
+         status = endless->m_interp.run_for(3);
+         expect("machine resumed after the scheduler", status,
+                RunStatus::PREEMPTED,
+                endless->m_interp.m_mb.gp_regs_32[1] - before, 3);
+
+         vm.reset();
+         return test_errors;
+       }},
+      {"test_io_instructions",
+       [](VirtualMachine &vm) -> std::vector<TestError> {
+         using OPS = VM::OpCodes;
+         vm.reset();
+
+         std::vector<TestError> test_errors;
+
+         // Loopback connection, the guest reads from the accepted end.
+         int listener = socket(AF_INET, SOCK_STREAM, 0);
+         sockaddr_in addr{};
+         addr.sin_family = AF_INET;
+         addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+         socklen_t addr_len = sizeof(addr);
+         if (listener < 0 ||
+             bind(listener, reinterpret_cast<sockaddr *>(&addr), addr_len) ||
+             listen(listener, 1) ||
+             getsockname(listener, reinterpret_cast<sockaddr *>(&addr),
+                         &addr_len)) {
+           test_errors.push_back(
+               (boost::format("Failed to listen on loopback (errno: %1%)\n") %
+                errno)
+                   .str());
+           if (listener >= 0) {
+             close(listener);
+           }
+           return test_errors;
+         }
+
+         int client = socket(AF_INET, SOCK_STREAM, 0);
+         if (client < 0 ||
+             connect(client, reinterpret_cast<sockaddr *>(&addr), addr_len)) {
+           test_errors.push_back(
+               (boost::format("Failed to connect (errno: %1%)\n") % errno)
+                   .str());
+           if (client >= 0) {
+             close(client);
+           }
+           close(listener);
+           return test_errors;
+         }
+         int server = accept(listener, nullptr, nullptr);
+
+         char file_name[] = "/tmp/interp_io_test_XXXXXX";
+         int file = mkstemp(file_name);
+         if (server < 0 || file < 0) {
+           test_errors.push_back(
+               (boost::format("Failed to set up the descriptors (errno: %1%)\n") %
+                errno)
+                   .str());
+           for (int fd : {client, server, listener, file}) {
+             if (fd >= 0) {
+               close(fd);
+             }
+           }
+           if (file >= 0) {
+             unlink(file_name);
+           }
+           return test_errors;
+         }
+
+         // clang-format off
+         Interpreter::BytecodeBuffer bb{
+                OPS::IO_READ, 0x00, 0x01, 0x02, 0x03,
+                OPS::IO_WRITE, 0x04, 0x01, 0x03, 0x05,
+                OPS::HALT
+         };
+         // clang-format on
+
+         IoLoop loop;
+         vm.m_interp.load_program(bb);
+         auto &regs = vm.m_interp.m_mb.gp_regs_32;
+         regs[0] = loop.attach_handle(vm, server);
+         regs[1] = 0x0200;
+         regs[2] = 16;
+         regs[4] = loop.attach_handle(vm, file);
+         vm.m_interp.start();
+
+         // The data only arrives after the machine has been suspended.
+         ssize_t sent = 0;
+         std::thread sender([client, &sent]() {
+           std::this_thread::sleep_for(std::chrono::milliseconds(10));
+           sent = write(client, "ping", 4);
+         });
+
+         loop.spawn(vm);
+         loop.run();
+         sender.join();
+
+         if (sent != 4) {
+           test_errors.push_back(
+               (boost::format("Failed to send the data: %1%\n") % sent).str());
+         }
+
+         char contents[16] = {0};
+         ssize_t file_size = pread(file, contents, sizeof(contents), 0);
+
+         if (regs[3] != 4 || regs[5] != 4 || file_size != 4 ||
+             std::string(contents) != "ping") {
+           test_errors.push_back(
+               (boost::format("Invalid I/O result:\n\t"
+                              "Read: %1%, Written: %2%, File: '%3%'\n") %
+                (int32_t)regs[3] % (int32_t)regs[5] % contents)
+                   .str());
+         }
+
+         // NOTE: A reset machine suspended on I/O runs the next program.
+         vm.reset();
+         vm.m_interp.set_async_io(true);
+         vm.m_interp.load_program(bb);
+         regs[0] = vm.m_interp.attach_handle(server);
+         vm.m_interp.start();
+         auto suspended = vm.m_interp.run();
+
+         vm.reset();
+         Interpreter::BytecodeBuffer halt{OPS::HALT};
+         vm.m_interp.load_program(halt);
+         vm.m_interp.start();
+         auto after_reset = vm.m_interp.run();
+
+         if (suspended != Interpreter::RunStatus::WAITING_FOR_IO ||
+             after_reset != Interpreter::RunStatus::HALTED ||
+             vm.m_interp.handle_to_fd(0) != -1) {
+           test_errors.push_back(
+               (boost::format("Reset kept the I/O state (status: %1%)\n") %
+                static_cast<int>(after_reset))
+                   .str());
+         }
+
+         close(client);
+         close(server);
+         close(listener);
+         close(file);
+         unlink(file_name);
+
+         vm.reset();
+         return test_errors;
+       }},
+      {"test_heap_instructions",
+       [](VirtualMachine &vm) -> std::vector<TestError> {
+         using OPS = VM::OpCodes;
+         vm.reset();
+
+         std::vector<TestError> test_errors;
+
+         // clang-format off
+         Interpreter::BytecodeBuffer bb{
+                OPS::ALLOCATE, 0x00, 0x01,             // r1 = alloc(r0)
+                OPS::ALLOCATE, 0x00, 0x02,             // r2 = alloc(r0)
+                OPS::FREE, 0x01,
+                OPS::ALLOCATE, 0x00, 0x03,             // r3 reuses r1's block
+                OPS::STORE_BYTE, 0x04, LITTLE_U32(0x00, 0x00, 0x80, 0x20),
+                OPS::REALLOCATE, 0x02, 0x05, 0x06,     // r6 = realloc(r2, r5)
+                OPS::HALT
+         };
+         // clang-format on
+
+         vm.m_interp.load_program(bb);
+         auto &regs = vm.m_interp.m_mb.gp_regs_32;
+         regs[0] = 20;
+         regs[4] = 0x5a;
+         regs[5] = 2000;
+         vm.m_interp.start();
+         vm.m_interp.run();
+
+         auto stats = vm.m_interp.m_heap.stats();
+
+         if (regs[1] != MemoryBank::HEAP_LOWER_LIMIT ||
+             regs[2] != MemoryBank::HEAP_LOWER_LIMIT + 32 ||
+             regs[3] != regs[1] || regs[6] == 0 ||
+             vm.m_interp.m_mb.memory[regs[6]] != 0x5a ||
+             stats.live_blocks != 2 || stats.bytes_requested != 2020) {
+           test_errors.push_back(
+               (boost::format("Invalid heap state:\n\t"
+                              "Blocks: %1% %2% %3% %4%\n\t"
+                              "Live blocks: %5%, Requested: %6%\n") %
+                regs[1] % regs[2] % regs[3] % regs[6] % stats.live_blocks %
+                stats.bytes_requested)
+                   .str());
+         }
+
+         // NOTE: Once a burst of small blocks is freed their pages serve a
+         // block as large as the whole heap.
+         auto &heap = vm.m_interp.m_heap;
+         heap.reset();
+         uint32_t pages = heap.stats().free_pages;
+         std::vector<uint32_t> blocks;
+         while (uint32_t block = heap.allocate(GuestHeap::MIN_BLOCK_SIZE)) {
+           blocks.push_back(block);
+         }
+         for (uint32_t block : blocks) {
+           heap.free(block);
+         }
+
+         auto freed = heap.stats();
+         uint32_t large = heap.allocate(pages * GuestHeap::PAGE_SIZE);
+         if (blocks.size() != pages * (GuestHeap::PAGE_SIZE /
+                                       GuestHeap::MIN_BLOCK_SIZE) ||
+             freed.free_pages != pages || freed.free_block_bytes != 0 ||
+             large != MemoryBank::HEAP_LOWER_LIMIT) {
+           test_errors.push_back(
+               (boost::format("Pages were not given back:\n\t"
+                              "Free pages: %1% of %2%, Free block bytes: %3%, "
+                              "Large block: %4%\n") %
+                freed.free_pages % pages % freed.free_block_bytes % large)
+                   .str());
+         }
+
+         // NOTE: The heap starts right above the stack, a push on the empty
+         // stack must not reach the first block.
+         // clang-format off
+         bb = {
+                OPS::ALLOCATE, 0x00, 0x01,             // r1 = alloc(r0)
+                OPS::STORE_BYTE, 0x04, LITTLE_U32(0x00, 0x00, 0x80, 0x00),
+                OPS::PUSH_STACK, 0x05,
+                OPS::HALT
+         };
+         // clang-format on
+
+         vm.reset();
+         vm.m_interp.load_program(bb);
+         regs[0] = 20;
+         regs[4] = 0x5a;
+         regs[5] = 99;
+         vm.m_interp.start();
+         vm.m_interp.run();
+
+         if (regs[1] != 0x8000 || vm.m_interp.m_mb.memory[0x8000] != 0x5a) {
+           test_errors.push_back(
+               (boost::format("Push reached the heap:\n\t"
+                              "Block: %1%, First byte: %2%\n") %
+                regs[1] % int(vm.m_interp.m_mb.memory[0x8000]))
+                   .str());
+         }
+
+         vm.reset();
+         return test_errors;
+       }},
+      {"test_binary_trace",
+       [](VirtualMachine &vm) -> std::vector<TestError> {
+         using OPS = VM::OpCodes;
+         vm.reset();
+
+         std::vector<TestError> test_errors;
+
+         // clang-format off
+         Interpreter::BytecodeBuffer bb{
+                OPS::LOAD_IMMEDIATE, LITTLE_U32(0x00, 0x00, 0x00, 0x05), 0x01,
+                OPS::LOAD_IMMEDIATE, LITTLE_U32(0x00, 0x00, 0x00, 0x07), 0x02,
+                OPS::ADD_INT, 0x01, 0x02, 0x03,                        // 12
+                OPS::STORE, 0x03, LITTLE_U32(0x00, 0x00, 0x01, 0x00),  // 16
+                OPS::HALT                                              // 22
+         };
+         // clang-format on
+
+         auto &interp = vm.m_interp;
+
+         // Returns the drained records without the file header.
+         auto traced_run = [&](TraceBuffer &trace) {
+           vm.reset();
+           interp.m_trace = &trace;
+           interp.load_program(bb);
+           interp.start();
+           interp.run();
+           interp.m_trace = nullptr;
+
+           std::ostringstream out;
+           TraceBuffer::write_header(out);
+           size_t count = trace.drain(out);
+
+           std::string bytes = out.str();
+           std::vector<TraceRecord> records(count);
+           if (bytes.size() == sizeof(TraceFileHeader) +
+                                   count * sizeof(TraceRecord)) {
+             std::memcpy(records.data(), bytes.data() + sizeof(TraceFileHeader),
+                         count * sizeof(TraceRecord));
+           }
+           return records;
+         };
+
+         TraceBuffer trace(8);
+         auto records = traced_run(trace);
+         std::ostringstream listing;
+         if (records.size() == 5) {
+           print_trace_record(listing, records[2]);
+         }
+
+         if (records.size() != 5 || trace.dropped() != 0 ||
+             records[0].pc != 0 || records[0].reg != 1 ||
+             records[0].reg_value != 5 || records[3].pc != 16 ||
+             records[3].address != 0x100 ||
+             records[4].opcode != OPS::HALT ||
+             listing.str() != "0000000c  add       r3 = 12\n") {
+           test_errors.push_back(
+               (boost::format("Invalid trace:\n\t"
+                              "Records: %1%, Dropped: %2%, Decoded: '%3%'\n") %
+                records.size() % trace.dropped() % listing.str())
+                   .str());
+         }
+
+         // NOTE: Only the newest records survive a full buffer, 3 is
+         // rounded up to 4. The oldest one left may be getting overwritten
+         // while it is drained, it is dropped too.
+         TraceBuffer small(3);
+         records = traced_run(small);
+         if (records.size() != 3 || small.dropped() != 2 ||
+             records[0].pc != 12 || records[2].pc != 22) {
+           test_errors.push_back(
+               (boost::format("Invalid wrapped trace:\n\t"
+                              "Records: %1%, Dropped: %2%\n") %
+                records.size() % small.dropped())
+                   .str());
+         }
+
+         TraceBuffer lapped(4);
+         std::ostringstream drained;
+         for (uint32_t pc = 0; pc < 10; pc++) {
+           lapped.record(pc, OPS::NOP, TraceRecord::NO_REGISTER, 0,
+                         TraceRecord::NO_ADDRESS);
+         }
+         size_t first = lapped.drain(drained);
+         lapped.record(10, OPS::NOP, TraceRecord::NO_REGISTER, 0,
+                       TraceRecord::NO_ADDRESS);
+         size_t second = lapped.drain(drained);
+         size_t empty = lapped.drain(drained);
+         if (first != 3 || second != 1 || empty != 0 ||
+             lapped.dropped() != 7 ||
+             drained.str().size() != 4 * sizeof(TraceRecord)) {
+           test_errors.push_back(
+               (boost::format("Invalid drop accounting:\n\t"
+                              "Drained: %1%, %2% then %3%, Dropped: %4%\n") %
+                first % second % empty % lapped.dropped())
+                   .str());
+         }
+
+         vm.reset();
+         return test_errors;
+       }},
+      {"test_wide_interpreter",
+       [](VirtualMachine &) -> std::vector<TestError> {
+         using OPS = VM::OpCodes;
+         std::vector<TestError> test_errors;
+
+         // NOTE: Every lane loops a different number of times, so the lanes
+         // diverge on the first exit and reconverge at the halt.
+         // clang-format off
+         Interpreter::BytecodeBuffer bb{
+                OPS::LOAD_IMMEDIATE, LITTLE_U32(0x00, 0x00, 0x00, 0x00), 0x02,
+                OPS::COMPARE, 0x02, 0x00,                              // 6
+                OPS::JUMP_EQUAL, LITTLE_U32(0x00, 0x00, 0x00, 30),    // 9
+                OPS::ADD_INT_IMMEDIATE, 0x02, LITTLE_U32(0x00, 0x00, 0x00, 0x01), 0x02,
+                OPS::ADD_INT, 0x01, 0x02, 0x01,                        // 21
+                OPS::JUMP, LITTLE_U32(0x00, 0x00, 0x00, 0x06),        // 25
+                OPS::HALT                                              // 30
+         };
+         // clang-format on
+
+         auto wide = std::make_unique<WideInterpreter<8>>();
+         wide->load_program(bb);
+         for (uint32_t lane = 0; lane < 8; lane++) {
+           wide->gp_regs_32[0][lane] = lane * 3;
+         }
+         wide->run();
+
+         for (uint32_t lane = 0; lane < 8; lane++) {
+           uint32_t n = lane * 3;
+           if (wide->gp_regs_32[1][lane] != n * (n + 1) / 2) {
+             test_errors.push_back(
+                 (boost::format("Invalid sum in lane %1%:\n\t"
+                                "Expected: %2%\n\t"
+                                "Found: %3%\n") %
+                  lane % (n * (n + 1) / 2) % wide->gp_regs_32[1][lane])
+                     .str());
+           }
+         }
+
+         auto expect_trap = [&](const char *what, Trap trap, Trap expected,
+                                MemPtr address) {
+           if (trap != expected || wide->last_trap().trap != expected ||
+               wide->last_trap().address != address) {
+             test_errors.push_back(
+                 (boost::format("%1% was not trapped:\n\t"
+                                "Trap: %2% (expected %3%), Address: %4%\n") %
+                  what % trap_name(trap) % trap_name(expected) %
+                  wide->last_trap().address)
+                     .str());
+           }
+         };
+
+         // NOTE: Lane 0 divides by zero, but only while it is active. It
+         // jumps over the division and waits at the second halt.
+         // clang-format off
+         bb = {
+                OPS::COMPARE, 0x00, 0x03,
+                OPS::JUMP_EQUAL, LITTLE_U32(0x00, 0x00, 0x00, 13),     // 3
+                OPS::DIV_INT, 0x04, 0x00, 0x05,                        // 8
+                OPS::HALT,                                             // 12
+                OPS::HALT                                              // 13
+         };
+         // clang-format on
+
+         for (Trap expected : {Trap::NONE, Trap::DIVIDE_BY_ZERO}) {
+           wide->reset();
+           wide->load_program(bb);
+           for (uint32_t lane = 0; lane < 8; lane++) {
+             wide->gp_regs_32[0][lane] = lane;
+             wide->gp_regs_32[4][lane] = 840;
+           }
+           if (expected == Trap::DIVIDE_BY_ZERO) {
+             wide->gp_regs_32[3].fill(0xffffffff);
+           }
+           Trap trap = wide->run();
+           expect_trap("Division by zero", trap, expected,
+                       expected == Trap::NONE ? 0 : 8);
+
+           for (uint32_t lane = 1; trap == Trap::NONE && lane < 8; lane++) {
+             if (wide->gp_regs_32[5][lane] != 840 / lane) {
+               test_errors.push_back(
+                   (boost::format("Invalid quotient in lane %1%: %2%\n") %
+                    lane % wide->gp_regs_32[5][lane])
+                       .str());
+             }
+           }
+         }
+
+         // clang-format off
+         bb = {
+                OPS::JUMP, LITTLE_U32(0x00, 0x01, 0x00, 0x00),
+                OPS::HALT
+         };
+         // clang-format on
+
+         wide->reset();
+         wide->load_program(bb);
+         expect_trap("Jump past the end of memory", wide->run(),
+                     Trap::INVALID_ADDRESS, 0x10000);
+
+         return test_errors;
+       }},
+      {"test_code_patching",
+       [](VirtualMachine &vm) -> std::vector<TestError> {
+         using OPS = VM::OpCodes;
+         vm.reset();
+
+         std::vector<TestError> test_errors;
+
+         // clang-format off
+         Interpreter::BytecodeBuffer bb{
+                OPS::CALL, LITTLE_U32(0x00, 0x00, 0x00, 0x06),
+                OPS::HALT,
+                OPS::LOAD_IMMEDIATE, LITTLE_U32(0x00, 0x00, 0x00, 0x01), 0x01, // 6
+                OPS::RETURN,
+                OPS::LOAD_IMMEDIATE, LITTLE_U32(0x00, 0x00, 0x00, 0x02), 0x01, // 13
+                OPS::RETURN
+         };
+         // clang-format on
+
+         auto &interp = vm.m_interp;
+         auto &code_map = interp.m_mb.code_map;
+         uint32_t invalidated_lines = 0;
+
+         interp.load_program(bb);
+         code_map.mark_code(0, bb.size());
+         auto listener =
+             code_map.add_listener([&](uint32_t first, uint32_t last) {
+               invalidated_lines += last - first + 1;
+             });
+
+         interp.start();
+         interp.run();
+         uint32_t before = interp.m_mb.gp_regs_32[1];
+
+         // NOTE: Stores into the stack are data-only, nothing is invalidated.
+         if (invalidated_lines != 0 || code_map.is_stale(0, bb.size())) {
+           test_errors.push_back("Data store invalidated code.\n");
+         }
+
+         interp.redirect_function(6, 13);
+         interp.m_mb.gp_regs_32[MemoryBank::PROGRAM_COUNTER_REG] = 0;
+         interp.start();
+         interp.run();
+         uint32_t after = interp.m_mb.gp_regs_32[1];
+
+         if (before != 1 || after != 2 || invalidated_lines != 1 ||
+             !code_map.is_stale(6, 11)) {
+           test_errors.push_back(
+               (boost::format("Invalid patching result:\n\t"
+                              "Before: %1%, After: %2%, Invalidated: %3%\n") %
+                before % after % invalidated_lines)
+                   .str());
+         }
+
+         code_map.remove_listener(listener);
+         vm.reset();
+         return test_errors;
+       }},
+      {"test_perf_counters",
+       [](VirtualMachine &vm) -> std::vector<TestError> {
+         using OPS = VM::OpCodes;
+         vm.reset();
+
+         std::vector<TestError> test_errors;
+
+         // clang-format off
+         Interpreter::BytecodeBuffer bb{
+                OPS::NOP,
+                OPS::PERF_MARK, PerfCounters::BEGIN_REGION,
+                OPS::NOP,
+                OPS::NOP,
+                OPS::NOP,
+                OPS::PERF_MARK, PerfCounters::END_REGION,
+                OPS::NOP,
+                OPS::HALT
+         };
+         // clang-format on
+
+         PerfCounters perf;
+         auto &interp = vm.m_interp;
+         interp.m_perf = &perf;
+
+         interp.load_program(bb);
+         interp.start();
+         interp.run();
+
+         // NOTE: The closing mark is dispatched inside the region.
+         if (perf.dispatches() != 4 || perf.is_counting() ||
+             perf.tsc_ticks() == 0) {
+           test_errors.push_back(
+               (boost::format("Invalid marked region:\n\t"
+                              "Dispatches: %1%, Ticks: %2%\n") %
+                perf.dispatches() % perf.tsc_ticks())
+                   .str());
+         }
+
+         perf.reset();
+         interp.m_mb.gp_regs_32[MemoryBank::PROGRAM_COUNTER_REG] = 8;
+         interp.start();
+         interp.run();
+
+         if (perf.dispatches() != 2) {
+           test_errors.push_back(
+               (boost::format("Invalid whole run dispatches: %1%\n") %
+                perf.dispatches())
+                   .str());
+         }
+
+         std::ostringstream json;
+         perf.write_json(json);
+         if (json.str().find("\"guest_instructions\": 2") ==
+             std::string::npos) {
+           test_errors.push_back("Invalid JSON report: " + json.str());
+         }
+
+         interp.m_perf = nullptr;
+         vm.reset();
+         return test_errors;
+       }},
+      {"test_console_device",
+       [](VirtualMachine &vm) -> std::vector<TestError> {
+         using OPS = VM::OpCodes;
+         vm.reset();
+
+         std::vector<TestError> test_errors;
+
+         // NOTE: RING_BASE is 0xf800 and the doorbell 0xf000.
+         // clang-format off
+         Interpreter::BytecodeBuffer bb{
+                OPS::LOAD_IMMEDIATE, LITTLE_U32(0x00, 0x00, 0x00, 'h'), 0x01,
+                OPS::STORE_BYTE, 0x01, LITTLE_U32(0x00, 0x00, 0xf8, 0x00),
+                OPS::LOAD_IMMEDIATE, LITTLE_U32(0x00, 0x00, 0x00, 'i'), 0x01,
+                OPS::STORE_BYTE, 0x01, LITTLE_U32(0x00, 0x00, 0xf8, 0x01),
+                OPS::LOAD_IMMEDIATE, LITTLE_U32(0x00, 0x00, 0x00, '\n'), 0x01,
+                OPS::STORE_BYTE, 0x01, LITTLE_U32(0x00, 0x00, 0xf8, 0x02),
+                OPS::LOAD_IMMEDIATE, LITTLE_U32(0x00, 0x00, 0x00, 0x03), 0x02,
+                OPS::STORE, 0x02, LITTLE_U32(0x00, 0x00, 0xf0, 0x00),
+                OPS::HALT
+         };
+         // clang-format on
+
+         int fds[2];
+         if (pipe(fds) != 0) {
+           test_errors.push_back("Failed to create a pipe.\n");
+           return test_errors;
+         }
+
+         auto &interp = vm.m_interp;
+         std::string output(8, '\0');
+         uint32_t tail;
+         {
+           ConsoleDevice console(interp, fds[1]);
+           interp.load_program(bb);
+           interp.start();
+           interp.run();
+           console.flush();
+
+           output.resize(read(fds[0], output.data(), output.size()));
+           std::memcpy(&tail, &interp.m_mb.memory[ConsoleDevice::TAIL],
+                       sizeof(tail));
+         }
+         close(fds[0]);
+         close(fds[1]);
+
+         if (output != "hi\n" || tail != 3) {
+           test_errors.push_back(
+               (boost::format("Invalid console output: '%1%' (tail: %2%)\n") %
+                output % tail)
+                   .str());
+         }
+
+         vm.reset();
+         return test_errors;
+       }},
+      {"test_traps",
+       [](VirtualMachine &vm) -> std::vector<TestError> {
+         using OPS = VM::OpCodes;
+         using RunStatus = Interpreter::RunStatus;
+         vm.reset();
+
+         std::vector<TestError> test_errors;
+
+         // clang-format off
+         Interpreter::BytecodeBuffer bb{
+                OPS::TRAP_VECTOR, static_cast<uint8_t>(Trap::INVALID_ADDRESS),
+                LITTLE_U32(0x00, 0x00, 0x00, 0x0d),
+                OPS::LOAD, LITTLE_U32(0x00, 0x00, 0xff, 0xfe), 0x01, // 6
+                OPS::HALT,
+                OPS::TRAP_ADDRESS, 0x02, // 13
+                OPS::LOAD_IMMEDIATE, LITTLE_U32(0x00, 0x00, 0x00, 0x07), 0x03,
+                OPS::HALT,
+                OPS::LOAD_IMMEDIATE, LITTLE_U32(0x00, 0x00, 0x00, 0x07), 0x20 // 22
+         };
+         // clang-format on
+
+         auto &interp = vm.m_interp;
+         auto &regs = interp.m_mb.gp_regs_32;
+
+         interp.load_program(bb);
+         interp.start();
+         RunStatus handled = interp.run();
+
+         if (handled != RunStatus::HALTED || regs[2] != 0xfffe ||
+             regs[3] != 7 || interp.m_mb.pop_stack_word() != 6) {
+           test_errors.push_back(
+               (boost::format("Trap was not handled:\n\t"
+                              "R2: %1%, R3: %2%\n") %
+                regs[2] % regs[3])
+                   .str());
+         }
+
+         // NOTE: The vector was used up, the same fault stops the machine.
+         regs[MemoryBank::PROGRAM_COUNTER_REG] = 6;
+         interp.start();
+         RunStatus trapped = interp.run();
+         auto state = interp.last_trap();
+
+         if (trapped != RunStatus::TRAPPED ||
+             state.trap != Trap::INVALID_ADDRESS || state.pc != 6 ||
+             state.address != 0xfffe || regs[MemoryBank::PROGRAM_COUNTER_REG] != 6) {
+           test_errors.push_back(
+               (boost::format("Invalid trap state:\n\t"
+                              "Trap: %1%, PC: %2%, Address: %3%\n") %
+                trap_name(state.trap) % state.pc % state.address)
+                   .str());
+         }
+
+         regs[MemoryBank::PROGRAM_COUNTER_REG] = 22;
+         interp.start();
+         trapped = interp.run();
+         state = interp.last_trap();
+
+         if (trapped != RunStatus::TRAPPED ||
+             state.trap != Trap::INVALID_REGISTER || state.pc != 22) {
+           test_errors.push_back(
+               (boost::format("Invalid register was not trapped: %1%\n") %
+                trap_name(state.trap))
+                   .str());
+         }
+
+         vm.reset();
+         return test_errors;
+       }},
+      {"test_optimizing_tier",
+       [](VirtualMachine &vm) -> std::vector<TestError> {
+         using OPS = VM::OpCodes;
+         vm.reset();
+
+         std::vector<TestError> test_errors;
+
+         // NOTE: The kind of code the expression compiler emits, copies, an
+         // invariant multiplication and a compare nothing reads.
+         // clang-format off
+         Interpreter::BytecodeBuffer bb{
+                OPS::LOAD_IMMEDIATE, LITTLE_U32(0x00, 0x00, 0x00, 0x00), 0x01,
+                OPS::LOAD_IMMEDIATE, LITTLE_U32(0x00, 0x00, 0x00, 0x64), 0x02,
+                OPS::LOAD_IMMEDIATE, LITTLE_U32(0x00, 0x00, 0x00, 0x03), 0x06,
+                OPS::ADD_INT_IMMEDIATE, 0x01, LITTLE_U32(0x00, 0x00, 0x00, 0x01), 0x01, // 18
+                OPS::OR_IMMEDIATE, 0x01, LITTLE_U32(0x00, 0x00, 0x00, 0x00), 0x03,
+                OPS::MULT_INT_IMMEDIATE, 0x06, LITTLE_U32(0x00, 0x00, 0x00, 0x04), 0x04,
+                OPS::ADD_INT, 0x03, 0x04, 0x05,
+                OPS::COMPARE, 0x05, 0x02,
+                OPS::COMPARE, 0x02, 0x01,
+                OPS::STORE, 0x05, LITTLE_U32(0x00, 0x00, 0x80, 0x00),
+                OPS::JUMP_GREATER_THAN, LITTLE_U32(0x00, 0x00, 0x00, 0x12),
+                OPS::HALT
+         };
+         // clang-format on
+
+         auto &interp = vm.m_interp;
+         auto &mb = interp.m_mb;
+
+         auto run = [&]() {
+           interp.load_program(bb);
+           interp.start();
+           interp.run();
+           auto registers = mb.gp_regs_32;
+           uint32_t stored;
+           std::memcpy(&stored, &mb.memory[0x8000], sizeof(stored));
+           return std::make_pair(registers, stored);
+         };
+
+         auto [expected, expected_stored] = run();
+         vm.reset();
+
+         OptimizingTier tier(interp);
+         interp.m_tier = &tier;
+         auto [registers, stored] = run();
+
+         if (registers != expected || stored != expected_stored ||
+             registers[1] != 100 || registers[3] != 100 ||
+             registers[4] != 12 || registers[5] != 112) {
+           test_errors.push_back(
+               (boost::format("Optimized run differs:\n\t"
+                              "R1: %1%, R3: %2%, R4: %3%, R5: %4%, "
+                              "PC: %5%, FLAGS: %6% (expected %7%, %8%)\n") %
+                registers[1] % registers[3] % registers[4] % registers[5] %
+                registers[MemoryBank::PROGRAM_COUNTER_REG] %
+                registers[MemoryBank::FLAGS_REG] %
+                expected[MemoryBank::PROGRAM_COUNTER_REG] %
+                expected[MemoryBank::FLAGS_REG])
+                   .str());
+         }
+
+         auto &stats = tier.stats();
+         if (stats.blocks_compiled == 0 || stats.block_runs == 0 ||
+             stats.body_micro_ops >= stats.guest_instructions) {
+           test_errors.push_back(
+               (boost::format("Loop was not optimized:\n\t"
+                              "Blocks: %1%, Guest instructions: %2%, "
+                              "Micro-ops: %3%\n") %
+                stats.blocks_compiled % stats.guest_instructions %
+                stats.body_micro_ops)
+                   .str());
+         }
+
+         // NOTE: Counting with the performance counters keeps the tier on,
+         // the instructions of the blocks are counted as compiled.
+         PerfCounters perf;
+         interp.m_perf = &perf;
+         uint64_t block_runs = stats.block_runs;
+         vm.reset();
+         auto [counted_registers, counted_stored] = run();
+         interp.m_perf = nullptr;
+
+         if (counted_registers != expected ||
+             counted_stored != expected_stored ||
+             stats.block_runs == block_runs ||
+             perf.guest_instructions() != 804 ||
+             perf.guest_instructions() == perf.dispatches()) {
+           test_errors.push_back(
+               (boost::format("Tier did not run under the counters:\n\t"
+                              "Block runs: %1%, Guest instructions: %2%, "
+                              "Dispatches: %3%\n") %
+                (stats.block_runs - block_runs) % perf.guest_instructions() %
+                perf.dispatches())
+                   .str());
+         }
+
+         // NOTE: Reloading the program clears the code map, the blocks
+         // decoded from the old one have to go.
+         interp.load_program(bb);
+         if (stats.blocks_invalidated == 0) {
+           test_errors.push_back("Reloading did not drop the blocks\n");
+         }
+
+         interp.m_tier = nullptr;
+         vm.reset();
+         return test_errors;
+       }},
+      {"test_numeric_conversion",
+       [](VirtualMachine &vm) -> std::vector<TestError> {
+         std::vector<TestError> test_errors;
+
+         std::vector<std::string_view> literals{
+             "0",          "12345678",  "-87654321", "123456789012",
+             "0x7fFF",     "-0b101",    "4294967295", "9223372036854775807",
+             "-9223372036854775808", "12a"};
+         std::vector<int64_t> expected{0,
+                                       12345678,
+                                       -87654321,
+                                       123456789012,
+                                       0x7fff,
+                                       -5,
+                                       4294967295,
+                                       INT64_MAX,
+                                       INT64_MIN};
+         std::vector<int64_t> values(literals.size());
+
+         size_t count = numeric::parse_integers(literals, values);
+         values.resize(count);
+         if (values != expected) {
+           test_errors.push_back(
+               (boost::format("Bulk integer conversion stopped at %1%\n") %
+                count)
+                   .str());
+         }
+
+         uint64_t unused;
+         std::string_view overflow = "18446744073709551616";
+         if (numeric::parse_decimal(overflow.data(),
+                                    overflow.data() + overflow.size(), unused)
+                 .status != numeric::Status::OUT_OF_RANGE) {
+           test_errors.push_back("Overflow was not detected\n");
+         }
+
+         std::vector<std::string_view> floats{"2.5", "-0.1", "1e-3", "7"};
+         std::vector<double> doubles(floats.size());
+         if (numeric::parse_doubles(floats, doubles) != floats.size() ||
+             doubles != std::vector<double>{2.5, -0.1, 1e-3, 7}) {
+           test_errors.push_back(
+               (boost::format("Invalid floats: %1% %2% %3% %4%\n") %
+                doubles[0] % doubles[1] % doubles[2] % doubles[3])
+                   .str());
+         }
+
+         return test_errors;
+       }},
+      {"test_vm_metrics",
+       [](VirtualMachine &vm) -> std::vector<TestError> {
+         using OPS = VM::OpCodes;
+         vm.reset();
+
+         std::vector<TestError> test_errors;
+
+         // clang-format off
+         Interpreter::BytecodeBuffer bb{
+                OPS::LOAD_IMMEDIATE, LITTLE_U32(0x00, 0x00, 0x00, 0x00), 0x01,
+                OPS::LOAD_IMMEDIATE, LITTLE_U32(0x00, 0x00, 0x27, 0x10), 0x02,
+                OPS::ADD_INT_IMMEDIATE, 0x01, LITTLE_U32(0x00, 0x00, 0x00, 0x01), 0x01, // 12
+                OPS::COMPARE, 0x02, 0x01,
+                OPS::JUMP_GREATER_THAN, LITTLE_U32(0x00, 0x00, 0x00, 0x0c),
+                OPS::HALT
+         };
+         // clang-format on
+
+         // NOTE: The segment is unlinked when the machine goes away.
+         std::string name = (boost::format("/interp_test_metrics_%1%") %
+                             getpid())
+                                .str();
+         auto machine = std::make_unique<VirtualMachine>();
+         machine->export_metrics(name);
+         MetricsReader reader(name);
+         auto &layout = reader.layout();
+
+         auto &interp = machine->m_interp;
+         interp.load_program(bb);
+         interp.start();
+         interp.run_for(5000);
+         uint64_t preempted_blocks = MetricsReader::load(layout.blocks);
+         uint64_t preempted_state = MetricsReader::load(layout.state);
+         interp.run();
+
+         // 2 loads, 10000 iterations of 3 instructions and the halt.
+         uint64_t instructions = MetricsReader::load(layout.instructions);
+         if (instructions != 30003 || preempted_blocks != 5000 ||
+             preempted_state != MetricsLayout::PREEMPTED ||
+             MetricsReader::load(layout.blocks) != 9999 ||
+             MetricsReader::load(layout.slices) != 2 ||
+             MetricsReader::load(layout.state) != MetricsLayout::HALTED ||
+             MetricsReader::load(layout.publications) < 7) {
+           test_errors.push_back(
+               (boost::format("Invalid metrics:\n\t"
+                              "Instructions: %1%, Blocks: %2%, State: %3%, "
+                              "Publications: %4%\n") %
+                instructions % MetricsReader::load(layout.blocks) %
+                MetricsReader::load(layout.state) %
+                MetricsReader::load(layout.publications))
+                   .str());
+         }
+
+         // NOTE: The return address, the saved frame pointer and a 16 byte
+         // frame, the stack is taken when it grows, not at the calls.
+         // clang-format off
+         bb = {
+                OPS::CALL, LITTLE_U32(0x00, 0x00, 0x00, 0x06),
+                OPS::HALT,                                            // 0x05
+                OPS::ENTER, 0x10, 0x00,                               // 0x06
+                OPS::LEAVE,
+                OPS::RETURN
+         };
+         // clang-format on
+
+         machine->reset();
+         interp.load_program(bb);
+         interp.start();
+         interp.run();
+
+         if (MetricsReader::load(layout.stack_high_water) != 24) {
+           test_errors.push_back(
+               (boost::format("Invalid stack high water: %1%\n") %
+                MetricsReader::load(layout.stack_high_water))
+                   .str());
+         }
+
+         return test_errors;
+       }},
+      {"test_disassembler",
+       [](VirtualMachine &vm) -> std::vector<TestError> {
+         using OPS = VM::OpCodes;
+
+         std::vector<TestError> test_errors;
+
+         // clang-format off
+         Interpreter::BytecodeBuffer bb{
+                OPS::LOAD_IMMEDIATE, LITTLE_U32(0x00, 0x00, 0x00, 0x64), 0x02,
+                OPS::ADD_INT_IMMEDIATE, 0x01, LITTLE_U32(0x00, 0x00, 0x00, 0x01), 0x01,
+                OPS::JUMP_GREATER_THAN, LITTLE_U32(0x00, 0x00, 0x00, 0x06),
+                OPS::HALT,
+                0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                0xff,
+                OPS::LOAD
+         };
+         // clang-format on
+
+         std::vector<uint64_t> hits(7);
+         hits[6] = 12;
+
+         std::string listing;
+         size_t flushes = 0;
+         {
+           Disassembler disassembler(
+               [&](std::string_view text) {
+                 listing += text;
+                 flushes++;
+               },
+               0);
+           disassembler.set_hit_counts(hits);
+           disassembler.disassemble(bb, 0);
+         }
+
+         std::string expected = "            00000000  ldi $100, r2\n"
+                                "        12  00000006  addi r1, $1, r1\n"
+                                "            0000000d  jgt 0x6\n"
+                                "            00000012  halt\n"
+                                "            00000013  ; 16 zero bytes\n"
+                                "            00000023  .byte $255\n"
+                                "            00000024  .byte $6\n";
+
+         if (listing != expected || flushes < 2) {
+           test_errors.push_back(
+               (boost::format("Invalid listing (%1% flushes):\n%2%") %
+                flushes % listing)
+                   .str());
+         }
+
+         return test_errors;
+       }},
+      {"test_native_code",
+       [](VirtualMachine &vm) -> std::vector<TestError> {
+         using OPS = VM::OpCodes;
+         using RunStatus = Interpreter::RunStatus;
+         vm.reset();
+
+         std::vector<TestError> test_errors;
+
+         // clang-format off
+         Interpreter::BytecodeBuffer bb{
+                OPS::LOAD_IMMEDIATE, LITTLE_U32(0x00, 0x00, 0x00, 0x00), 0x01,
+                OPS::LOAD_IMMEDIATE, LITTLE_U32(0x00, 0x00, 0x00, 0x64), 0x02,
+                OPS::CALL, LITTLE_U32(0x00, 0x00, 0x00, 0x1a),         // 0x0c
+                OPS::COMPARE, 0x02, 0x01,
+                OPS::JUMP_GREATER_THAN, LITTLE_U32(0x00, 0x00, 0x00, 0x0c),
+                OPS::HALT,
+                OPS::ADD_INT_IMMEDIATE, 0x01, LITTLE_U32(0x00, 0x00, 0x00, 0x01), 0x01, // 0x1a
+                OPS::STORE, 0x01, LITTLE_U32(0x00, 0x00, 0x80, 0x00),
+                OPS::RETURN
+         };
+         // clang-format on
+
+         auto &interp = vm.m_interp;
+         auto &mb = interp.m_mb;
+
+         auto run = [&](const std::string &native) {
+           interp.load_program(bb);
+           if (!native.empty()) {
+             interp.load_native(native);
+           }
+           interp.start();
+           auto status = interp.run();
+           uint32_t stored;
+           std::memcpy(&stored, &mb.memory[0x8000], sizeof(stored));
+           return std::make_tuple(status, mb.gp_regs_32, stored);
+         };
+
+         auto [expected_status, expected, expected_stored] = run("");
+         vm.reset();
+
+         // NOTE: Translated by the aot tool built along with the tests.
+         char image_name[] = "/tmp/interp_native_test_XXXXXX";
+         int image = mkstemp(image_name);
+         if (image < 0) {
+           test_errors.push_back(
+               (boost::format("Failed to create the image (errno: %1%)\n") %
+                errno)
+                   .str());
+           return test_errors;
+         }
+         bool written = write(image, bb.data(), bb.size()) == ssize_t(bb.size());
+         close(image);
+
+         std::string native_name = std::string(image_name) + ".so";
+         std::string command = (boost::format("%1% %2% %3% > /dev/null") %
+                                INTERP_AOT_TOOL % image_name % native_name)
+                                   .str();
+
+         if (!written || std::system(command.c_str()) != 0) {
+           test_errors.push_back("Failed to translate the program: " +
+                                 command + "\n");
+         } else {
+           // NOTE: Every instruction is translated, nothing is dispatched
+           // and the native code counts all 603 the interpreter would run.
+           PerfCounters perf;
+           interp.m_perf = &perf;
+           auto [status, registers, stored] = run(native_name);
+           interp.m_perf = nullptr;
+
+           if (status != expected_status || registers != expected ||
+               stored != expected_stored || expected_status != RunStatus::HALTED ||
+               registers[1] != 100 || perf.dispatches() != 0 ||
+               perf.guest_instructions() != 603) {
+             test_errors.push_back(
+                 (boost::format("Native run differs:\n\t"
+                                "R1: %1%, PC: %2%, SP: %3%, Stored: %4%, "
+                                "Dispatches: %5%, Guest instructions: %10% "
+                                "(expected %6%, %7%, %8%, %9%)\n") %
+                  registers[1] % registers[MemoryBank::PROGRAM_COUNTER_REG] %
+                  registers[MemoryBank::STACK_PTR_REG] % stored %
+                  perf.dispatches() % expected[1] %
+                  expected[MemoryBank::PROGRAM_COUNTER_REG] %
+                  expected[MemoryBank::STACK_PTR_REG] % expected_stored %
+                  perf.guest_instructions())
+                     .str());
+           }
+         }
+
+         // NOTE: The tool removes the translated source once it's compiled.
+         std::string source_name = native_name + ".cxx";
+         if (access(source_name.c_str(), F_OK) == 0) {
+           test_errors.push_back("The translated source was left behind.\n");
+           unlink(source_name.c_str());
+         }
+
+         unlink(image_name);
+         unlink(native_name.c_str());
+         vm.reset();
+         return test_errors;
+       }},
+      {"test_assembler",
+       [](VirtualMachine &vm) -> std::vector<TestError> {
+         using OPS = VM::OpCodes;
+         using assembler::Relocation;
+         using assembler::Symbol;
+
+         std::vector<TestError> test_errors;
+
+         assembler::Assembler as;
+         as << ".global main\n"
+               "main:\n"
+               "  ldi $5, r1        ; 0x00\n"
+               "  call helper       ; 0x06\n"
+               "loop:\n"
+               "  jgt loop          ; 0x0b\n"
+               "  halt\n"
+               "  .word loop, $-1   ; 0x11\n"
+               "  .byte $255\n";
+         auto object = as.object();
+
+         // clang-format off
+         std::vector<uint8_t> expected_code{
+                OPS::LOAD_IMMEDIATE, 5, 0, 0, 0, 0x01,
+                OPS::CALL, 0, 0, 0, 0,
+                OPS::JUMP_GREATER_THAN, 0, 0, 0, 0,
+                OPS::HALT,
+                0, 0, 0, 0, 0xff, 0xff, 0xff, 0xff,
+                0xff
+         };
+         // clang-format on
+
+         auto relocation_is = [&](size_t i, uint32_t offset,
+                                  const char *symbol) {
+           if (i >= object.relocations.size()) {
+             return false;
+           }
+           auto &relocation = object.relocations[i];
+           return relocation.offset == offset &&
+                  relocation.type == Relocation::ABS32 &&
+                  relocation.symbol < object.symbols.size() &&
+                  object.symbols[relocation.symbol].name == symbol;
+         };
+         auto symbol_is = [&](size_t i, const char *name, uint32_t value,
+                              Symbol::Binding binding) {
+           return i < object.symbols.size() &&
+                  object.symbols[i].name == name &&
+                  object.symbols[i].binding == binding &&
+                  (binding == Symbol::UNDEFINED ||
+                   object.symbols[i].value == value);
+         };
+
+         if (!as.get_errors().empty() || object.code != expected_code ||
+             object.relocations.size() != 3 || !relocation_is(0, 7, "helper") ||
+             !relocation_is(1, 12, "loop") || !relocation_is(2, 17, "loop") ||
+             object.symbols.size() != 3 ||
+             !symbol_is(0, "main", 0, Symbol::GLOBAL) ||
+             !symbol_is(1, "helper", 0, Symbol::UNDEFINED) ||
+             !symbol_is(2, "loop", 0x0b, Symbol::LOCAL)) {
+           test_errors.push_back(
+               (boost::format("Invalid object:\n\t"
+                              "Errors: %1%, Code size: %2%, Symbols: %3%, "
+                              "Relocations: %4%\n") %
+                as.get_errors().size() % object.code.size() %
+                object.symbols.size() % object.relocations.size())
+                   .str());
+         }
+
+         assembler::Assembler broken;
+         broken << "  addi r1, $1\n"
+                   "  ldi $4294967296, r1\n"
+                   "  frob r1\n"
+                   "x:\n"
+                   "x:\n";
+         if (broken.get_errors().size() != 4) {
+           test_errors.push_back(
+               (boost::format("Expected 4 errors, found %1%\n") %
+                broken.get_errors().size())
+                   .str());
+         }
+
+         // NOTE: Written and read back, then with the last byte missing and
+         // with a code size no file could hold.
+         std::ostringstream written;
+         object.write(written);
+         std::string bytes = written.str();
+
+         std::istringstream in(bytes);
+         auto read = assembler::ObjectFile::read(in);
+         bool same = read.code == object.code &&
+                     read.symbols.size() == object.symbols.size() &&
+                     read.relocations.size() == object.relocations.size();
+         for (size_t i = 0; same && i < read.symbols.size(); i++) {
+           same = read.symbols[i].name == object.symbols[i].name &&
+                  read.symbols[i].value == object.symbols[i].value &&
+                  read.symbols[i].binding == object.symbols[i].binding;
+         }
+         for (size_t i = 0; same && i < read.relocations.size(); i++) {
+           same = read.relocations[i].offset == object.relocations[i].offset &&
+                  read.relocations[i].symbol == object.relocations[i].symbol &&
+                  read.relocations[i].addend == object.relocations[i].addend;
+         }
+         if (!same) {
+           test_errors.push_back("Object file did not read back the same\n");
+         }
+
+         std::string huge_code = bytes;
+         std::memset(&huge_code[8], 0xff, sizeof(uint32_t));
+         std::string long_name = bytes;
+         long_name[8 + 3 * sizeof(uint32_t) + object.code.size() + 5] = '\xff';
+
+         for (auto corrupt :
+              {bytes.substr(0, bytes.size() - 1), huge_code, long_name}) {
+           std::istringstream corrupt_in(corrupt);
+           try {
+             assembler::ObjectFile::read(corrupt_in);
+             test_errors.push_back("Corrupt object file was read\n");
+           } catch (std::runtime_error &) {
+           }
+         }
+
+         // NOTE: Linked from files, helper lands after the first module and
+         // its halt. The second build reads the object files.
+         char dir_name[] = "/tmp/interp_linker_test_XXXXXX";
+         if (!mkdtemp(dir_name)) {
+           test_errors.push_back("Failed to create the module directory\n");
+           return test_errors;
+         }
+         std::string dir = dir_name;
+         auto module = [&](const char *name, const char *source) {
+           std::ofstream(dir + "/" + name) << source;
+           return dir + "/" + name;
+         };
+         auto main_module = module("main.s", ".global main\n"
+                                             "main:\n"
+                                             "  call helper\n"
+                                             "  halt\n");
+         auto helper_module = module("helper.s", ".global helper\n"
+                                                 "  halt\n"
+                                                 "helper:\n"
+                                                 "  ret\n");
+         auto other_module = module("other.s", ".global helper\n"
+                                               "helper:\n"
+                                               "  ret\n");
+         auto missing_module = module("missing.s", "  call missing\n");
+
+         auto link = [&](std::vector<std::string> modules,
+                         std::vector<uint8_t> &image, size_t &assembled) {
+           assembler::Linker linker(2);
+           for (auto &path : modules) {
+             linker.add_module(path);
+           }
+           bool linked = linker.build_objects() && linker.link(image);
+           assembled = linker.assembled_count();
+           std::string errors;
+           for (auto &error : linker.get_errors()) {
+             errors += error + "\n";
+           }
+           return std::make_pair(linked, errors);
+         };
+
+         std::vector<uint8_t> image;
+         size_t assembled = 0;
+         for (size_t expected_assembled : {2, 0}) {
+           auto [linked, errors] =
+               link({main_module, helper_module}, image, assembled);
+           std::vector<uint8_t> expected_image{OPS::CALL, 7, 0, 0, 0,
+                                               OPS::HALT, OPS::HALT,
+                                               OPS::RETURN};
+           if (!linked || image != expected_image ||
+               assembled != expected_assembled) {
+             test_errors.push_back(
+                 (boost::format("Invalid image (%1% assembled):\n%2%") %
+                  assembled % errors)
+                     .str());
+           }
+         }
+
+         auto [duplicate_linked, duplicate] =
+             link({main_module, helper_module, other_module}, image,
+                  assembled);
+         if (duplicate_linked ||
+             duplicate.find("Symbol 'helper' defined in both") ==
+                 std::string::npos) {
+           test_errors.push_back("Duplicate symbol was linked: " + duplicate);
+         }
+
+         auto [undefined_linked, undefined] =
+             link({missing_module}, image, assembled);
+         if (undefined_linked ||
+             undefined.find("Undefined symbol 'missing'") ==
+                 std::string::npos) {
+           test_errors.push_back("Undefined symbol was linked: " + undefined);
+         }
+
+         std::filesystem::remove_all(dir);
+         return test_errors;
+       }},
+      {"test_symbol_table",
+       [](VirtualMachine &vm) -> std::vector<TestError> {
+         std::vector<TestError> test_errors;
+
+         // NOTE: Enough names to grow the slots past their initial 64 and to
+         // fill several chunks, one of them longer than a chunk.
+         SymbolTable symbols;
+         std::vector<std::string> names;
+         for (int i = 0; i < 1000; i++) {
+           names.push_back((boost::format("name_%1%") % i).str());
+         }
+         names.push_back(std::string(5000, 'x'));
+
+         for (size_t i = 0; i < names.size(); i++) {
+           if (symbols.intern(names[i]) != i) {
+             test_errors.push_back(
+                 (boost::format("New name %1% got id %2%\n") % names[i] %
+                  symbols.find(names[i]))
+                     .str());
+             break;
+           }
+         }
+
+         for (size_t i = 0; i < names.size(); i++) {
+           // NOTE: A copy, the lookup must compare the text.
+           std::string name = names[i];
+           if (symbols.intern(name) != i || symbols.find(name) != i ||
+               symbols.name(i) != names[i]) {
+             test_errors.push_back(
+                 (boost::format("Name %1% did not keep id %2%\n") % names[i] %
+                  i)
+                     .str());
+             break;
+           }
+         }
+
+         if (symbols.size() != names.size() ||
+             symbols.find("name_1000") != SymbolTable::NO_SYMBOL ||
+             symbols.find("") != SymbolTable::NO_SYMBOL) {
+           test_errors.push_back(
+               (boost::format("Invalid table size %1% or unknown name "
+                              "found\n") %
+                symbols.size())
+                   .str());
+         }
+
+         // NOTE: Both uses of alpha are the same symbol.
+         std::string_view expression = "alpha + 2.5 * beta_1 - alpha";
+         std::vector<ExpressionToken> tokens;
+         auto error = tokenize(expression.begin(), expression.end(), tokens,
+                               symbols);
+
+         using Type = ExpressionToken::Type;
+         std::vector<Type> expected_types{Type::IDENTIFIER, Type::OPERATOR,
+                                          Type::NUMBER,     Type::OPERATOR,
+                                          Type::IDENTIFIER, Type::OPERATOR,
+                                          Type::IDENTIFIER};
+         std::vector<Type> types;
+         for (auto &token : tokens) {
+           types.push_back(token.type);
+         }
+
+         if (error.type != TokenizeError::Type::Nothing ||
+             types != expected_types ||
+             tokens[0].value.identifier != tokens[6].value.identifier ||
+             symbols.name(tokens[0].value.identifier) != "alpha" ||
+             symbols.name(tokens[4].value.identifier) != "beta_1" ||
+             tokens[2].value.number != 2.5 ||
+             symbols.size() != names.size() + 2) {
+           test_errors.push_back(
+               (boost::format("Invalid tokens of '%1%' (%2% tokens)\n") %
+                expression % tokens.size())
+                   .str());
+         }
+
+         return test_errors;
+       }},
+      {"test_line_reader",
+       [](VirtualMachine &vm) -> std::vector<TestError> {
+         std::vector<TestError> test_errors;
+
+         // NOTE: The reads fill 256 KiB buffers, the long lines run past the
+         // end of one into the other and the longest one grows them. The
+         // last line has no newline.
+         std::vector<std::string> lines{"first",
+                                        "",
+                                        std::string(100000, 'a'),
+                                        std::string(300000, 'b'),
+                                        std::string(600000, 'c'),
+                                        "last"};
+         std::string input;
+         for (auto &line : lines) {
+           input += line;
+           input += '\n';
+         }
+         input.pop_back();
+
+         auto check = [&](const char *mode, generic_ling::LineReader &reader,
+                          const std::vector<std::string> &expected) {
+           std::vector<std::string> read;
+           for (auto line : reader) {
+             read.emplace_back(line);
+           }
+           if (read != expected || reader.next()) {
+             test_errors.push_back(
+                 (boost::format("Invalid %1% lines:\n\t"
+                                "Expected %2% lines, found %3%\n") %
+                  mode % expected.size() % read.size())
+                     .str());
+           }
+         };
+
+         auto write_file = [&](const std::string &content) {
+           char file_name[] = "/tmp/interp_line_reader_test_XXXXXX";
+           int file = mkstemp(file_name);
+           bool written =
+               file >= 0 && write(file, content.data(), content.size()) ==
+                                ssize_t(content.size());
+           if (file >= 0) {
+             close(file);
+           }
+           if (!written) {
+             test_errors.push_back("Failed to write the input file\n");
+           }
+           return std::string(file_name);
+         };
+
+         auto read_pipe = [&](const char *mode, const std::string &content,
+                              const std::vector<std::string> &expected) {
+           int fds[2];
+           if (pipe(fds) != 0) {
+             test_errors.push_back("Failed to create the pipe\n");
+             return;
+           }
+           std::thread writer([&]() {
+             size_t offset = 0;
+             while (offset < content.size()) {
+               ssize_t res = write(fds[1], content.data() + offset,
+                                   content.size() - offset);
+               if (res <= 0) {
+                 break;
+               }
+               offset += res;
+             }
+             close(fds[1]);
+           });
+
+           {
+             generic_ling::LineReader reader(fds[0]);
+             check(mode, reader, expected);
+           }
+           writer.join();
+           close(fds[0]);
+         };
+
+         for (auto [content, expected] :
+              {std::pair{input, lines},
+               std::pair{std::string(), std::vector<std::string>{}}}) {
+           bool empty = content.empty();
+           auto file_name = write_file(content);
+           {
+             generic_ling::LineReader reader(file_name);
+             check(empty ? "empty file" : "mapped", reader, expected);
+           }
+           unlink(file_name.c_str());
+
+           read_pipe(empty ? "empty pipe" : "pipe", content, expected);
+         }
+
+         return test_errors;
+       }},
+      {"test_parallel_tokenize",
+       [](VirtualMachine &vm) -> std::vector<TestError> {
+         std::vector<TestError> test_errors;
+
+         // NOTE: Large enough for several 64 KiB chunks, the identifiers
+         // repeat across the chunks.
+         std::string input;
+         for (int i = 0; i < 40000; i++) {
+           input += (boost::format("x%1% + %2%.5 * y%3% - x%1%\n") %
+                     (i % 700) % i % (i % 13))
+                        .str();
+         }
+
+         auto serial = [](std::string_view text, TokenizedRecords &output,
+                          SymbolTable &symbols) {
+           size_t begin = 0;
+           while (begin < text.size()) {
+             size_t end = std::min(text.find('\n', begin), text.size());
+             auto line = text.substr(begin, end - begin);
+             auto error =
+                 tokenize(line.begin(), line.end(), output.tokens, symbols);
+             if (error.type != TokenizeError::Type::Nothing) {
+               error.position += begin;
+               output.tokens.resize(output.offsets.back());
+               return error;
+             }
+             output.offsets.push_back(output.tokens.size());
+             begin = end + 1;
+           }
+           return TokenizeError{.type = TokenizeError::Type::Nothing};
+         };
+
+         auto same = [](const TokenizedRecords &a, const SymbolTable &a_symbols,
+                        const TokenizedRecords &b,
+                        const SymbolTable &b_symbols) {
+           if (a.offsets != b.offsets || a.tokens.size() != b.tokens.size() ||
+               a_symbols.size() != b_symbols.size()) {
+             return false;
+           }
+           for (size_t i = 0; i < a.tokens.size(); i++) {
+             auto &x = a.tokens[i];
+             auto &y = b.tokens[i];
+             if (x.type != y.type ||
+                 (x.type == ExpressionToken::Type::NUMBER &&
+                  x.value.number != y.value.number) ||
+                 (x.type == ExpressionToken::Type::OPERATOR &&
+                  x.value.math_operator != y.value.math_operator) ||
+                 (x.type == ExpressionToken::Type::IDENTIFIER &&
+                  x.value.identifier != y.value.identifier)) {
+               return false;
+             }
+           }
+           for (SymbolId id = 0; id < a_symbols.size(); id++) {
+             if (a_symbols.name(id) != b_symbols.name(id)) {
+               return false;
+             }
+           }
+           return true;
+         };
+
+         TokenizedRecords expected;
+         SymbolTable expected_symbols;
+         serial(input, expected, expected_symbols);
+
+         // NOTE: The workers are reused from one batch to the next.
+         ParallelTokenizer tokenizer(4);
+         for (int batch = 0; batch < 2; batch++) {
+           TokenizedRecords records;
+           SymbolTable symbols;
+           auto error = tokenizer.tokenize(input, records, symbols);
+           if (error.type != TokenizeError::Type::Nothing ||
+               records.record_count() != 40000 ||
+               !same(records, symbols, expected, expected_symbols)) {
+             test_errors.push_back(
+                 (boost::format("Batch %1% differs from serial "
+                                "tokenization:\n\t"
+                                "Records: %2%, Tokens: %3% (expected %4%)\n") %
+                  batch % records.record_count() % records.tokens.size() %
+                  expected.tokens.size())
+                     .str());
+           }
+         }
+
+         // NOTE: A malformed record in a later chunk, the records before it
+         // are kept and the error is returned, not printed.
+         size_t bad_line = 30000;
+         size_t bad_offset = 0;
+         for (size_t i = 0; i < bad_line; i++) {
+           bad_offset = input.find('\n', bad_offset) + 1;
+         }
+         input.insert(bad_offset, "a + + b\n");
+
+         TokenizedRecords serial_records;
+         SymbolTable serial_symbols;
+         auto serial_error = serial(input, serial_records, serial_symbols);
+
+         TokenizedRecords records;
+         SymbolTable symbols;
+         auto error = tokenizer.tokenize(input, records, symbols);
+
+         if (error.type != TokenizeError::Type::FailedParsing ||
+             error.message.empty() ||
+             error.position != serial_error.position ||
+             error.position != bad_offset + 4 ||
+             records.record_count() != bad_line ||
+             records.offsets != serial_records.offsets) {
+           test_errors.push_back(
+               (boost::format("Invalid error:\n\t"
+                              "Position: %1% (expected %2%), Records: %3%, "
+                              "Message: %4%\n") %
+                error.position % serial_error.position %
+                records.record_count() % error.message)
+                   .str());
+         }
+
+         return test_errors;
+       }},
       {"test_compare_instructions",
        [](VirtualMachine &vm) -> std::vector<TestError> { NOT_IMPLEMENTED; }},
       {"test_auxilary_instructions",
@@ -0,0 +1,94 @@
+#ifndef TRACE_HXX
+#define TRACE_HXX
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// NOTE: Binary execution trace. Every executed instruction appends one fixed
+// size record to a per machine ring buffer. The machine is the only producer,
+// when the buffer is full the oldest records are overwritten so the buffer
+// always holds the most recent history for post-mortems. A single consumer
+// (usually another thread) drains it to disk without stopping the machine.
+// A drain that finds the buffer full drops the oldest record left as well,
+// the machine may be overwriting it at that very moment.
+
+struct TraceRecord {
+  constexpr static uint8_t NO_REGISTER = 0xff;
+  // Set in reg when the register written is a floating-point register.
+  constexpr static uint8_t FLOAT_REGISTER_BIT = 0x80;
+  constexpr static uint32_t NO_ADDRESS = 0xffffffff;
+
+  uint32_t pc;
+  uint8_t opcode;
+  uint8_t reg;       // Register written by the instruction.
+  uint16_t reserved;
+  uint32_t reg_value; // Its value after the instruction, raw bits for floats.
+  uint32_t address;   // Memory address given to the instruction.
+};
+
+static_assert(sizeof(TraceRecord) == 16);
+
+struct TraceFileHeader {
+  constexpr static uint32_t VERSION = 1;
+
+  char magic[4] = {'M', 'R', 'T', 'T'};
+  uint32_t version = VERSION;
+  uint32_t record_size = sizeof(TraceRecord);
+  uint32_t reserved = 0;
+};
+
+class TraceBuffer {
+public:
+  // NOTE: The capacity is rounded up to a power of two.
+  explicit TraceBuffer(size_t capacity);
+
+  // NOTE: Works like the writer of a seqlock. The fence keeps the stores
+  // into the slot after the publication of the previous record, so a drain
+  // that reads any of them also sees a head telling it the slot is being
+  // rewritten.
+  void record(uint32_t pc, uint8_t opcode, uint8_t reg, uint32_t reg_value,
+              uint32_t address) {
+    uint64_t head = m_head.load(std::memory_order_relaxed);
+    TraceRecord record{pc, opcode, reg, 0, reg_value, address};
+    uint64_t words[RECORD_WORDS];
+    std::memcpy(words, &record, sizeof(record));
+
+    std::atomic_thread_fence(std::memory_order_release);
+    auto *slot = &m_records[(head & m_mask) * RECORD_WORDS];
+    for (size_t i = 0; i < RECORD_WORDS; i++) {
+      slot[i].store(words[i], std::memory_order_relaxed);
+    }
+    m_head.store(head + 1, std::memory_order_release);
+  }
+
+  // Appends the records produced since the last drain to out, returns how
+  // many were written. Records overwritten before they could be drained are
+  // lost and counted in dropped().
+  size_t drain(std::ostream &out);
+  uint64_t dropped() const { return m_dropped; }
+
+  static void write_header(std::ostream &out);
+
+private:
+  constexpr static size_t RECORD_WORDS = sizeof(TraceRecord) / sizeof(uint64_t);
+
+  // NOTE: The records are stored as atomic words so the drain can read a slot
+  // the machine is overwriting without a data race, it only throws the
+  // torn record away.
+  std::unique_ptr<std::atomic<uint64_t>[]> m_records;
+  uint64_t m_mask;
+  std::atomic<uint64_t> m_head = 0;
+  uint64_t m_tail = 0;
+  uint64_t m_dropped = 0;
+  std::vector<TraceRecord> m_scratch;
+};
+
+// NOTE: One line of the readable listing: the pc, the instruction, the
+// register it wrote and the memory address it was given.
+void print_trace_record(std::ostream &out, const TraceRecord &record);
+
+#endif // TRACE_HXX
@@ -0,0 +1,69 @@
+#ifndef WIDE_INTERPRETER_HXX
+#define WIDE_INTERPRETER_HXX
+#include "interpreter.hxx"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// NOTE: Lockstep interpreter, runs one program over LANES inputs at once. All
+// the lanes share the instruction stream and the register file is stored as
+// structure of arrays (gp_regs_32[reg][lane]) so every dispatched arithmetic
+// instruction is a single vector operation over all the lanes (AVX2 when the
+// build enables it, see the WIDE_AVX2 option).
+//
+// Every lane keeps its own program counter. Each step executes the
+// instruction at the lowest program counter among the live lanes, with only
+// the lanes sitting at that address active. Lanes that take a different
+// branch simply wait until the others catch up, which makes them reconverge
+// at the join point of structured control flow without a reconvergence
+// stack.
+//
+// Every lane has its own data memory, instructions are always fetched from
+// the program as loaded, stores into it are not visible to the instruction
+// stream. Stack, call, heap and I/O instructions are not supported, they
+// trap as invalid instructions.
+template <size_t LANES> class WideInterpreter {
+public:
+  static_assert(LANES == 8 || LANES == 16,
+                "The wide interpreter runs either 8 or 16 lanes.");
+
+  using LaneMask = uint32_t;
+  template <typename T> using Lanes = std::array<T, LANES>;
+
+  constexpr static LaneMask ALL_LANES = (LaneMask(1) << LANES) - 1;
+
+  WideInterpreter();
+
+  void reset();
+  void load_program(Interpreter::BytecodeBuffer &buffer);
+  // Runs until every lane halted or ran off the end of memory, or until an
+  // instruction trapped on any of the active lanes.
+  Trap run();
+  const TrapState &last_trap() const { return m_trap_state; }
+
+  MemoryBank::MemoryBuffer &lane_memory(size_t lane) {
+    return m_lane_memory[lane];
+  }
+
+  alignas(32) std::array<Lanes<uint32_t>, MemoryBank::GP_REGS_32_COUNT>
+      gp_regs_32;
+  alignas(32) std::array<Lanes<float>, MemoryBank::FL_REGS_32_COUNT>
+      fl_regs_32;
+
+private:
+  constexpr static MemPtr NO_FAULT_ADDRESS = 0xffffffff;
+
+  Trap execute(uint32_t pc, LaneMask active);
+
+  MemoryBank::MemoryBuffer m_code;
+  std::vector<MemoryBank::MemoryBuffer> m_lane_memory;
+  LaneMask m_halted = 0;
+  TrapState m_trap_state;
+  MemPtr m_fault_address = NO_FAULT_ADDRESS;
+};
+
+extern template class WideInterpreter<8>;
+extern template class WideInterpreter<16>;
+
+#endif // WIDE_INTERPRETER_HXX
@@ -0,0 +1,279 @@
+#include <interp/instructions.hxx>
+#include <interp/interpreter.hxx>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <set>
+#include <spawn.h>
+#include <sstream>
+#include <string>
+#include <sys/wait.h>
+#include <vector>
+
+extern char **environ;
+
+// NOTE: Ahead-of-time compiler. Translates a bytecode image into C++ and
+// compiles it into a shared object that Interpreter::load_native runs.
+//
+// Every instruction becomes a call to its callback with the parameters baked
+// in as literals and gets a label, static jump targets become direct gotos
+// and everything else (register jumps, returns) goes through a switch over
+// the translated addresses. The callbacks are compiled into the same
+// translation unit (interpreter.cxx is included) so the compiler can inline
+// them. Addresses the translation doesn't know make the native code return
+// and the interpreter takes over.
+//
+// NOTE: Native code does not record the binary trace. It counts the guest
+// instructions it ran and returns the count, for the metrics and the
+// performance counters.
+//
+// NOTE: The translated image is registered in the code map (code_map.hxx).
+// Native code returns to the interpreter instead of running an instruction
+// from a line the guest has overwritten. The check is done when entering a
+// new line, at jump targets and after instructions that store to memory, so
+// straight-line code within a line runs without it.
+//
+// NOTE: An instruction that traps leaves the state as it was, the native code
+// points the program counter back at it and returns, the interpreter runs it
+// again and delivers the trap.
+
+struct TranslatedInstruction {
+  uint32_t pc;
+  uint32_t next_pc;
+  std::string statement;
+  bool has_static_target;
+  MemPtr static_target;
+  bool writes_memory;
+};
+
+bool has_static_target(uint8_t op) {
+  switch (op) {
+  case VM::OpCodes::JUMP:
+  case VM::OpCodes::JUMP_ZERO:
+  case VM::OpCodes::JUMP_EQUAL:
+  case VM::OpCodes::JUMP_LESS_THAN:
+  case VM::OpCodes::JUMP_GREATER_THAN:
+  case VM::OpCodes::CALL:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool writes_memory(uint8_t op) {
+  switch (op) {
+  case VM::OpCodes::STORE:
+  case VM::OpCodes::STORE_BYTE:
+  case VM::OpCodes::STORE_HALF_WORD:
+  case VM::OpCodes::STORE_FLOAT:
+  case VM::OpCodes::PUSH_STACK:
+  case VM::OpCodes::PUSH_FLOAT_STACK:
+  case VM::OpCodes::CALL:
+  case VM::OpCodes::CALL_REGISTER:
+  case VM::OpCodes::ENTER:
+  case VM::OpCodes::PUSH_MULTIPLE_STACK:
+  case VM::OpCodes::IO_READ:
+  case VM::OpCodes::REALLOCATE:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// NOTE: Decoding stops at the first byte that is not an opcode, at an
+// instruction that would run past the image or one with operands that don't
+// decode (an invalid register), whatever follows is data.
+std::vector<TranslatedInstruction> translate(MemoryBank::MemoryBuffer &memory,
+                                             uint32_t image_size) {
+  std::vector<TranslatedInstruction> instructions;
+  uint32_t pc = 0;
+
+  while (pc < image_size && memory[pc] < VM::instruction_keywords.size()) {
+    uint8_t op = memory[pc];
+    uint32_t next_pc = pc + 1;
+    TranslatedInstruction ins{pc, 0, VM::aot::emit_instruction(op, memory, next_pc),
+                              has_static_target(op), 0, writes_memory(op)};
+
+    if (ins.statement.empty() || next_pc > image_size) {
+      break;
+    }
+
+    if (ins.has_static_target) {
+      uint32_t target_pc = pc + 1;
+      ins.static_target = read_valid_mem_address(memory, target_pc);
+    }
+
+    ins.next_pc = next_pc;
+    instructions.push_back(ins);
+    pc = next_pc;
+  }
+
+  return instructions;
+}
+
+std::string generate_source(const std::vector<TranslatedInstruction> &program) {
+  std::set<uint32_t> known;
+  std::set<uint32_t> targets;
+  for (auto &ins : program) {
+    known.insert(ins.pc);
+    if (ins.has_static_target) {
+      targets.insert(ins.static_target);
+    }
+  }
+
+  auto line = [](uint32_t address) { return address >> CodeMap::LINE_SHIFT; };
+
+  std::ostringstream src;
+  src << "// Generated by the aot tool, do not edit.\n"
+      << "#include \"" INTERP_SOURCE_DIR "/interpreter.cxx\"\n\n"
+      << "#define PC interp.m_mb.gp_regs_32[MemoryBank::PROGRAM_COUNTER_REG]\n"
+      << "#define STALE(begin, end) interp.m_mb.code_map.is_stale(begin, end)\n"
+      << "#define LEAVE return executed\n\n"
+      << "extern \"C\" __attribute__((visibility(\"default\"))) const uint32_t\n"
+      << "interp_aot_code_size = "
+      << (program.empty() ? 0 : program.back().next_pc) << ";\n\n"
+      << "extern \"C\" __attribute__((visibility(\"default\"))) uint64_t\n"
+      << "interp_aot_entry(Interpreter &interp) {\n"
+      << "  uint64_t executed = 0;\n"
+      << "  goto dispatch;\n";
+
+  const TranslatedInstruction *previous = nullptr;
+  for (auto &ins : program) {
+    src << "L_" << ins.pc << ":\n";
+
+    if (!previous || line(previous->pc) != line(ins.pc) ||
+        line(ins.pc) != line(ins.next_pc - 1) || previous->writes_memory ||
+        targets.count(ins.pc)) {
+      src << "  if (STALE(" << ins.pc << ", " << ins.next_pc
+          << ")) LEAVE;\n";
+    }
+    previous = &ins;
+
+    src << "  PC = " << ins.next_pc << ";\n"
+        << "  if (" << ins.statement << " != Trap::NONE) { PC = " << ins.pc
+        << "; LEAVE; }\n"
+        << "  executed++;\n";
+
+    if (ins.has_static_target && known.count(ins.static_target)) {
+      src << "  if (PC == " << ins.static_target
+          << " && interp.is_running()) goto L_" << ins.static_target << ";\n";
+    }
+
+    src << "  if (PC != " << ins.next_pc
+        << " || !interp.is_running()) goto dispatch;\n";
+  }
+
+  src << "  LEAVE;\n"
+      << "dispatch:\n"
+      << "  if (!interp.is_running()) LEAVE;\n"
+      << "  switch (PC) {\n";
+
+  for (auto &ins : program) {
+    src << "  case " << ins.pc << ":\n"
+        << "    if (STALE(" << ins.pc << ", " << ins.next_pc << ")) LEAVE;\n"
+        << "    goto L_" << ins.pc << ";\n";
+  }
+
+  src << "  default: LEAVE;\n"
+      << "  }\n"
+      << "}\n";
+
+  return src.str();
+}
+
+// NOTE: Runs the compiler without a shell, so paths are passed as they are.
+// $CXX may name a compiler with arguments (say "ccache g++"), it is split on
+// whitespace.
+bool compile(const std::string &compiler, const std::string &source_path,
+             const std::string &output_path) {
+  std::vector<std::string> args;
+  std::istringstream words(compiler);
+  for (std::string word; words >> word;) {
+    args.push_back(word);
+  }
+  if (args.empty()) {
+    std::cerr << "No compiler to run" << std::endl;
+    return false;
+  }
+
+  std::string include_dir = INTERP_INCLUDE_DIR;
+  args.insert(args.end(), {"-std=c++20", "-O2", "-shared", "-fPIC",
+                           "-fvisibility=hidden", "-Wno-unused-label",
+                           "-I" + include_dir, "-I" + include_dir + "/interp",
+                           source_path, "-o", output_path});
+
+  std::vector<char *> argv;
+  for (auto &arg : args) {
+    argv.push_back(arg.data());
+  }
+  argv.push_back(nullptr);
+
+  pid_t pid;
+  int status;
+  if (int error = posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(),
+                               environ);
+      error != 0) {
+    std::cerr << "Failed to run " << args[0] << ": " << std::strerror(error)
+              << std::endl;
+    return false;
+  }
+  while (waitpid(pid, &status, 0) < 0) {
+    if (errno != EINTR) {
+      return false;
+    }
+  }
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    std::cerr << argv[0] << ": <BYTECODE IMAGE> <OUTPUT SHARED OBJECT>"
+              << std::endl;
+    return 1;
+  }
+
+  std::string image_path = argv[1];
+  std::string output_path = argv[2];
+
+  std::ifstream in(image_path, std::ios::binary);
+  if (!in) {
+    std::cerr << "Failed to open bytecode image: " << image_path << std::endl;
+    return 1;
+  }
+
+  Interpreter::BytecodeBuffer image{std::istreambuf_iterator<char>(in),
+                                    std::istreambuf_iterator<char>()};
+
+  if (image.size() > MemoryBank::MEMORY_SIZE) {
+    std::cerr << "Bytecode image too large for VM memory!" << std::endl;
+    return 1;
+  }
+
+  MemoryBank::MemoryBuffer memory{0};
+  std::copy(image.begin(), image.end(), memory.begin());
+
+  auto program = translate(memory, image.size());
+
+  std::string source_path = output_path + ".cxx";
+  std::ofstream(source_path) << generate_source(program);
+
+  const char *compiler = std::getenv("CXX");
+  bool compiled =
+      compile(compiler ? compiler : INTERP_AOT_COMPILER, source_path,
+              output_path);
+  std::remove(source_path.c_str());
+
+  if (!compiled) {
+    std::cerr << "Failed to compile translated program into " << output_path
+              << std::endl;
+    return 1;
+  }
+
+  std::cout << "Translated " << program.size() << " instructions into "
+            << output_path << std::endl;
+  return 0;
+}
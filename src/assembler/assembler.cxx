@@ -1,18 +1,353 @@
 #include <interp/assembler/assembler.hxx>
 #include <cstdint>
 #include <interp/instructions.hxx>
+#include <interp/numeric.hxx>
+#include <boost/format.hpp>
+#include <cctype>
+#include <cstring>
 #include <iterator>
+#include <span>
+#include <sstream>
 #include <string>
 #include <vector>
 
 /*
-** TODO: Don't forget to handle label offsets correctly.
-** To be honest we are running the code without any kernel so it most addresses
-** will be hardcoded anyway
+** NOTE: Label offsets are relative to the module, every address that refers
+** to a label gets a relocation and the linker fixes it up once it knows
+** where the module ends up in the image (see object.hxx and linker.hxx).
 */
 
+namespace {
+
+bool is_identifier_start(char c) {
+  return std::isalpha(static_cast<unsigned char>(c)) || c == '_' || c == '.';
+}
+
+bool is_identifier_char(char c) {
+  return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '.';
+}
+
+bool is_register_name(const std::string &str) {
+  if (str.size() < 2 || (str[0] != 'r' && str[0] != 'f')) {
+    return false;
+  }
+  for (size_t i = 1; i < str.size(); i++) {
+    if (!std::isdigit(static_cast<unsigned char>(str[i]))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// NOTE: Decimal, 0x prefixed hexadecimal or 0b prefixed binary, optionally
+// negative, see numeric.hxx.
+std::optional<int64_t> parse_number(const std::string &str) {
+  int64_t value;
+  const char *last = str.data() + str.size();
+  auto result = numeric::parse_integer(str.data(), last, value);
+  if (!result.ok() || result.end != last) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+void put_le(std::vector<uint8_t> &code, uint32_t value, uint32_t size) {
+  for (uint32_t i = 0; i < size; i++) {
+    code.push_back((value >> (8 * i)) & 0xff);
+  }
+}
+
+uint32_t operand_size(VM::OperandKind kind) {
+  return VM::operand_sizes[static_cast<size_t>(kind)];
+}
+
+std::optional<uint8_t> find_opcode(const std::string &keyword) {
+  static const std::unordered_map<std::string, uint8_t> opcodes = [] {
+    std::unordered_map<std::string, uint8_t> map;
+    for (size_t op = 0; op < VM::instruction_info.size(); op++) {
+      map.emplace(VM::instruction_info[op].keyword, op);
+    }
+    return map;
+  }();
+
+  auto it = opcodes.find(keyword);
+  if (it == opcodes.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+} // namespace
+
 assembler::Assembler &assembler::Assembler::operator<<(const std::string &str) {
+  std::istringstream lines(str);
   std::string line;
 
+  while (std::getline(lines, line)) {
+    m_line++;
+    if (auto tokens = tokenize(line)) {
+      assemble(*tokens);
+    }
+  }
+
+  return *this;
+}
+
+assembler::Assembler &
+assembler::Assembler::operator<<(generic_ling::LineReader &reader) {
+  while (auto line = reader.next()) {
+    m_line++;
+    if (auto tokens = tokenize(*line)) {
+      assemble(*tokens);
+    }
+  }
+
   return *this;
 }
+
+assembler::MaybeTokenVector
+assembler::Assembler::tokenize(std::string_view str) {
+  TokenVector tokens;
+  size_t end = std::min(str.find(';'), str.size());
+  size_t i = 0;
+
+  auto scan = [&](size_t from, auto predicate) {
+    while (from < end && predicate(str[from])) {
+      from++;
+    }
+    return from;
+  };
+
+  auto is_value_char = [](char c) {
+    return is_identifier_char(c) || c == '-' || c == '+';
+  };
+
+  while (i < end) {
+    char c = str[i];
+
+    if (std::isspace(static_cast<unsigned char>(c)) || c == ',') {
+      i++;
+    } else if (c == '$') {
+      size_t last = scan(i + 1, is_value_char);
+      if (last == i + 1) {
+        error("Expected a value after '$'");
+        return std::nullopt;
+      }
+      tokens.push_back(
+          {Token::IMMEDIATE_VALUE, std::string(str.substr(i + 1, last - i - 1))});
+      i = last;
+    } else if (std::isdigit(static_cast<unsigned char>(c)) || c == '-') {
+      size_t last = scan(i + 1, is_identifier_char);
+      tokens.push_back(
+          {Token::MEMORY_ADDRESS, std::string(str.substr(i, last - i))});
+      i = last;
+    } else if (is_identifier_start(c)) {
+      size_t last = scan(i + 1, is_identifier_char);
+      std::string name(str.substr(i, last - i));
+
+      if (last < end && str[last] == ':') {
+        if (!tokens.empty()) {
+          error((boost::format("Unexpected label '%1%'") % name).str());
+          return std::nullopt;
+        }
+        tokens.push_back({Token::LABEL_SPECIFIER, name});
+        last++;
+      } else if (tokens.empty() ||
+                 (tokens.size() == 1 &&
+                  tokens[0].type == Token::LABEL_SPECIFIER)) {
+        tokens.push_back({Token::KEYWORD, name});
+      } else if (is_register_name(name)) {
+        tokens.push_back({Token::REGISTER_ID, name});
+      } else {
+        tokens.push_back({Token::SYMBOL, name});
+      }
+      i = last;
+    } else {
+      error((boost::format("Unexpected character '%1%'") % c).str());
+      return std::nullopt;
+    }
+  }
+
+  return tokens;
+}
+
+void assembler::Assembler::assemble(const TokenVector &tokens) {
+  auto it = tokens.begin();
+
+  if (it != tokens.end() && it->type == Token::LABEL_SPECIFIER) {
+    auto index = symbol_index(it->value);
+    auto &symbol = m_object.symbols[index];
+
+    if (symbol.binding != Symbol::UNDEFINED) {
+      error((boost::format("Symbol '%1%' redefined") % it->value).str());
+    } else {
+      symbol.value = m_object.code.size();
+      symbol.binding =
+          m_exported.count(index) ? Symbol::GLOBAL : Symbol::LOCAL;
+    }
+    it++;
+  }
+
+  if (it == tokens.end()) {
+    return;
+  }
+
+  const std::string &keyword = it->value;
+  TokenVector operands(it + 1, tokens.end());
+
+  if (keyword == ".global") {
+    for (auto &operand : operands) {
+      if (operand.type != Token::SYMBOL) {
+        error((boost::format("Expected a symbol, found '%1%'") % operand.value)
+                  .str());
+        continue;
+      }
+      auto index = symbol_index(operand.value);
+      m_exported.insert(index);
+      if (m_object.symbols[index].binding == Symbol::LOCAL) {
+        m_object.symbols[index].binding = Symbol::GLOBAL;
+      }
+    }
+  } else if (keyword == ".word" || keyword == ".byte") {
+    emit_data(operands, keyword == ".word" ? 4 : 1);
+  } else if (auto opcode = find_opcode(keyword)) {
+    emit_instruction(*opcode, operands);
+  } else {
+    error((boost::format("Unknown instruction '%1%'") % keyword).str());
+  }
+}
+
+void assembler::Assembler::emit_instruction(uint8_t opcode,
+                                            const TokenVector &operands) {
+  const auto &info = VM::instruction_info[opcode];
+
+  if (operands.size() != info.operand_count) {
+    error((boost::format("'%1%' takes %2% operands, found %3%") %
+           info.keyword % (int)info.operand_count % operands.size())
+              .str());
+    return;
+  }
+
+  m_object.code.push_back(opcode);
+
+  for (size_t i = 0; i < operands.size(); i++) {
+    const Token &operand = operands[i];
+    auto kind = info.operands[i];
+
+    switch (kind) {
+    case VM::OperandKind::REGISTER:
+    case VM::OperandKind::FLOAT_REGISTER: {
+      char prefix = kind == VM::OperandKind::REGISTER ? 'r' : 'f';
+      auto id = operand.type == Token::REGISTER_ID && operand.value[0] == prefix
+                    ? parse_number(operand.value.substr(1))
+                    : std::nullopt;
+      if (!id || *id >= MemoryBank::GP_REGS_32_COUNT) {
+        error((boost::format("Expected a register %1%0-%1%%2%, found '%3%'") %
+               prefix % (MemoryBank::GP_REGS_32_COUNT - 1) % operand.value)
+                  .str());
+        id = 0;
+      }
+      m_object.code.push_back(*id);
+      break;
+    }
+    case VM::OperandKind::FLOAT: {
+      float value = 0;
+      const char *last = operand.value.data() + operand.value.size();
+      auto result = numeric::parse_float(operand.value.data(), last, value);
+      if (operand.type != Token::IMMEDIATE_VALUE || !result.ok() ||
+          result.end != last) {
+        error((boost::format("Expected a float immediate, found '%1%'") %
+               operand.value)
+                  .str());
+      }
+      uint32_t bits;
+      std::memcpy(&bits, &value, sizeof(bits));
+      put_le(m_object.code, bits, sizeof(bits));
+      break;
+    }
+    default:
+      emit_value(operand, operand_size(kind));
+      break;
+    }
+  }
+}
+
+// NOTE: Data tables are converted in bulk, symbols and malformed values stop
+// the conversion and go through emit_value one at a time.
+void assembler::Assembler::emit_data(const TokenVector &operands,
+                                     uint32_t size) {
+  std::vector<std::string_view> literals;
+  literals.reserve(operands.size());
+  for (auto &operand : operands) {
+    bool is_number = operand.type == Token::IMMEDIATE_VALUE ||
+                     operand.type == Token::MEMORY_ADDRESS;
+    literals.push_back(is_number ? std::string_view(operand.value) : "");
+  }
+
+  std::vector<int64_t> values(operands.size());
+  size_t i = 0;
+  while (i < operands.size()) {
+    size_t count = numeric::parse_integers(
+        std::span(literals).subspan(i), std::span(values).subspan(i));
+    for (size_t end = i + count; i < end; i++) {
+      emit_number(values[i], size);
+    }
+    if (i < operands.size()) {
+      emit_value(operands[i], size);
+      i++;
+    }
+  }
+}
+
+void assembler::Assembler::emit_value(const Token &token, uint32_t size) {
+  if (token.type != Token::IMMEDIATE_VALUE &&
+      token.type != Token::MEMORY_ADDRESS && token.type != Token::SYMBOL) {
+    error((boost::format("Expected a value, found '%1%'") % token.value).str());
+    put_le(m_object.code, 0, size);
+    return;
+  }
+
+  auto value = token.type == Token::SYMBOL ? std::nullopt
+                                           : parse_number(token.value);
+
+  if (!value) {
+    if (!is_identifier_start(token.value[0]) || size != sizeof(uint32_t)) {
+      error((boost::format("Invalid %1%-bit value '%2%'") % (size * 8) %
+             token.value)
+                .str());
+    } else {
+      m_object.relocations.push_back({(uint32_t)m_object.code.size(),
+                                      symbol_index(token.value), 0,
+                                      Relocation::ABS32});
+    }
+    put_le(m_object.code, 0, size);
+    return;
+  }
+
+  emit_number(*value, size);
+}
+
+void assembler::Assembler::emit_number(int64_t value, uint32_t size) {
+  int64_t lowest = -(int64_t(1) << (size * 8 - 1));
+  int64_t highest = (int64_t(1) << (size * 8)) - 1;
+  if (value < lowest || value > highest) {
+    error((boost::format("Value %1% does not fit in %2% bits") % value %
+           (size * 8))
+              .str());
+  }
+  put_le(m_object.code, static_cast<uint32_t>(value), size);
+}
+
+uint32_t assembler::Assembler::symbol_index(const std::string &name) {
+  auto [it, inserted] =
+      m_symbol_indices.emplace(name, m_object.symbols.size());
+  if (inserted) {
+    m_object.symbols.push_back({name, 0, Symbol::UNDEFINED});
+  }
+  return it->second;
+}
+
+void assembler::Assembler::error(const std::string &message) {
+  m_errors.push_back(
+      (boost::format("line %1%: %2%") % m_line % message).str());
+}
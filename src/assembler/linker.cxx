@@ -0,0 +1,173 @@
+#include <interp/assembler/assembler.hxx>
+#include <interp/assembler/linker.hxx>
+#include <interp/interpreter.hxx>
+#include <boost/format.hpp>
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+assembler::Linker::Linker(size_t jobs) : m_jobs(std::max<size_t>(jobs, 1)) {}
+
+void assembler::Linker::add_module(const std::string &source_path) {
+  Module module;
+  module.source_path = source_path;
+  module.object_path =
+      std::filesystem::path(source_path).replace_extension(".o").string();
+  m_modules.push_back(std::move(module));
+}
+
+void assembler::Linker::build_module(Module &module) {
+  namespace fs = std::filesystem;
+  std::error_code ec;
+
+  auto source_time = fs::last_write_time(module.source_path, ec);
+  if (ec) {
+    module.errors.push_back((boost::format("%1%: %2%") % module.source_path %
+                             ec.message())
+                                .str());
+    return;
+  }
+
+  auto object_time = fs::last_write_time(module.object_path, ec);
+  if (!ec && object_time >= source_time) {
+    std::ifstream in(module.object_path, std::ios::binary);
+    try {
+      module.object = ObjectFile::read(in);
+      return;
+    } catch (std::runtime_error &e) {
+      // NOTE: A broken object file is simply rebuilt.
+    }
+  }
+
+  Assembler assembler;
+  try {
+    generic_ling::LineReader source(module.source_path);
+    assembler << source;
+  } catch (std::runtime_error &e) {
+    module.errors.push_back(e.what());
+    return;
+  }
+
+  for (auto &error : assembler.get_errors()) {
+    module.errors.push_back(
+        (boost::format("%1%: %2%") % module.source_path % error).str());
+  }
+  if (!module.errors.empty()) {
+    return;
+  }
+
+  module.object = assembler.object();
+  module.assembled = true;
+
+  std::ofstream out(module.object_path, std::ios::binary | std::ios::trunc);
+  module.object.write(out);
+  if (!out) {
+    module.errors.push_back(
+        (boost::format("%1%: Could not write object file") % module.object_path)
+            .str());
+  }
+}
+
+bool assembler::Linker::build_objects() {
+  std::atomic<size_t> next{0};
+  auto worker = [&] {
+    for (size_t i = next++; i < m_modules.size(); i = next++) {
+      build_module(m_modules[i]);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < std::min(m_jobs, m_modules.size()); i++) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  m_assembled_count = 0;
+  for (auto &module : m_modules) {
+    m_assembled_count += module.assembled;
+    m_errors.insert(m_errors.end(), module.errors.begin(), module.errors.end());
+  }
+
+  return m_errors.empty();
+}
+
+bool assembler::Linker::link(std::vector<uint8_t> &image) {
+  size_t size = 0;
+  size_t global_count = 0;
+
+  for (auto &module : m_modules) {
+    module.base = size;
+    size += module.object.code.size();
+    global_count += std::count_if(
+        module.object.symbols.begin(), module.object.symbols.end(),
+        [](const Symbol &s) { return s.binding == Symbol::GLOBAL; });
+  }
+
+  if (size > MemoryBank::MEMORY_SIZE) {
+    m_errors.push_back(
+        (boost::format("Image too large for VM memory!(size: %1%)") % size)
+            .str());
+    return false;
+  }
+
+  std::unordered_map<std::string_view, std::pair<uint32_t, const Module *>>
+      globals;
+  globals.reserve(global_count);
+
+  for (auto &module : m_modules) {
+    for (auto &symbol : module.object.symbols) {
+      if (symbol.binding != Symbol::GLOBAL) {
+        continue;
+      }
+      auto [it, inserted] =
+          globals.emplace(symbol.name, std::pair{module.base + symbol.value,
+                                                 &module});
+      if (!inserted) {
+        m_errors.push_back(
+            (boost::format("Symbol '%1%' defined in both %2% and %3%") %
+             symbol.name % it->second.second->source_path % module.source_path)
+                .str());
+      }
+    }
+  }
+
+  image.clear();
+  image.reserve(size);
+  for (auto &module : m_modules) {
+    image.insert(image.end(), module.object.code.begin(),
+                 module.object.code.end());
+  }
+
+  for (auto &module : m_modules) {
+    for (auto &relocation : module.object.relocations) {
+      auto &symbol = module.object.symbols[relocation.symbol];
+      uint32_t address;
+
+      if (symbol.binding != Symbol::UNDEFINED) {
+        address = module.base + symbol.value;
+      } else if (auto it = globals.find(symbol.name); it != globals.end()) {
+        address = it->second.first;
+      } else {
+        m_errors.push_back(
+            (boost::format("%1%: Undefined symbol '%2%'") %
+             module.source_path % symbol.name)
+                .str());
+        continue;
+      }
+
+      uint32_t value = address + relocation.addend;
+      for (uint32_t i = 0; i < sizeof(uint32_t); i++) {
+        image[module.base + relocation.offset + i] = (value >> (8 * i)) & 0xff;
+      }
+    }
+  }
+
+  return m_errors.empty();
+}
@@ -1,46 +1,65 @@
 #include <interp/assembler/assembler.hxx>
+#include <interp/assembler/linker.hxx>
+#include <interp/numeric.hxx>
+#include <fstream>
 #include <iostream>
+#include <thread>
 
-namespace assembler {
+// NOTE: assembler [-j jobs] -o <image> <source>...
+// Assembles the modules (reusing up to date object files) and links them
+// into a raw image that is loaded at address 0.
+int main(int argc, char **argv) {
+  std::string image_path;
+  size_t jobs = std::thread::hardware_concurrency();
+  std::vector<std::string> sources;
 
-int parse_digit(const char *ptr) {
-  if (*ptr >= '0' && *ptr <= '9') {
-    return static_cast<int>(*ptr - '0');
-  } else {
-    return -1;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "-o" && i + 1 < argc) {
+      image_path = argv[++i];
+    } else if (arg == "-j" && i + 1 < argc) {
+      std::string_view count = argv[++i];
+      uint32_t value = 0;
+      auto result = numeric::parse_u32(count.data(),
+                                       count.data() + count.size(), value);
+      if (!result.ok() || result.end != count.data() + count.size()) {
+        std::cerr << "Invalid job count '" << count << "'\n";
+        return 1;
+      }
+      jobs = value;
+    } else {
+      sources.push_back(arg);
+    }
   }
-}
 
-const char *find_last_digit(const char *ptr) {
-  while (*ptr >= '0' && *ptr <= '9') {
-    ptr++;
+  if (image_path.empty() || sources.empty()) {
+    std::cerr << "usage: " << argv[0] << " [-j jobs] -o <image> <source>...\n";
+    return 1;
   }
-  return ptr;
-}
 
-uint32_t parse_u32(const char *ptr) {
-  const char *last = find_last_digit(ptr);
-  uint32_t n = 0;
-
-  while (uint32_t d = parse_digit(ptr)) {
-    n *= 10;
-    n += d;
-    ptr++;
+  assembler::Linker linker(jobs);
+  for (auto &source : sources) {
+    linker.add_module(source);
   }
 
-  return n;
-}
-
-} // namespace assembler
-
-int main(int argc, char **argv) {
-
-  std::cout << "Hello world!" << std::endl;
+  std::vector<uint8_t> image;
+  if (!linker.build_objects() || !linker.link(image)) {
+    for (auto &error : linker.get_errors()) {
+      std::cerr << error << std::endl;
+    }
+    return 1;
+  }
 
-  assembler::Assembler ass;
+  std::ofstream out(image_path, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char *>(image.data()), image.size());
+  if (!out) {
+    std::cerr << "Could not write " << image_path << std::endl;
+    return 1;
+  }
 
-  ass << "ldi $10, r1"
-      << "addi r1, $0, r2";
+  std::cout << "Assembled " << linker.assembled_count() << " of "
+            << sources.size() << " modules, image size " << image.size()
+            << " bytes" << std::endl;
 
   return 0;
 }
@@ -0,0 +1,142 @@
+#include <interp/assembler/object.hxx>
+#include <boost/format.hpp>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+template <typename T> void put(std::ostream &out, T value) {
+  uint8_t bytes[sizeof(T)];
+  std::memcpy(bytes, &value, sizeof(T));
+  out.write(reinterpret_cast<const char *>(bytes), sizeof(T));
+}
+
+template <typename T> T get(std::istream &in) {
+  T value;
+  if (!in.read(reinterpret_cast<char *>(&value), sizeof(T))) {
+    throw std::runtime_error("Truncated object file!");
+  }
+  return value;
+}
+
+// NOTE: On disk sizes of a symbol without its name and of a relocation.
+constexpr uint64_t SYMBOL_SIZE =
+    sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint16_t);
+constexpr uint64_t RELOCATION_SIZE =
+    sizeof(uint32_t) + sizeof(uint32_t) + sizeof(int32_t) + sizeof(uint8_t);
+
+uint64_t remaining(std::istream &in) {
+  auto position = in.tellg();
+  in.seekg(0, std::ios::end);
+  auto end = in.tellg();
+  in.seekg(position);
+
+  if (position < 0 || end < position) {
+    throw std::runtime_error("Object file stream is not seekable!");
+  }
+  return end - position;
+}
+
+} // namespace
+
+void assembler::ObjectFile::write(std::ostream &out) const {
+  out.write(MAGIC, sizeof(MAGIC));
+  put<uint16_t>(out, VERSION);
+  put<uint16_t>(out, 0);
+  put<uint32_t>(out, code.size());
+  put<uint32_t>(out, symbols.size());
+  put<uint32_t>(out, relocations.size());
+
+  out.write(reinterpret_cast<const char *>(code.data()), code.size());
+
+  for (auto &symbol : symbols) {
+    put<uint32_t>(out, symbol.value);
+    put<uint8_t>(out, symbol.binding);
+    put<uint16_t>(out, symbol.name.size());
+    out.write(symbol.name.data(), symbol.name.size());
+  }
+
+  for (auto &relocation : relocations) {
+    put<uint32_t>(out, relocation.offset);
+    put<uint32_t>(out, relocation.symbol);
+    put<int32_t>(out, relocation.addend);
+    put<uint8_t>(out, relocation.type);
+  }
+}
+
+assembler::ObjectFile assembler::ObjectFile::read(std::istream &in) {
+  char magic[sizeof(MAGIC)];
+  if (!in.read(magic, sizeof(magic)) ||
+      std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+    throw std::runtime_error("Not an object file!");
+  }
+
+  auto version = get<uint16_t>(in);
+  if (version != VERSION) {
+    throw std::runtime_error(
+        (boost::format("Unsupported object file version: %1%") % version)
+            .str());
+  }
+  get<uint16_t>(in);
+
+  auto code_size = get<uint32_t>(in);
+  auto symbol_count = get<uint32_t>(in);
+  auto relocation_count = get<uint32_t>(in);
+
+  // NOTE: The counts are checked against what is left of the stream before
+  // anything is allocated, a corrupt header can't ask for gigabytes.
+  uint64_t left = remaining(in);
+  if (code_size + symbol_count * SYMBOL_SIZE +
+          relocation_count * RELOCATION_SIZE >
+      left) {
+    throw std::runtime_error("Truncated object file!");
+  }
+  left -= code_size + symbol_count * SYMBOL_SIZE +
+          relocation_count * RELOCATION_SIZE;
+
+  ObjectFile object;
+  object.code.resize(code_size);
+  object.symbols.resize(symbol_count);
+  object.relocations.resize(relocation_count);
+
+  if (!in.read(reinterpret_cast<char *>(object.code.data()),
+               object.code.size())) {
+    throw std::runtime_error("Truncated object file!");
+  }
+
+  for (auto &symbol : object.symbols) {
+    symbol.value = get<uint32_t>(in);
+    auto binding = get<uint8_t>(in);
+    if (binding > Symbol::UNDEFINED) {
+      throw std::runtime_error(
+          (boost::format("Invalid symbol binding: %1%") % (int)binding).str());
+    }
+    symbol.binding = static_cast<Symbol::Binding>(binding);
+    auto name_size = get<uint16_t>(in);
+    if (name_size > left) {
+      throw std::runtime_error("Truncated object file!");
+    }
+    left -= name_size;
+    symbol.name.resize(name_size);
+    if (!in.read(symbol.name.data(), symbol.name.size())) {
+      throw std::runtime_error("Truncated object file!");
+    }
+  }
+
+  for (auto &relocation : object.relocations) {
+    relocation.offset = get<uint32_t>(in);
+    relocation.symbol = get<uint32_t>(in);
+    relocation.addend = get<int32_t>(in);
+    auto type = get<uint8_t>(in);
+    if (type != Relocation::ABS32 || relocation.symbol >= object.symbols.size() ||
+        uint64_t(relocation.offset) + sizeof(uint32_t) > object.code.size()) {
+      throw std::runtime_error(
+          (boost::format("Invalid relocation at offset %1%") %
+           relocation.offset)
+              .str());
+    }
+    relocation.type = static_cast<Relocation::Type>(type);
+  }
+
+  return object;
+}
@@ -0,0 +1,94 @@
+#include <interp/code_map.hxx>
+#include <algorithm>
+
+void CodeMap::mark_code(uint64_t begin, uint64_t end) {
+  if (begin >= end) {
+    return;
+  }
+  for (uint64_t line = line_of(begin); line <= line_of(end - 1); line++) {
+    m_code[line / 64] |= uint64_t(1) << (line % 64);
+    m_stale[line / 64] &= ~(uint64_t(1) << (line % 64));
+    update_trap(line);
+  }
+}
+
+// NOTE: Everything decoded is gone, the listeners are told about all of the
+// code lines.
+void CodeMap::clear() {
+  uint64_t first = m_line_count;
+  uint64_t last = 0;
+  for (uint64_t line = 0; line < m_line_count; line++) {
+    if (test(m_code, line)) {
+      first = std::min(first, line);
+      last = line;
+    }
+  }
+  if (first <= last) {
+    for (auto &[id, listener] : m_listeners) {
+      listener(first, last);
+    }
+  }
+
+  std::fill(m_code.begin(), m_code.end(), 0);
+  std::fill(m_stale.begin(), m_stale.end(), 0);
+  m_trap = m_watched;
+}
+
+uint32_t CodeMap::watch(uint64_t begin, uint64_t end, Watcher watcher) {
+  for (uint64_t line = line_of(begin); line <= line_of(end - 1); line++) {
+    m_watched[line / 64] |= uint64_t(1) << (line % 64);
+    update_trap(line);
+  }
+  m_watches.push_back({m_next_watch_id, begin, end, std::move(watcher)});
+  return m_next_watch_id++;
+}
+
+void CodeMap::unwatch(uint32_t id) {
+  std::erase_if(m_watches, [id](auto &watch) { return watch.id == id; });
+
+  // NOTE: Other watches may share the lines, rebuild the bitmap.
+  std::fill(m_watched.begin(), m_watched.end(), 0);
+  for (auto &watch : m_watches) {
+    for (uint64_t line = line_of(watch.begin); line <= line_of(watch.end - 1);
+         line++) {
+      m_watched[line / 64] |= uint64_t(1) << (line % 64);
+    }
+  }
+  for (size_t i = 0; i < m_trap.size(); i++) {
+    m_trap[i] = m_code[i] | m_watched[i];
+  }
+}
+
+void CodeMap::trap(uint64_t address, uint64_t size, uint64_t first,
+                   uint64_t last) {
+  for (auto &watch : m_watches) {
+    if (address < watch.end && address + size > watch.begin) {
+      watch.watcher(address, size);
+    }
+  }
+  invalidate(first, last);
+}
+
+void CodeMap::invalidate(uint64_t first, uint64_t last) {
+  uint64_t first_changed = m_line_count;
+  uint64_t last_changed = 0;
+
+  for (uint64_t line = first; line <= last; line++) {
+    uint64_t bit = uint64_t(1) << (line % 64);
+    if (m_code[line / 64] & bit) {
+      m_code[line / 64] &= ~bit;
+      m_stale[line / 64] |= bit;
+      update_trap(line);
+      first_changed = std::min(first_changed, line);
+      last_changed = std::max(last_changed, line);
+    }
+  }
+
+  if (first_changed > last_changed) {
+    return;
+  }
+
+  for (auto &[id, listener] : m_listeners) {
+    listener(first_changed, last_changed);
+  }
+}
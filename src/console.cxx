@@ -0,0 +1,117 @@
+#include <interp/console.hxx>
+#include <cerrno>
+#include <cstring>
+#include <sys/uio.h>
+
+ConsoleDevice::ConsoleDevice(Interpreter &interp, int fd)
+    : m_interp(interp), m_fd(fd) {
+  auto &memory = m_interp.m_mb.memory;
+  std::memset(&memory[CONSOLE_BASE], 0, 8);
+
+  m_watch_id = m_interp.m_mb.code_map.watch(
+      DOORBELL, DOORBELL + sizeof(uint32_t),
+      [this](uint64_t address, uint64_t size) { doorbell(address, size); });
+  m_thread = std::thread([this] { drain(); });
+}
+
+ConsoleDevice::~ConsoleDevice() {
+  flush();
+  {
+    std::lock_guard lock(m_mutex);
+    m_stop = true;
+  }
+  m_published.notify_one();
+  m_thread.join();
+  m_interp.m_mb.code_map.unwatch(m_watch_id);
+}
+
+void ConsoleDevice::reset() {
+  flush();
+  std::lock_guard lock(m_mutex);
+  m_head.store(0);
+  m_tail.store(0);
+  m_error.store(0);
+  std::memset(&m_interp.m_mb.memory[CONSOLE_BASE], 0, 8);
+}
+
+void ConsoleDevice::flush() {
+  std::unique_lock lock(m_mutex);
+  m_drained.wait(lock, [this] {
+    return m_tail.load() == m_head.load() || m_error.load() != 0;
+  });
+  publish_tail();
+}
+
+// NOTE: Only the machine's thread (or the host while the machine is not
+// running) touches guest memory, the drain thread just moves m_tail.
+void ConsoleDevice::publish_tail() {
+  uint32_t tail = m_tail.load(std::memory_order_acquire);
+  std::memcpy(&m_interp.m_mb.memory[TAIL], &tail, sizeof(tail));
+}
+
+// NOTE: Runs on the machine's thread, inside the store instruction.
+void ConsoleDevice::doorbell(uint64_t, uint64_t) {
+  uint32_t head;
+  std::memcpy(&head, &m_interp.m_mb.memory[DOORBELL], sizeof(head));
+
+  uint32_t tail = m_tail.load(std::memory_order_acquire);
+  // NOTE: Watch callbacks can't fail the store, a head past the ring marks
+  // the device as failed and the batch is dropped.
+  if (head - tail > RING_SIZE) [[unlikely]] {
+    std::lock_guard lock(m_mutex);
+    m_error.store(EINVAL);
+    m_drained.notify_all();
+    return;
+  }
+
+  // NOTE: The lock orders the ring's bytes written by the guest before the
+  // host thread reads them.
+  {
+    std::lock_guard lock(m_mutex);
+    m_head.store(head, std::memory_order_release);
+  }
+  m_published.notify_one();
+  publish_tail();
+}
+
+void ConsoleDevice::drain() {
+  auto &memory = m_interp.m_mb.memory;
+  std::unique_lock lock(m_mutex);
+
+  for (;;) {
+    m_published.wait(lock, [this] {
+      return m_stop ||
+             (m_head.load() != m_tail.load() && m_error.load() == 0);
+    });
+    if (m_head.load() == m_tail.load() || m_error.load() != 0) {
+      return;
+    }
+
+    uint32_t head = m_head.load();
+    uint32_t tail = m_tail.load();
+    lock.unlock();
+
+    while (tail != head && m_error.load() == 0) {
+      uint32_t begin = tail % RING_SIZE;
+      uint32_t length = head - tail;
+      uint32_t first = std::min(length, RING_SIZE - begin);
+
+      iovec pieces[2] = {{&memory[RING_BASE + begin], first},
+                         {&memory[RING_BASE], length - first}};
+      ssize_t res = ::writev(m_fd, pieces, length == first ? 1 : 2);
+
+      if (res < 0 && errno == EINTR) {
+        continue;
+      }
+      if (res < 0) {
+        m_error.store(errno);
+        break;
+      }
+      tail += res;
+    }
+
+    lock.lock();
+    m_tail.store(tail);
+    m_drained.notify_all();
+  }
+}
@@ -0,0 +1,149 @@
+#include <interp/disassembler.hxx>
+#include <interp/instructions.hxx>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+namespace {
+
+// NOTE: Every put returns the end of what it wrote, the line buffer always
+// has room for a whole line.
+char *put(char *out, std::string_view text) {
+  std::memcpy(out, text.data(), text.size());
+  return out + text.size();
+}
+
+template <typename T> char *put_number(char *out, T value, int base = 10) {
+  return std::to_chars(out, out + 32, value, base).ptr;
+}
+
+char *put_float(char *out, float value) {
+  return std::to_chars(out, out + 32, value).ptr;
+}
+
+char *put_address(char *out, uint32_t address) {
+  constexpr char digits[] = "0123456789abcdef";
+  for (int shift = 28; shift >= 0; shift -= 4) {
+    *out++ = digits[(address >> shift) & 0xf];
+  }
+  return out;
+}
+
+template <typename T> T read_operand(const uint8_t *ptr) {
+  T value;
+  std::memcpy(&value, ptr, sizeof(value));
+  return value;
+}
+
+char *put_operand(char *out, VM::OperandKind kind, const uint8_t *ptr) {
+  using Kind = VM::OperandKind;
+
+  switch (kind) {
+  case Kind::REGISTER:
+    *out++ = 'r';
+    return put_number(out, unsigned(*ptr));
+  case Kind::FLOAT_REGISTER:
+    *out++ = 'f';
+    return put_number(out, unsigned(*ptr));
+  case Kind::ADDRESS:
+    return put_number(put(out, "0x"), read_operand<uint32_t>(ptr), 16);
+  case Kind::U8:
+    return put_number(put(out, "$"), unsigned(*ptr));
+  case Kind::U16:
+    return put_number(put(out, "$"), read_operand<uint16_t>(ptr));
+  case Kind::U32:
+    return put_number(put(out, "$"), read_operand<uint32_t>(ptr));
+  case Kind::I8:
+    return put_number(put(out, "$"), int(read_operand<int8_t>(ptr)));
+  case Kind::I16:
+    return put_number(put(out, "$"), read_operand<int16_t>(ptr));
+  case Kind::I32:
+    return put_number(put(out, "$"), read_operand<int32_t>(ptr));
+  case Kind::FLOAT:
+    return put_float(put(out, "$"), read_operand<float>(ptr));
+  }
+  return out;
+}
+
+} // namespace
+
+Disassembler::Disassembler(Sink sink, size_t buffer_size)
+    : m_sink(std::move(sink)),
+      m_buffer(std::max(buffer_size, 2 * MAX_LINE_SIZE), '\0') {}
+
+Disassembler::~Disassembler() { flush(); }
+
+void Disassembler::flush() {
+  if (m_used > 0) {
+    m_sink(std::string_view(m_buffer.data(), m_used));
+    m_used = 0;
+  }
+}
+
+char *Disassembler::begin_line(uint32_t address) {
+  if (m_buffer.size() - m_used < MAX_LINE_SIZE) {
+    flush();
+  }
+  char *out = m_buffer.data() + m_used;
+
+  if (!m_hits.empty()) {
+    constexpr size_t width = 10;
+    uint64_t hits = address < m_hits.size() ? m_hits[address] : 0;
+    char digits[24];
+    size_t length = hits ? put_number(digits, hits) - digits : 0;
+
+    std::memset(out, ' ', width - std::min(width, length));
+    out += width - std::min(width, length);
+    out = put(out, std::string_view(digits, length));
+    out = put(out, "  ");
+  }
+
+  return put(put_address(out, address), "  ");
+}
+
+void Disassembler::end_line(char *end) {
+  *end++ = '\n';
+  m_used = end - m_buffer.data();
+}
+
+void Disassembler::disassemble(std::span<const uint8_t> code, uint32_t base) {
+  size_t offset = 0;
+
+  while (offset < code.size()) {
+    const uint8_t *instruction = code.data() + offset;
+    size_t left = code.size() - offset;
+    uint32_t address = base + offset;
+
+    if (*instruction == 0) {
+      size_t run = 1;
+      while (run < left && instruction[run] == 0) {
+        run++;
+      }
+      if (run >= MIN_ZERO_RUN) {
+        char *out = put(begin_line(address), "; ");
+        out = put(put_number(out, run), " zero bytes");
+        end_line(out);
+        offset += run;
+        continue;
+      }
+    }
+
+    uint8_t length = VM::instruction_lengths[*instruction];
+    char *out = begin_line(address);
+
+    if (length == 0 || length > left) {
+      end_line(put_number(put(out, ".byte $"), unsigned(*instruction)));
+      offset++;
+      continue;
+    }
+
+    const auto &info = VM::instruction_info[*instruction];
+    out = put(out, info.keyword);
+    for (uint8_t i = 0; i < info.operand_count; i++) {
+      out = put(out, i == 0 ? " " : ", ");
+      out = put_operand(out, info.operands[i], instruction + info.offsets[i]);
+    }
+    end_line(out);
+    offset += length;
+  }
+}
@@ -0,0 +1,129 @@
+#include <interp/disassembler.hxx>
+#include <interp/numeric.hxx>
+#include <interp/trace.hxx>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+// NOTE: disassemble [--base <address>] [--hits <trace>] <image>
+// Lists a raw image (as written by the assembler) loaded at the base address,
+// 0 by default. With a binary trace (see trace.hxx) every line is annotated
+// with how many times its instruction was executed.
+
+bool write_all(int fd, std::string_view text) {
+  while (!text.empty()) {
+    ssize_t written = ::write(fd, text.data(), text.size());
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      return false;
+    }
+    text.remove_prefix(written);
+  }
+  return true;
+}
+
+bool count_hits(const char *path, std::vector<uint64_t> &hits) {
+  std::ifstream in(path, std::ios::binary);
+  TraceFileHeader expected;
+  TraceFileHeader header;
+  in.read(reinterpret_cast<char *>(&header), sizeof(header));
+
+  if (!in || std::memcmp(header.magic, expected.magic, sizeof(header.magic)) ||
+      header.version != expected.version ||
+      header.record_size != expected.record_size) {
+    return false;
+  }
+
+  std::vector<TraceRecord> records(4096);
+  while (in) {
+    in.read(reinterpret_cast<char *>(records.data()),
+            records.size() * sizeof(TraceRecord));
+    size_t count = in.gcount() / sizeof(TraceRecord);
+    for (size_t i = 0; i < count; i++) {
+      if (records[i].pc < hits.size()) {
+        hits[records[i].pc]++;
+      }
+    }
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  uint32_t base = 0;
+  const char *trace_path = nullptr;
+  const char *image_path = nullptr;
+
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--base") == 0 && i + 1 < argc) {
+      const char *arg = argv[++i];
+      const char *last = arg + std::strlen(arg);
+      int64_t value = 0;
+      auto result = numeric::parse_integer(arg, last, value);
+      if (!result.ok() || result.end != last || value < 0 ||
+          value > UINT32_MAX) {
+        std::cerr << "Invalid base address: " << arg << std::endl;
+        return 1;
+      }
+      base = value;
+    } else if (std::strcmp(argv[i], "--hits") == 0 && i + 1 < argc) {
+      trace_path = argv[++i];
+    } else {
+      image_path = argv[i];
+    }
+  }
+
+  if (!image_path) {
+    std::cerr << argv[0] << ": [--base <address>] [--hits <trace>] <image>"
+              << std::endl;
+    return 1;
+  }
+
+  int fd = open(image_path, O_RDONLY);
+  struct stat status;
+  if (fd < 0 || fstat(fd, &status) != 0) {
+    std::cerr << "Failed to open image: " << image_path << std::endl;
+    return 1;
+  }
+
+  size_t size = status.st_size;
+  const uint8_t *image = nullptr;
+  if (size > 0) {
+    void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+      std::cerr << "Failed to map image: " << image_path << std::endl;
+      return 1;
+    }
+    madvise(map, size, MADV_SEQUENTIAL);
+    image = static_cast<const uint8_t *>(map);
+  }
+  close(fd);
+
+  std::vector<uint64_t> hits;
+  if (trace_path) {
+    hits.resize(uint64_t(base) + size);
+    if (!count_hits(trace_path, hits)) {
+      std::cerr << "Not a trace file or unsupported version: " << trace_path
+                << std::endl;
+      return 1;
+    }
+  }
+
+  bool failed = false;
+  {
+    Disassembler disassembler([&](std::string_view text) {
+      failed = failed || !write_all(STDOUT_FILENO, text);
+    });
+    disassembler.set_hit_counts(hits);
+    disassembler.disassemble({image, size}, base);
+  }
+
+  return failed ? 1 : 0;
+}
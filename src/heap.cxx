@@ -0,0 +1,243 @@
+#include <interp/heap.hxx>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+GuestHeap::GuestHeap(uint32_t lower_limit, uint32_t upper_limit)
+    : m_lower_limit(lower_limit),
+      m_page_count(std::min((upper_limit - lower_limit) / PAGE_SIZE,
+                            MAX_PAGE_COUNT)),
+      m_allocated(m_page_count * PAGE_SIZE / MIN_BLOCK_SIZE),
+      m_requested(m_page_count * PAGE_SIZE / MIN_BLOCK_SIZE) {
+  reset();
+}
+
+uint32_t GuestHeap::size_class(uint32_t size) {
+  return std::bit_width(std::max(size, MIN_BLOCK_SIZE) - 1) -
+         std::bit_width(MIN_BLOCK_SIZE - 1);
+}
+
+void GuestHeap::reset() {
+  m_free_page_mask =
+      m_page_count == 64 ? ~uint64_t(0) : (uint64_t(1) << m_page_count) - 1;
+  m_page_kind.fill(FREE_PAGE);
+  m_run_pages.fill(0);
+  m_live_blocks.fill(0);
+
+  for (auto &blocks : m_page_free_blocks) {
+    blocks.clear();
+  }
+  m_class_pages.fill(NO_PAGE);
+
+  std::fill(m_allocated.begin(), m_allocated.end(), false);
+
+  auto high_water = m_stats.high_water;
+  m_stats = Stats{};
+  m_stats.high_water = high_water;
+}
+
+uint32_t GuestHeap::allocate_pages(uint32_t count) {
+  uint64_t run_mask =
+      count == 64 ? ~uint64_t(0) : (uint64_t(1) << count) - 1;
+
+  for (uint32_t first = std::countr_zero(m_free_page_mask);
+       first + count <= m_page_count; first++) {
+    if ((m_free_page_mask >> first & run_mask) == run_mask) {
+      m_free_page_mask &= ~(run_mask << first);
+      return m_lower_limit + first * PAGE_SIZE;
+    }
+  }
+
+  return 0;
+}
+
+void GuestHeap::release_pages(uint32_t first_page, uint32_t count) {
+  for (uint32_t p = first_page; p < first_page + count; p++) {
+    m_page_kind[p] = FREE_PAGE;
+    m_free_page_mask |= uint64_t(1) << p;
+  }
+  m_run_pages[first_page] = 0;
+}
+
+// NOTE: A page is linked while it has free blocks, at the front of its size
+// class.
+void GuestHeap::link_page(uint32_t page) {
+  uint8_t &first = m_class_pages[m_page_kind[page]];
+  m_prev_page[page] = NO_PAGE;
+  m_next_page[page] = first;
+  if (first != NO_PAGE) {
+    m_prev_page[first] = page;
+  }
+  first = page;
+}
+
+void GuestHeap::unlink_page(uint32_t page) {
+  if (m_prev_page[page] != NO_PAGE) {
+    m_next_page[m_prev_page[page]] = m_next_page[page];
+  } else {
+    m_class_pages[m_page_kind[page]] = m_next_page[page];
+  }
+  if (m_next_page[page] != NO_PAGE) {
+    m_prev_page[m_next_page[page]] = m_prev_page[page];
+  }
+}
+
+// NOTE: The blocks are pushed in reverse so the lowest address is handed out
+// first.
+bool GuestHeap::refill(uint32_t size_class) {
+  uint32_t page_address = allocate_pages(1);
+  if (!page_address) {
+    return false;
+  }
+
+  uint32_t p = page(page_address);
+  m_page_kind[p] = size_class;
+
+  auto &blocks = m_page_free_blocks[p];
+  uint32_t block_size = class_size(size_class);
+  for (uint32_t offset = PAGE_SIZE; offset > 0; offset -= block_size) {
+    blocks.push_back(page_address + offset - block_size);
+  }
+  m_stats.free_block_bytes += PAGE_SIZE;
+  link_page(p);
+
+  return true;
+}
+
+uint32_t GuestHeap::allocate(uint32_t size) {
+  if (size == 0 || size > m_page_count * PAGE_SIZE) {
+    return 0;
+  }
+
+  uint32_t address;
+  uint32_t capacity;
+
+  if (size <= PAGE_SIZE) {
+    uint32_t cls = size_class(size);
+    if (m_class_pages[cls] == NO_PAGE && !refill(cls)) {
+      return 0;
+    }
+
+    uint32_t p = m_class_pages[cls];
+    auto &blocks = m_page_free_blocks[p];
+    address = blocks.back();
+    blocks.pop_back();
+    if (blocks.empty()) {
+      unlink_page(p);
+    }
+    capacity = class_size(cls);
+    m_stats.free_block_bytes -= capacity;
+    m_live_blocks[p]++;
+  } else {
+    uint32_t pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    address = allocate_pages(pages);
+    if (!address) {
+      return 0;
+    }
+
+    uint32_t first_page = page(address);
+    m_page_kind[first_page] = LARGE_RUN;
+    m_run_pages[first_page] = pages;
+    for (uint32_t p = first_page + 1; p < first_page + pages; p++) {
+      m_page_kind[p] = LARGE_RUN_TAIL;
+    }
+    capacity = pages * PAGE_SIZE;
+  }
+
+  m_allocated[granule(address)] = true;
+  m_requested[granule(address)] = size;
+
+  m_stats.bytes_in_use += capacity;
+  m_stats.bytes_requested += size;
+  m_stats.live_blocks++;
+  m_stats.high_water = std::max(m_stats.high_water, m_stats.bytes_in_use);
+
+  return address;
+}
+
+uint32_t GuestHeap::block_capacity(uint32_t address) const {
+  if (address < m_lower_limit ||
+      address >= m_lower_limit + m_page_count * PAGE_SIZE ||
+      (address - m_lower_limit) % MIN_BLOCK_SIZE != 0 ||
+      !m_allocated[granule(address)]) {
+    return 0;
+  }
+
+  uint8_t kind = m_page_kind[page(address)];
+  return kind == LARGE_RUN ? m_run_pages[page(address)] * PAGE_SIZE
+                           : class_size(kind);
+}
+
+void GuestHeap::free(uint32_t address) {
+  uint32_t capacity = block_capacity(address);
+  if (!capacity) {
+    return;
+  }
+
+  m_allocated[granule(address)] = false;
+  m_stats.bytes_in_use -= capacity;
+  m_stats.bytes_requested -= m_requested[granule(address)];
+  m_stats.live_blocks--;
+
+  uint32_t first_page = page(address);
+  if (m_page_kind[first_page] == LARGE_RUN) {
+    release_pages(first_page, m_run_pages[first_page]);
+  } else if (--m_live_blocks[first_page] > 0) {
+    auto &blocks = m_page_free_blocks[first_page];
+    if (blocks.empty()) {
+      link_page(first_page);
+    }
+    blocks.push_back(address);
+    m_stats.free_block_bytes += capacity;
+  } else {
+    // NOTE: Every other block of the page is in its free list already.
+    auto &blocks = m_page_free_blocks[first_page];
+    if (!blocks.empty()) {
+      unlink_page(first_page);
+      blocks.clear();
+    }
+    m_stats.free_block_bytes -= PAGE_SIZE - capacity;
+    release_pages(first_page, 1);
+  }
+}
+
+uint32_t GuestHeap::reallocate(uint8_t *memory, uint32_t address,
+                               uint32_t size) {
+  if (!address) {
+    return allocate(size);
+  }
+
+  uint32_t capacity = block_capacity(address);
+  if (!capacity) {
+    return 0;
+  }
+
+  if (size == 0) {
+    free(address);
+    return 0;
+  }
+
+  uint16_t &requested = m_requested[granule(address)];
+
+  if (size <= capacity) {
+    m_stats.bytes_requested += size - requested;
+    requested = size;
+    return address;
+  }
+
+  uint32_t new_address = allocate(size);
+  if (!new_address) {
+    return 0;
+  }
+
+  std::memcpy(memory + new_address, memory + address, requested);
+  free(address);
+
+  return new_address;
+}
+
+GuestHeap::Stats GuestHeap::stats() const {
+  Stats stats = m_stats;
+  stats.free_pages = std::popcount(m_free_page_mask);
+  return stats;
+}
@@ -1,13 +1,23 @@
 #include <interp/interpreter.hxx>
 #include <interp/instructions.hxx>
+#include <interp/metrics.hxx>
+#include <interp/optimizer.hxx>
+#include <interp/perf_counters.hxx>
 #include <boost/format.hpp>
 #include <boost/limits.hpp>
 #include <boost/numeric/conversion/converter.hpp>
+#include <algorithm>
+#include <bit>
 #include <climits>
+#include <cerrno>
 #include <cmath>
+#include <cstring>
+#include <dlfcn.h>
+#include <limits>
+#include <unistd.h>
 
-#define DEBUG_EXTRA_INFO
-
+// NOTE: DEBUG_EXTRA_INFO is defined by the build (TEXT_TRACE option), for
+// post-mortems in production use the binary trace instead, see trace.hxx.
 #ifdef DEBUG_EXTRA_INFO
 #define DBG(whatever) whatever
 #else // DEBUG_EXTRA_INFO
@@ -23,6 +33,8 @@
   "(R" << (int)reg << " = " << interp.m_mb.fl_regs_32[reg] << ")"
 
 #define PC_REG interp.m_mb.gp_regs_32[MemoryBank::PROGRAM_COUNTER_REG]
+#define SP_REG interp.m_mb.gp_regs_32[MemoryBank::STACK_PTR_REG]
+#define FP_REG interp.m_mb.gp_regs_32[MemoryBank::FRAME_PTR_REG]
 
 #define VM_MEMORY(addr) interp.m_mb.memory[addr]
 
@@ -45,9 +57,68 @@ void Interpreter::load_program(BytecodeBuffer &buffer) {
 
   // Load the program to address 0
   std::copy(begin(buffer), end(buffer), begin(m_mb.memory));
+  if (!buffer.empty()) {
+    m_mb.code_map.note_store(0, buffer.size());
+  }
+}
+
+void Interpreter::load_native(const std::string &path) {
+  void *handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+
+  if (!handle) {
+    throw std::runtime_error(
+        (boost::format("Failed to load native program: %1%") % dlerror())
+            .str());
+  }
+
+  auto entry =
+      reinterpret_cast<NativeEntry>(dlsym(handle, "interp_aot_entry"));
+
+  if (!entry) {
+    throw std::runtime_error(
+        (boost::format("Not a native program: %1%") % path).str());
+  }
+
+  // NOTE: The native code is only valid as long as the image it was
+  // translated from is intact.
+  auto code_size =
+      reinterpret_cast<const uint32_t *>(dlsym(handle, "interp_aot_code_size"));
+  if (code_size) {
+    m_mb.code_map.mark_code(0, *code_size);
+  }
+
+  m_native_entry = entry;
+}
+
+void Interpreter::patch_code(MemPtr address, const BytecodeBuffer &code) {
+  if (uint64_t(address) + code.size() > m_mb.memory.size()) {
+    throw std::runtime_error(
+        (boost::format("Patch does not fit in VM memory!(address: %1%, size: "
+                       "%2%)") %
+         address % code.size())
+            .str());
+  }
+  if (code.empty()) {
+    return;
+  }
+
+  std::copy(code.begin(), code.end(), m_mb.memory.begin() + address);
+  m_mb.code_map.note_store(address, code.size());
+}
+
+void Interpreter::redirect_function(MemPtr entry, MemPtr replacement) {
+  BytecodeBuffer jump{VM::OpCodes::JUMP};
+  for (uint32_t i = 0; i < sizeof(MemPtr); i++) {
+    jump.push_back((replacement >> (8 * i)) & 0xff);
+  }
+  patch_code(entry, jump);
 }
 
-void Interpreter::run() {
+Interpreter::RunStatus Interpreter::run() {
+  return run_for(std::numeric_limits<uint64_t>::max());
+}
+
+Interpreter::RunStatus Interpreter::run_for(uint64_t budget) {
   // NOTE: We can copy all the instruction into a local buffer and exit, as the
   // interpreter can run on a seperate thread.
   //
@@ -62,16 +133,380 @@ void Interpreter::run() {
   auto &pc = GP_REG(MemoryBank::PROGRAM_COUNTER_REG);
   auto &mem = m_mb.memory;
 
-  try {
-    while (pc < mem.size()) {
-      VM::run_next_instruction(*this);
+  if (m_waiting_for_io) {
+    return RunStatus::WAITING_FOR_IO;
+  }
+
+  // NOTE: charge_block counts the budget down to 0, an empty budget would
+  // wrap around and run unbounded.
+  if (budget == 0) {
+    return RunStatus::PREEMPTED;
+  }
+
+  // Resume where the previous slice was preempted.
+  if (m_preempted) {
+    m_preempted = false;
+    m_is_running = true;
+  }
+
+  m_trapped = false;
+  m_slices++;
+
+  if (!m_metrics) {
+    m_budget = budget;
+    m_slice_budget = budget;
+    run_loop<false>();
+  } else {
+    m_slice_start = Clock::now();
+    VmMetrics::store(m_metrics->layout().state, MetricsLayout::RUNNING);
+
+    // NOTE: The budget is handed to the loop METRICS_INTERVAL units at a time.
+    // Running out of a part stops the loop like a preemption, the metrics are
+    // published and the loop resumes with the next part, so the loops never
+    // check whether it's time to publish.
+    uint64_t left = budget;
+    for (;;) {
+      m_budget = std::min(left, METRICS_INTERVAL);
+      m_slice_budget = m_budget;
+      left -= m_budget;
+      m_instructions += run_loop<true>();
+      m_blocks += m_slice_budget - m_budget;
+
+      if (!m_preempted || m_trapped || m_waiting_for_io || left == 0) {
+        break;
+      }
+      publish_metrics();
+      m_preempted = false;
+      m_is_running = true;
+    }
+    m_budget += left;
+    m_slice_budget = m_budget;
+  }
+
+  RunStatus status;
+  if (m_trapped) {
+    status = RunStatus::TRAPPED;
+  } else if (m_preempted) {
+    status = RunStatus::PREEMPTED;
+  } else if (m_waiting_for_io) {
+    status = RunStatus::WAITING_FOR_IO;
+  } else {
+    status = pc < mem.size() ? RunStatus::HALTED : RunStatus::END_OF_MEMORY;
+  }
+
+  if (m_metrics) {
+    publish_metrics();
+    m_run_time += Clock::now() - m_slice_start;
+    VmMetrics::store(m_metrics->layout().state, static_cast<uint64_t>(status));
+  }
+  m_blocks += m_slice_budget - m_budget;
+  m_slice_budget = m_budget;
+
+  return status;
+}
+
+template <bool COUNTED> uint64_t Interpreter::run_loop() {
+  if (m_tier && !m_trace) {
+    return run_tiered<COUNTED>();
+  }
+  if (m_perf) {
+    return run_instrumented<COUNTED>();
+  }
+  return run_plain<COUNTED>();
+}
+
+template <bool COUNTED> uint64_t Interpreter::run_plain() {
+  auto &interp = *this;
+  auto &pc = GP_REG(MemoryBank::PROGRAM_COUNTER_REG);
+  auto &mem = m_mb.memory;
+  uint64_t executed = 0;
+
+  while (m_is_running && pc < mem.size()) {
+    if (m_native_entry) {
+      uint32_t entered_at = pc;
+      uint64_t native = m_native_entry(*this);
+      if constexpr (COUNTED) {
+        executed += native;
+      }
+
+      if (!m_is_running || pc != entered_at) {
+        continue;
+      }
+    }
+
+    uint32_t instruction_pc = pc;
+    if (Trap trap = VM::run_next_instruction(*this); trap != Trap::NONE)
+        [[unlikely]] {
+      deliver_trap(trap, instruction_pc);
+    }
+    if constexpr (COUNTED) {
+      executed++;
+    }
+  }
+  return executed;
+}
+
+// NOTE: Without marks every slice is counted from start to end. Once the
+// guest marked a region only the regions are, a region left open at the end
+// of a slice keeps counting until the next slice closes it.
+template <bool COUNTED> uint64_t Interpreter::run_instrumented() {
+  auto &interp = *this;
+  auto &pc = GP_REG(MemoryBank::PROGRAM_COUNTER_REG);
+  auto &mem = m_mb.memory;
+  bool whole_run = !m_perf->has_marks();
+  uint64_t executed = 0;
+
+  if (whole_run) {
+    m_perf->start();
+  }
+
+  while (m_is_running && pc < mem.size()) {
+    if (m_native_entry) {
+      uint32_t entered_at = pc;
+      m_perf->count_native_entry();
+      uint64_t native = m_native_entry(*this);
+      m_perf->count_compiled(native);
+      if constexpr (COUNTED) {
+        executed += native;
+      }
+
+      if (!m_is_running || pc != entered_at) {
+        continue;
+      }
+    }
+
+    m_perf->count_dispatch();
+    uint32_t instruction_pc = pc;
+    if (Trap trap = VM::run_next_instruction(*this); trap != Trap::NONE)
+        [[unlikely]] {
+      deliver_trap(trap, instruction_pc);
+    }
+    if constexpr (COUNTED) {
+      executed++;
+    }
+  }
+
+  if (whole_run) {
+    m_perf->stop();
+  }
+  return executed;
+}
+
+// NOTE: The only way out of the execution loop on an error. The instruction
+// left the state as it was before it ran, with a handler installed for the
+// trap the guest continues in the handler with the address of the faulting
+// instruction pushed, otherwise the machine stops and the host can inspect
+// last_trap(). A vector is used once, the handler installs it again when it
+// is ready for the next trap, so a fault inside of the handler stops the
+// machine instead of looping.
+[[gnu::cold]] void Interpreter::deliver_trap(Trap trap, MemPtr pc) {
+  m_trap_state = {trap, pc,
+                  m_fault_address != NO_FAULT_ADDRESS ? m_fault_address : pc};
+  m_fault_address = NO_FAULT_ADDRESS;
+
+  m_traps++;
+  if (m_metrics) {
+    VmMetrics::store(m_metrics->layout().traps, m_traps);
+  }
+
+  auto &interp = *this;
+  MemPtr handler = m_trap_vectors[static_cast<uint8_t>(trap)];
+
+  if (handler != NO_TRAP_VECTOR && trap != Trap::NOT_RUNNING &&
+      m_mb.reserve_stack(sizeof(MemPtr)) == Trap::NONE) {
+    m_trap_vectors[static_cast<uint8_t>(trap)] = NO_TRAP_VECTOR;
+    m_mb.push_stack_word(pc);
+    GP_REG(MemoryBank::PROGRAM_COUNTER_REG) = handler;
+    charge_block();
+    return;
+  }
+
+  // NOTE: Decoding moved the program counter past the instruction, point it
+  // back so resuming runs the faulting instruction again.
+  GP_REG(MemoryBank::PROGRAM_COUNTER_REG) = pc;
+  m_is_running = false;
+  m_trapped = true;
+}
+
+[[gnu::cold]] void Interpreter::publish_metrics() {
+  if (!m_metrics) {
+    return;
+  }
+
+  auto &layout = m_metrics->layout();
+  auto heap = m_heap.stats();
+  m_stack_low = std::min(m_stack_low, m_mb.stack_low);
+  auto run_time = m_run_time + (Clock::now() - m_slice_start);
+
+  VmMetrics::store(layout.instructions, m_instructions);
+  VmMetrics::store(layout.blocks, m_blocks);
+  VmMetrics::store(layout.slices, m_slices);
+  VmMetrics::store(layout.traps, m_traps);
+  VmMetrics::store(
+      layout.run_nanoseconds,
+      std::chrono::duration_cast<std::chrono::nanoseconds>(run_time).count());
+  VmMetrics::store(layout.stack_high_water,
+                   MemoryBank::STACK_UPPER_LIMIT - m_stack_low);
+  VmMetrics::store(layout.heap_bytes_in_use, heap.bytes_in_use);
+  VmMetrics::store(layout.heap_high_water, heap.high_water);
+  VmMetrics::store(layout.publications,
+                   layout.publications.load(std::memory_order_relaxed) + 1);
+}
+
+const char *trap_name(Trap trap) {
+  switch (trap) {
+  case Trap::NONE:
+    return "NONE";
+  case Trap::INVALID_INSTRUCTION:
+    return "INVALID_INSTRUCTION";
+  case Trap::INVALID_REGISTER:
+    return "INVALID_REGISTER";
+  case Trap::INVALID_ADDRESS:
+    return "INVALID_ADDRESS";
+  case Trap::INVALID_OPERAND:
+    return "INVALID_OPERAND";
+  case Trap::DIVIDE_BY_ZERO:
+    return "DIVIDE_BY_ZERO";
+  case Trap::STACK_OVERFLOW:
+    return "STACK_OVERFLOW";
+  case Trap::STACK_UNDERFLOW:
+    return "STACK_UNDERFLOW";
+  case Trap::NOT_RUNNING:
+    return "NOT_RUNNING";
+  default:
+    return "UNKNOWN";
+  }
+}
+
+// NOTE: Every control transfer charges the budget, so the instruction after
+// one that changed it is a block head. With performance counters attached
+// the instructions of a block are counted as compiled ones, the marks are
+// never part of a block and still open and close the regions.
+template <bool COUNTED> uint64_t Interpreter::run_tiered() {
+  auto &interp = *this;
+  auto &pc = GP_REG(MemoryBank::PROGRAM_COUNTER_REG);
+  auto &mem = m_mb.memory;
+  bool block_head = true;
+  bool whole_run = m_perf && !m_perf->has_marks();
+  uint64_t executed = 0;
+
+  if (whole_run) {
+    m_perf->start();
+  }
+
+  while (m_is_running && pc < mem.size()) {
+    if (m_native_entry) {
+      uint32_t entered_at = pc;
+      uint64_t native = m_native_entry(*this);
+      if (m_perf) {
+        m_perf->count_native_entry();
+        m_perf->count_compiled(native);
+      }
+      if constexpr (COUNTED) {
+        executed += native;
+      }
+
+      if (!m_is_running || pc != entered_at) {
+        block_head = true;
+        continue;
+      }
+    }
+
+    uint64_t budget = m_budget;
+    const auto *block = block_head ? m_tier->enter(pc) : nullptr;
+
+    if (block) {
+      uint64_t instructions =
+          block->guest_instructions * m_tier->execute(*block);
+      if constexpr (COUNTED) {
+        executed += instructions;
+      }
+      if (m_perf) {
+        m_perf->count_compiled(instructions);
+      }
+    } else {
+      if (m_perf) {
+        m_perf->count_dispatch();
+      }
+      uint32_t instruction_pc = pc;
+      if (Trap trap = VM::run_next_instruction(*this); trap != Trap::NONE)
+          [[unlikely]] {
+        deliver_trap(trap, instruction_pc);
+      }
+      if constexpr (COUNTED) {
+        executed++;
+      }
+    }
+
+    block_head = m_budget != budget;
+  }
+
+  if (whole_run) {
+    m_perf->stop();
+  }
+  return executed;
+}
+
+Interpreter::RunStatus Interpreter::run_until(Clock::time_point deadline) {
+  RunStatus status;
+
+  do {
+    status = run_for(DEADLINE_CHECK_INTERVAL);
+  } while (status == RunStatus::PREEMPTED && Clock::now() < deadline);
+
+  return status;
+}
+
+uint32_t Interpreter::attach_handle(int fd) {
+  m_io_handles.push_back(fd);
+  return m_io_handles.size() - 1;
+}
+
+int Interpreter::handle_to_fd(uint32_t handle) const {
+  return handle < m_io_handles.size() ? m_io_handles[handle] : -1;
+}
+
+int32_t Interpreter::perform_io(const IoRequest &request) {
+  if (request.fd < 0) {
+    return -EBADF;
+  }
+
+  if (request.buffer >= m_mb.memory.size()) {
+    return -EFAULT;
+  }
+
+  // NOTE: Transfers that would run past the end of memory are truncated.
+  size_t length = std::min<size_t>(request.length,
+                                   m_mb.memory.size() - request.buffer);
+  ssize_t res;
+
+  switch (request.kind) {
+  case IoRequest::READ:
+    res = ::read(request.fd, &m_mb.memory[request.buffer], length);
+    if (res > 0) {
+      m_mb.code_map.note_store(request.buffer, res);
     }
-  } catch (std::runtime_error re) {
-    std::cerr << "An fatal error has occured during runtime of the "
-      "interpreter.\nRUNTIME_ERROR: "
-              << re.what() << std::endl;
+    break;
+  case IoRequest::WRITE:
+    res = ::write(request.fd, &m_mb.memory[request.buffer], length);
+    break;
   }
+
+  return res < 0 ? -errno : static_cast<int32_t>(res);
+}
+
+void Interpreter::suspend_for_io(const IoRequest &request) {
+  m_pending_io = request;
+  m_waiting_for_io = true;
+  m_is_running = false;
+}
+
+void Interpreter::complete_io(int32_t result) {
+  m_mb.gp_regs_32[m_pending_io.destination] = result;
+  m_waiting_for_io = false;
+  m_is_running = true;
 }
+
 using Interpreter = Interpreter;
 
 // NOTE: Don't implement everything in the MemoryBank because than we
@@ -91,305 +526,557 @@ using Interpreter = Interpreter;
 template <uint8_t T> using PL = VM::parameters::ParameterList<T>;
 using OP = VM::OpCodes;
 
-void VM::callbacks::invalid_cb(Interpreter &interp, const PL<OP::INVALID> &) {
-  throw std::runtime_error("Invalid instruction encountered!");
+// NOTE: Whether [address, address + size) lies inside of the guest memory.
+static bool in_memory(MemPtr address, uint32_t size) {
+  return uint64_t(address) + size <= MemoryBank::MEMORY_SIZE;
 }
-void VM::callbacks::nop_cb(Interpreter &interp, const PL<OP::NOP> &) {}
 
-void VM::callbacks::push_cb(Interpreter &interp, const PL<OP::PUSH_STACK> &p) {
-  interp.m_mb.push_register_to_stack(p.source);
+// NOTE: Memory operands are checked before the instruction changes anything,
+// a trapped instruction can simply be run again.
+#define CHECK_ADDRESS(address, size)                                           \
+  if (!in_memory(address, size)) [[unlikely]] {                                \
+    return interp.fault(Trap::INVALID_ADDRESS, address);                       \
+  }
+
+#define CHECK_TRAP(expression)                                                 \
+  if (Trap trap = expression; trap != Trap::NONE) [[unlikely]] {               \
+    return trap;                                                               \
+  }
+
+Trap VM::callbacks::invalid_cb(Interpreter &interp, const PL<OP::INVALID> &) {
+  return Trap::INVALID_INSTRUCTION;
+}
+Trap VM::callbacks::nop_cb(Interpreter &interp, const PL<OP::NOP> &) {
+  return Trap::NONE;
+}
+
+Trap VM::callbacks::push_cb(Interpreter &interp, const PL<OP::PUSH_STACK> &p) {
+  return interp.m_mb.push_register_to_stack(p.source);
 }
 
-void VM::callbacks::pushf_cb(Interpreter &interp,
+Trap VM::callbacks::pushf_cb(Interpreter &interp,
                              const PL<OP::PUSH_FLOAT_STACK> &p) {
-  interp.m_mb.push_float_register_to_stack(p.source);
+  return interp.m_mb.push_float_register_to_stack(p.source);
 }
 
-void VM::callbacks::pop_cb(Interpreter &interp, const PL<OP::POP_STACK> &p) {
-  interp.m_mb.pop_register_from_stack(p.destination);
+Trap VM::callbacks::pop_cb(Interpreter &interp, const PL<OP::POP_STACK> &p) {
+  return interp.m_mb.pop_register_from_stack(p.destination);
 }
 
-void VM::callbacks::popf_cb(Interpreter &interp,
+Trap VM::callbacks::popf_cb(Interpreter &interp,
                             const PL<OP::POP_FLOAT_STACK> &p) {
-  interp.m_mb.pop_float_register_from_stack(p.destination);
+  return interp.m_mb.pop_float_register_from_stack(p.destination);
 }
 
-void VM::callbacks::ld_cb(Interpreter &interp, const PL<OP::LOAD> &p) {
+Trap VM::callbacks::ld_cb(Interpreter &interp, const PL<OP::LOAD> &p) {
+  CHECK_ADDRESS(p.source, sizeof(uint32_t));
   GP_REG(p.destination) = *reinterpret_cast<uint32_t *>(&VM_MEMORY(p.source));
+  return Trap::NONE;
 }
 
-void VM::callbacks::lb_cb(Interpreter &interp, const PL<OP::LOAD_BYTE> &p) {
+Trap VM::callbacks::lb_cb(Interpreter &interp, const PL<OP::LOAD_BYTE> &p) {
+  CHECK_ADDRESS(p.source, 1);
   GP_REG(p.destination) = *reinterpret_cast<uint8_t *>(&VM_MEMORY(p.source));
+  return Trap::NONE;
 }
 
-void VM::callbacks::lhw_cb(Interpreter &interp,
+Trap VM::callbacks::lhw_cb(Interpreter &interp,
                            const PL<OP::LOAD_HALF_WORD> &p) {
+  CHECK_ADDRESS(p.source, sizeof(uint16_t));
   GP_REG(p.destination) = *reinterpret_cast<uint16_t *>(&VM_MEMORY(p.source));
+  return Trap::NONE;
 }
 
-void VM::callbacks::ldi_cb(Interpreter &interp,
+Trap VM::callbacks::ldi_cb(Interpreter &interp,
                            const PL<OP::LOAD_IMMEDIATE> &p) {
   DBG(std::clog << "Loading immediate value (" << p.immediate_value
             << ") into register " << GP_REG_INFO(p.destination) << std::endl);
   GP_REG(p.destination) = p.immediate_value;
+  return Trap::NONE;
 }
 
-void VM::callbacks::lbi_cb(Interpreter &interp,
+Trap VM::callbacks::lbi_cb(Interpreter &interp,
                            const PL<OP::LOAD_BYTE_IMMEDIATE> &p) {
   GP_REG(p.destination) = p.immediate_value;
+  return Trap::NONE;
 }
 
-void VM::callbacks::lhwi_cb(Interpreter &interp,
+Trap VM::callbacks::lhwi_cb(Interpreter &interp,
                             const PL<OP::LOAD_HALF_WORD_IMMEDIATE> &p) {
   GP_REG(p.destination) = p.immediate_value;
+  return Trap::NONE;
 }
 
-void VM::callbacks::lf_cb(Interpreter &interp, const PL<OP::LOAD_FLOAT> &p) {
+Trap VM::callbacks::lf_cb(Interpreter &interp, const PL<OP::LOAD_FLOAT> &p) {
+  CHECK_ADDRESS(p.source, 1);
   FL_REG(p.destination) = VM_MEMORY(p.source);
+  return Trap::NONE;
 }
 
-void VM::callbacks::lfi_cb(Interpreter &interp,
+Trap VM::callbacks::lfi_cb(Interpreter &interp,
                            const PL<OP::LOAD_FLOAT_IMMEDIATE> &p) {
   FL_REG(p.destination) = p.immediate_value;
+  return Trap::NONE;
 }
 
-void VM::callbacks::st_cb(Interpreter &interp, const PL<OP::STORE> &p) {
-  GP_REG(p.destination) = GP_REG(p.source);
+Trap VM::callbacks::st_cb(Interpreter &interp, const PL<OP::STORE> &p) {
+  CHECK_ADDRESS(p.destination, sizeof(uint32_t));
+  std::memcpy(&VM_MEMORY(p.destination), &GP_REG(p.source), sizeof(uint32_t));
+  interp.m_mb.code_map.note_store(p.destination, sizeof(uint32_t));
+  return Trap::NONE;
 }
 
-void VM::callbacks::sb_cb(Interpreter &interp, const PL<OP::STORE_BYTE> &p) {
+Trap VM::callbacks::sb_cb(Interpreter &interp, const PL<OP::STORE_BYTE> &p) {
+  CHECK_ADDRESS(p.destination, 1);
   VM_MEMORY(p.destination) = static_cast<uint8_t>(GP_REG(p.source) & 0xff);
+  interp.m_mb.code_map.note_store(p.destination, 1);
+  return Trap::NONE;
 }
 
-void VM::callbacks::shw_cb(Interpreter &interp,
+Trap VM::callbacks::shw_cb(Interpreter &interp,
                            const PL<OP::STORE_HALF_WORD> &p) {
+  CHECK_ADDRESS(p.destination, 1);
   VM_MEMORY(p.destination) = static_cast<uint16_t>(GP_REG(p.source) & 0xffff);
+  interp.m_mb.code_map.note_store(p.destination, 1);
+  return Trap::NONE;
 }
 
-void VM::callbacks::sf_cb(Interpreter &interp, const PL<OP::STORE_FLOAT> &p) {
+Trap VM::callbacks::sf_cb(Interpreter &interp, const PL<OP::STORE_FLOAT> &p) {
+  CHECK_ADDRESS(p.destination, 1);
   VM_MEMORY(p.destination) = FL_REG(p.source);
+  interp.m_mb.code_map.note_store(p.destination, 1);
+  return Trap::NONE;
 }
 
-void VM::callbacks::sll_cb(Interpreter &interp, const PL<OP::SHIFT_LEFT> &p) {
+Trap VM::callbacks::sll_cb(Interpreter &interp, const PL<OP::SHIFT_LEFT> &p) {
   GP_REG(p.destination) = GP_REG(p.source) << GP_REG(p.shift_by);
+  return Trap::NONE;
 }
 
-void VM::callbacks::srl_cb(Interpreter &interp, const PL<OP::SHIFT_RIGHT> &p) {
+Trap VM::callbacks::srl_cb(Interpreter &interp, const PL<OP::SHIFT_RIGHT> &p) {
   GP_REG(p.destination) = GP_REG(p.source) >> GP_REG(p.shift_by);
+  return Trap::NONE;
 }
 
-void VM::callbacks::slli_cb(Interpreter &interp,
+Trap VM::callbacks::slli_cb(Interpreter &interp,
                             const PL<OP::SHIFT_IMMEDIATE_LEFT> &p) {
   GP_REG(p.destination) = GP_REG(p.source) << p.shift_by;
+  return Trap::NONE;
 }
 
-void VM::callbacks::srli_cb(Interpreter &interp,
+Trap VM::callbacks::srli_cb(Interpreter &interp,
                             const PL<OP::SHIFT_IMMEDIATE_RIGHT> &p) {
   GP_REG(p.destination) = GP_REG(p.source) >> p.shift_by;
+  return Trap::NONE;
 }
 
-void VM::callbacks::or_cb(Interpreter &interp, const PL<OP::OR> &p) {
+Trap VM::callbacks::or_cb(Interpreter &interp, const PL<OP::OR> &p) {
   GP_REG(p.destination) = GP_REG(p.source1) | GP_REG(p.source2);
+  return Trap::NONE;
 }
 
-void VM::callbacks::and_cb(Interpreter &interp, const PL<OP::AND> &p) {
+Trap VM::callbacks::and_cb(Interpreter &interp, const PL<OP::AND> &p) {
   GP_REG(p.destination) = GP_REG(p.source1) & GP_REG(p.source2);
+  return Trap::NONE;
 }
 
-void VM::callbacks::xor_cb(Interpreter &interp, const PL<OP::XOR> &p) {
+Trap VM::callbacks::xor_cb(Interpreter &interp, const PL<OP::XOR> &p) {
   GP_REG(p.destination) = GP_REG(p.source1) ^ GP_REG(p.source2);
+  return Trap::NONE;
 }
 
-void VM::callbacks::nor_cb(Interpreter &interp, const PL<OP::NOR> &p) {
+Trap VM::callbacks::nor_cb(Interpreter &interp, const PL<OP::NOR> &p) {
   GP_REG(p.destination) = !(GP_REG(p.source1) | GP_REG(p.source2));
+  return Trap::NONE;
 }
 
-void VM::callbacks::nand_cb(Interpreter &interp, const PL<OP::NAND> &p) {
+Trap VM::callbacks::nand_cb(Interpreter &interp, const PL<OP::NAND> &p) {
   GP_REG(p.destination) = !(GP_REG(p.source1) & GP_REG(p.source2));
+  return Trap::NONE;
 }
 
-void VM::callbacks::ori_cb(Interpreter &interp, const PL<OP::OR_IMMEDIATE> &p) {
+Trap VM::callbacks::ori_cb(Interpreter &interp, const PL<OP::OR_IMMEDIATE> &p) {
   GP_REG(p.destination) = GP_REG(p.source1) | p.immediate_value;
+  return Trap::NONE;
 }
 
-void VM::callbacks::andi_cb(Interpreter &interp, const PL<OP::AND_IMMEDIATE> &p) {
+Trap VM::callbacks::andi_cb(Interpreter &interp, const PL<OP::AND_IMMEDIATE> &p) {
   GP_REG(p.destination) = GP_REG(p.source1) & p.immediate_value;
+  return Trap::NONE;
 }
 
-void VM::callbacks::xori_cb(Interpreter &interp, const PL<OP::XOR_IMMEDIATE> &p) {
+Trap VM::callbacks::xori_cb(Interpreter &interp, const PL<OP::XOR_IMMEDIATE> &p) {
   GP_REG(p.destination) = GP_REG(p.source1) ^ p.immediate_value;
+  return Trap::NONE;
 }
 
-void VM::callbacks::nori_cb(Interpreter &interp, const PL<OP::NOR_IMMEDIATE> &p) {
+Trap VM::callbacks::nori_cb(Interpreter &interp, const PL<OP::NOR_IMMEDIATE> &p) {
   GP_REG(p.destination) = ~(GP_REG(p.source1) | p.immediate_value);
+  return Trap::NONE;
 }
 
-void VM::callbacks::nandi_cb(Interpreter &interp, const PL<OP::NAND_IMMEDIATE> &p) {
+Trap VM::callbacks::nandi_cb(Interpreter &interp, const PL<OP::NAND_IMMEDIATE> &p) {
   GP_REG(p.destination) = ~(GP_REG(p.source1) & p.immediate_value);
+  return Trap::NONE;
 }
 
-void VM::callbacks::add_cb(Interpreter &interp, const PL<OP::ADD_INT> &p) {
+Trap VM::callbacks::add_cb(Interpreter &interp, const PL<OP::ADD_INT> &p) {
   GP_REG(p.destination) = GP_REG(p.source1) + GP_REG(p.source2);
+  return Trap::NONE;
 }
 
-void VM::callbacks::addi_cb(Interpreter &interp,
+Trap VM::callbacks::addi_cb(Interpreter &interp,
                             const PL<OP::ADD_INT_IMMEDIATE> &p) {
   DBG(std::clog << "Adding immediate value(" << p.immediate_value
             << ") to a gp register " << GP_REG_INFO(p.source)
             << " and storing result in gp register "
             << GP_REG_INFO(p.destination) << "\n");
   GP_REG(p.destination) = GP_REG(p.source) + p.immediate_value;
+  return Trap::NONE;
 }
 
-void VM::callbacks::sub_cb(Interpreter &interp, const PL<OP::SUB_INT> &p) {
+Trap VM::callbacks::sub_cb(Interpreter &interp, const PL<OP::SUB_INT> &p) {
   GP_REG(p.destination) = GP_REG(p.source1) - GP_REG(p.source2);
+  return Trap::NONE;
 }
 
-void VM::callbacks::subi_cb(Interpreter &interp,
+Trap VM::callbacks::subi_cb(Interpreter &interp,
                             const PL<OP::SUB_INT_IMMEDIATE> &p) {
   GP_REG(p.destination) = GP_REG(p.source) - p.immediate_value;
+  return Trap::NONE;
 }
 
-void VM::callbacks::mult_cb(Interpreter &interp, const PL<OP::MULT_INT> &p) {
+Trap VM::callbacks::mult_cb(Interpreter &interp, const PL<OP::MULT_INT> &p) {
   GP_REG(p.destination) = GP_REG(p.source1) * GP_REG(p.source2);
+  return Trap::NONE;
 }
 
-void VM::callbacks::muli_cb(Interpreter &interp,
+Trap VM::callbacks::muli_cb(Interpreter &interp,
                             const PL<OP::MULT_INT_IMMEDIATE> &p) {
   GP_REG(p.destination) = GP_REG(p.source) * p.immediate_value;
+  return Trap::NONE;
 }
 
-void VM::callbacks::div_cb(Interpreter &interp, const PL<OP::DIV_INT> &p) {
+Trap VM::callbacks::div_cb(Interpreter &interp, const PL<OP::DIV_INT> &p) {
+  if (GP_REG(p.source2) == 0) [[unlikely]] {
+    return Trap::DIVIDE_BY_ZERO;
+  }
   GP_REG(p.destination) = GP_REG(p.source1) / GP_REG(p.source2);
+  return Trap::NONE;
 }
 
-void VM::callbacks::divi_cb(Interpreter &interp,
+Trap VM::callbacks::divi_cb(Interpreter &interp,
                             const PL<OP::DIV_INT_IMMEDIATE> &p) {
+  if (p.immediate_value == 0) [[unlikely]] {
+    return Trap::DIVIDE_BY_ZERO;
+  }
   GP_REG(p.destination) = GP_REG(p.source) / p.immediate_value;
+  return Trap::NONE;
 }
 
-void VM::callbacks::addf_cb(Interpreter &interp, const PL<OP::ADD_FLOAT> &p) {
+Trap VM::callbacks::addf_cb(Interpreter &interp, const PL<OP::ADD_FLOAT> &p) {
   FL_REG(p.destination) = FL_REG(p.source1) + FL_REG(p.source2);
+  return Trap::NONE;
 }
 
-void VM::callbacks::addif_cb(Interpreter &interp,
+Trap VM::callbacks::addif_cb(Interpreter &interp,
                              const PL<OP::ADD_FLOAT_IMMEDIATE> &p) {
   FL_REG(p.destination) = FL_REG(p.source) + p.immediate_value;
+  return Trap::NONE;
 }
 
-void VM::callbacks::subf_cb(Interpreter &interp, const PL<OP::SUB_FLOAT> &p) {
+Trap VM::callbacks::subf_cb(Interpreter &interp, const PL<OP::SUB_FLOAT> &p) {
   FL_REG(p.destination) = FL_REG(p.source1) - FL_REG(p.source2);
+  return Trap::NONE;
 }
 
-void VM::callbacks::subif_cb(Interpreter &interp,
+Trap VM::callbacks::subif_cb(Interpreter &interp,
                              const PL<OP::SUB_FLOAT_IMMEDIATE> &p) {
   FL_REG(p.destination) = FL_REG(p.source) - p.immediate_value;
+  return Trap::NONE;
 }
 
-void VM::callbacks::mulf_cb(Interpreter &interp, const PL<OP::MULT_FLOAT> &p) {
+Trap VM::callbacks::mulf_cb(Interpreter &interp, const PL<OP::MULT_FLOAT> &p) {
   FL_REG(p.destination) = FL_REG(p.source1) * FL_REG(p.source2);
+  return Trap::NONE;
 }
 
-void VM::callbacks::mulif_cb(Interpreter &interp,
+Trap VM::callbacks::mulif_cb(Interpreter &interp,
                              const PL<OP::MULT_FLOAT_IMMEDIATE> &p) {
   FL_REG(p.destination) = FL_REG(p.source) * p.immediate_value;
+  return Trap::NONE;
 }
 
-void VM::callbacks::divf_cb(Interpreter &interp, const PL<OP::DIV_FLOAT> &p) {
+Trap VM::callbacks::divf_cb(Interpreter &interp, const PL<OP::DIV_FLOAT> &p) {
   DBG(std::clog << "Dividing two float registers " << FL_REG_INFO(p.source1)
             << " and " << FL_REG_INFO(p.source2) << "\n");
   FL_REG(p.destination) = FL_REG(p.source1) / FL_REG(p.source2);
+  return Trap::NONE;
 }
 
-void VM::callbacks::divif_cb(Interpreter &interp,
+Trap VM::callbacks::divif_cb(Interpreter &interp,
                              const PL<OP::DIV_FLOAT_IMMEDIATE> &p) {
   DBG(std::clog << "Dividing float register with float immediate (R" << p.source
             << " = " << FL_REG(p.source) << ") and " << p.immediate_value
             << "\n.");
   DBG(std::clog << "Destination register R" << p.destination << ".\n");
   FL_REG(p.destination) = FL_REG(p.source) / p.immediate_value;
+  return Trap::NONE;
 }
 
-void VM::callbacks::jmp_cb(Interpreter &interp, const PL<OP::JUMP> &p) {
-  check_mem_address_with_throw(p.jump_address);
+Trap VM::callbacks::jmp_cb(Interpreter &interp, const PL<OP::JUMP> &p) {
+  CHECK_ADDRESS(p.jump_address, 1);
   DBG(std::clog << "Jumping to immediate value address (" << p.jump_address
             << ")\n");
   PC_REG = p.jump_address;
+  interp.charge_block();
+  return Trap::NONE;
 }
 
 // NOTE: Jump zero is the same thing as jump equal because the comparison uses
 // subtraction to compare two values and if the result is zero that means the
 // values are equal.
-void VM::callbacks::jz_cb(Interpreter &interp, const PL<OP::JUMP_ZERO> &p) {
+Trap VM::callbacks::jz_cb(Interpreter &interp, const PL<OP::JUMP_ZERO> &p) {
 
   DBG(std::clog << "Jump zero to address " << p.jump_address << "\n");
 
   if (CHECK_FLAG(ZERO_FLAG_BIT)) {
-    jmp_cb(interp, {p.jump_address});
+    return jmp_cb(interp, {p.jump_address});
   }
+  return Trap::NONE;
 }
 
-void VM::callbacks::jzr_cb(Interpreter &interp,
+Trap VM::callbacks::jzr_cb(Interpreter &interp,
                            const PL<OP::JUMP_REGISTER_ZERO> &p) {
-  jz_cb(interp, {GP_REG(p.jump_register)});
+  return jz_cb(interp, {GP_REG(p.jump_register)});
 }
 
-void VM::callbacks::je_cb(Interpreter &interp, const PL<OP::JUMP_EQUAL> &p) {
+Trap VM::callbacks::je_cb(Interpreter &interp, const PL<OP::JUMP_EQUAL> &p) {
   if (CHECK_FLAG(ZERO_FLAG_BIT)) {
-    jmp_cb(interp, {p.jump_address});
+    return jmp_cb(interp, {p.jump_address});
   }
+  return Trap::NONE;
 }
 
-void VM::callbacks::jer_cb(Interpreter &interp,
+Trap VM::callbacks::jer_cb(Interpreter &interp,
                            const PL<OP::JUMP_REGISTER_EQUAL> &p) {
-  je_cb(interp, {GP_REG(p.jump_register)});
+  return je_cb(interp, {GP_REG(p.jump_register)});
 }
 
-void VM::callbacks::jlt_cb(Interpreter &interp,
+Trap VM::callbacks::jlt_cb(Interpreter &interp,
                            const PL<OP::JUMP_LESS_THAN> &p) {
   if (!CHECK_FLAG(ZERO_FLAG_BIT) || !CHECK_FLAG(SIGN_FLAG_BIT)) {
-    jmp_cb(interp, {p.jump_address});
+    return jmp_cb(interp, {p.jump_address});
   }
+  return Trap::NONE;
 }
 
-void VM::callbacks::jltr_cb(Interpreter &interp,
+Trap VM::callbacks::jltr_cb(Interpreter &interp,
                             const PL<OP::JUMP_REGISTER_LESS_THAN> &p) {
-  jlt_cb(interp, {GP_REG(p.jump_register)});
+  return jlt_cb(interp, {GP_REG(p.jump_register)});
 }
 
-void VM::callbacks::jgt_cb(Interpreter &interp,
+Trap VM::callbacks::jgt_cb(Interpreter &interp,
                            const PL<OP::JUMP_GREATER_THAN> &p) {
   if (!CHECK_FLAG(ZERO_FLAG_BIT) && CHECK_FLAG(SIGN_FLAG_BIT)) {
-    jmp_cb(interp, {p.jump_address});
+    return jmp_cb(interp, {p.jump_address});
   }
+  return Trap::NONE;
 }
 
-void VM::callbacks::jgtr_cb(Interpreter &interp,
+Trap VM::callbacks::jgtr_cb(Interpreter &interp,
                             const PL<OP::JUMP_REGISTER_GREATER_THAN> &p) {
-  jgt_cb(interp, {GP_REG(p.jump_register)});
+  return jgt_cb(interp, {GP_REG(p.jump_register)});
 }
 
 // NOTE: In order to load jump to instruction we need to copy the instructions
 // into memory first.
 
-void VM::callbacks::jmpr_cb(Interpreter &interp,
+Trap VM::callbacks::jmpr_cb(Interpreter &interp,
                             const PL<OP::JUMP_REGISTER> &p) {
-  check_mem_address_with_throw(GP_REG(p.jump_register));
+  CHECK_ADDRESS(GP_REG(p.jump_register), 1);
   DBG(std::clog << "Jumping to address stored in register (R" << p.jump_register
             << " = " << GP_REG(p.jump_register) << ").\n");
   PC_REG = GP_REG(p.jump_register);
+  interp.charge_block();
+  return Trap::NONE;
 }
 
-void VM::callbacks::halt_cb(Interpreter &interp, const PL<OP::HALT> &) {
+Trap VM::callbacks::halt_cb(Interpreter &interp, const PL<OP::HALT> &) {
   DBG(std::clog << "Halting the machine.\n");
   interp.stop();
+  return Trap::NONE;
+}
+
+// NOTE: Call pushes the address of the next instruction as a single word and
+// keeps a copy of it on the interpreter's return stack. The stack limit is
+// checked once for the whole frame instead of once per byte.
+Trap VM::callbacks::call_cb(Interpreter &interp, const PL<OP::CALL> &p) {
+  CHECK_ADDRESS(p.jump_address, 1);
+  DBG(std::clog << "Calling subroutine at address (" << p.jump_address
+            << ")\n");
+  CHECK_TRAP(interp.m_mb.reserve_stack(sizeof(MemPtr)));
+  interp.m_mb.push_stack_word(PC_REG);
+  interp.push_return_address(PC_REG);
+  PC_REG = p.jump_address;
+  interp.charge_block();
+  return Trap::NONE;
+}
+
+Trap VM::callbacks::callr_cb(Interpreter &interp,
+                             const PL<OP::CALL_REGISTER> &p) {
+  return call_cb(interp, {GP_REG(p.jump_register)});
+}
+
+Trap VM::callbacks::ret_cb(Interpreter &interp, const PL<OP::RETURN> &) {
+  CHECK_TRAP(interp.m_mb.release_stack(sizeof(MemPtr)));
+  PC_REG = interp.pop_return_address(interp.m_mb.pop_stack_word());
+  interp.charge_block();
+  DBG(std::clog << "Returning to address (" << PC_REG << ")\n");
+  return Trap::NONE;
+}
+
+// NOTE: Enter saves the caller's frame pointer and allocates frame_size bytes
+// of locals below it, leave tears the frame down again.
+Trap VM::callbacks::enter_cb(Interpreter &interp, const PL<OP::ENTER> &p) {
+  CHECK_TRAP(interp.m_mb.reserve_stack(sizeof(uint32_t) + p.frame_size));
+  interp.m_mb.push_stack_word(FP_REG);
+  FP_REG = SP_REG;
+  SP_REG -= p.frame_size;
+  return Trap::NONE;
+}
+
+Trap VM::callbacks::leave_cb(Interpreter &interp, const PL<OP::LEAVE> &) {
+  if (uint64_t(FP_REG) + sizeof(uint32_t) > MemoryBank::STACK_UPPER_LIMIT)
+      [[unlikely]] {
+    return Trap::STACK_UNDERFLOW;
+  }
+  SP_REG = FP_REG;
+  FP_REG = interp.m_mb.pop_stack_word();
+  return Trap::NONE;
+}
+
+// NOTE: Registers are pushed in ascending order and popped in descending
+// order so the same mask restores what was saved. The stack pointer and the
+// registers above it are not general purpose, popping them would let the
+// guest move the stack pointer past the limits checked for the frame.
+Trap VM::callbacks::pushm_cb(Interpreter &interp,
+                             const PL<OP::PUSH_MULTIPLE_STACK> &p) {
+  if (p.register_mask >> MemoryBank::STACK_PTR_REG) [[unlikely]] {
+    return Trap::INVALID_OPERAND;
+  }
+  CHECK_TRAP(interp.m_mb.reserve_stack(std::popcount(p.register_mask) *
+                                       sizeof(uint32_t)));
+  for (RegID r = 0; r < MemoryBank::GP_REGS_32_COUNT; r++) {
+    if (p.register_mask & (1u << r)) {
+      interp.m_mb.push_stack_word(GP_REG(r));
+    }
+  }
+  return Trap::NONE;
+}
+
+Trap VM::callbacks::popm_cb(Interpreter &interp,
+                            const PL<OP::POP_MULTIPLE_STACK> &p) {
+  if (p.register_mask >> MemoryBank::STACK_PTR_REG) [[unlikely]] {
+    return Trap::INVALID_OPERAND;
+  }
+  CHECK_TRAP(interp.m_mb.release_stack(std::popcount(p.register_mask) *
+                                       sizeof(uint32_t)));
+  for (RegID r = MemoryBank::GP_REGS_32_COUNT; r-- > 0;) {
+    if (p.register_mask & (1u << r)) {
+      GP_REG(r) = interp.m_mb.pop_stack_word();
+    }
+  }
+  return Trap::NONE;
+}
+
+// NOTE: The number of bytes transferred (or a negative errno value) is
+// written to the destination register once the request completes.
+template <typename Params>
+static void io_instruction(Interpreter &interp,
+                           Interpreter::IoRequest::Kind kind, const Params &p) {
+  Interpreter::IoRequest request{kind, interp.handle_to_fd(GP_REG(p.handle)),
+                                 GP_REG(p.buffer), GP_REG(p.length),
+                                 p.destination};
+
+  if (interp.is_async_io()) {
+    interp.suspend_for_io(request);
+  } else {
+    GP_REG(p.destination) = interp.perform_io(request);
+  }
+}
+
+Trap VM::callbacks::ioread_cb(Interpreter &interp, const PL<OP::IO_READ> &p) {
+  io_instruction(interp, Interpreter::IoRequest::READ, p);
+  return Trap::NONE;
+}
+
+Trap VM::callbacks::iowrite_cb(Interpreter &interp, const PL<OP::IO_WRITE> &p) {
+  io_instruction(interp, Interpreter::IoRequest::WRITE, p);
+  return Trap::NONE;
+}
+
+// NOTE: Failed allocations return the address 0, which is never part of the
+// heap.
+Trap VM::callbacks::alloc_cb(Interpreter &interp, const PL<OP::ALLOCATE> &p) {
+  GP_REG(p.destination) = interp.m_heap.allocate(GP_REG(p.size));
+  return Trap::NONE;
+}
+
+Trap VM::callbacks::free_cb(Interpreter &interp, const PL<OP::FREE> &p) {
+  interp.m_heap.free(GP_REG(p.address));
+  return Trap::NONE;
+}
+
+Trap VM::callbacks::realloc_cb(Interpreter &interp,
+                               const PL<OP::REALLOCATE> &p) {
+  GP_REG(p.destination) = interp.m_heap.reallocate(
+      interp.m_mb.memory.data(), GP_REG(p.address), GP_REG(p.size));
+  if (GP_REG(p.destination) && GP_REG(p.size)) {
+    interp.m_mb.code_map.note_store(GP_REG(p.destination), GP_REG(p.size));
+  }
+  return Trap::NONE;
+}
+
+Trap VM::callbacks::hreset_cb(Interpreter &interp, const PL<OP::HEAP_RESET> &) {
+  interp.m_heap.reset();
+  return Trap::NONE;
+}
+
+// NOTE: Without counters attached the marks are ignored, the same program runs
+// with and without instrumentation.
+Trap VM::callbacks::perfm_cb(Interpreter &interp, const PL<OP::PERF_MARK> &p) {
+  if (p.action > PerfCounters::END_REGION) {
+    return Trap::INVALID_OPERAND;
+  }
+  if (interp.m_perf) {
+    interp.m_perf->mark(static_cast<PerfCounters::MarkAction>(p.action));
+  }
+  return Trap::NONE;
+}
+
+Trap VM::callbacks::trapv_cb(Interpreter &interp,
+                             const PL<OP::TRAP_VECTOR> &p) {
+  if (p.trap == 0 || p.trap >= static_cast<uint8_t>(Trap::COUNT)) {
+    return Trap::INVALID_OPERAND;
+  }
+  CHECK_ADDRESS(p.handler, 1);
+  interp.set_trap_vector(static_cast<Trap>(p.trap), p.handler);
+  return Trap::NONE;
+}
+
+// NOTE: The faulting address of the last trap, for handlers.
+Trap VM::callbacks::trapa_cb(Interpreter &interp,
+                             const PL<OP::TRAP_ADDRESS> &p) {
+  GP_REG(p.destination) = interp.last_trap().address;
+  return Trap::NONE;
 }
 
 // NOTE: Jump zero is the same thing as jump equal because the comparison uses
 // subtraction to compare two values and if the result is zero that means the
 // values are equal.
 
-void VM::callbacks::cmp_cb(Interpreter &interp, const PL<OP::COMPARE> &p) {
+Trap VM::callbacks::cmp_cb(Interpreter &interp, const PL<OP::COMPARE> &p) {
 
   // FUN_FACT: When I first implemented this, instead of using the comparison
   // operator I tried to implement it in terms of how CPU's compare numbers in
@@ -421,9 +1108,10 @@ void VM::callbacks::cmp_cb(Interpreter &interp, const PL<OP::COMPARE> &p) {
     interp.m_mb.unset_flag(MemoryBank::ZERO_FLAG_BIT);
     interp.m_mb.unset_flag(MemoryBank::SIGN_FLAG_BIT);
   }
+  return Trap::NONE;
 }
 
-void VM::callbacks::cmpf_cb(Interpreter &interp,
+Trap VM::callbacks::cmpf_cb(Interpreter &interp,
                             const PL<OP::COMPARE_FLOAT> &p) {
   float v1 = FL_REG(p.register1);
   float v2 = FL_REG(p.register2);
@@ -444,61 +1132,30 @@ void VM::callbacks::cmpf_cb(Interpreter &interp,
     interp.m_mb.unset_flag(MemoryBank::ZERO_FLAG_BIT);
     interp.m_mb.unset_flag(MemoryBank::SIGN_FLAG_BIT);
   }
+  return Trap::NONE;
 }
 
-void check_bytes_ahead(MemoryBank::MemoryBuffer &buffer, size_t index,
-                       size_t count) {
-  if (index < 0 && index + count > buffer.size()) {
-    throw std::runtime_error(
-        (boost::format("MemoryBank::MemoryBuffer does not have %1% bytes "
-                       "ahead(index: %2%).") %
-         count % index)
-            .str());
-  }
-}
-
+// NOTE: The generated parser checks the operands fit into the memory and
+// that register ids are in range before reading them, see
+// generate_bounds_check in enum_instructions.py.
 RegID read_valid_regid(MemoryBank::MemoryBuffer &buffer, uint32_t &pc) {
-  uint8_t rid = buffer[pc];
-
-  if (rid < 0 && rid > MemoryBank::GP_REGS_32_COUNT) {
-    throw std::runtime_error(
-        (boost::format("Invalid Register ID: %1%") % rid).str());
-  }
-  return rid;
+  return buffer[pc];
 }
 
 RegID read_valid_float_regid(MemoryBank::MemoryBuffer &buffer, uint32_t &pc) {
-  uint8_t rid = buffer[pc];
-
-  if (rid < 0 && rid > MemoryBank::FL_REGS_32_COUNT) {
-    throw std::runtime_error(
-        (boost::format("Invalid Float Register ID: %1%") % rid).str());
-  }
-  return rid;
+  return buffer[pc];
 }
 
 MemPtr read_valid_mem_address(MemoryBank::MemoryBuffer &buffer, uint32_t &pc) {
-  check_bytes_ahead(buffer, pc, sizeof(MemPtr));
-  auto mem_ptr = *reinterpret_cast<MemPtr *>(&buffer[pc]);
+  MemPtr mem_ptr;
+  std::memcpy(&mem_ptr, &buffer[pc], sizeof(MemPtr));
   DBG(std::clog << "Reading Memory Address: " << mem_ptr << std::endl);
   return mem_ptr;
 }
 
-// FIXME: Use concepts to restrict the type to integers
-
 float read_valid_float_immediate_val(MemoryBank::MemoryBuffer &buffer,
                                      uint32_t &pc) {
-  check_bytes_ahead(buffer, pc, 4);
-  auto res = *reinterpret_cast<float *>(&buffer[pc]);
-
+  float res;
+  std::memcpy(&res, &buffer[pc], sizeof(float));
   return res;
 }
-
-MemPtr check_mem_address_with_throw(MemPtr mem_ptr) {
-  if (mem_ptr < 0 && mem_ptr > MemoryBank::MEMORY_SIZE) {
-    throw std::runtime_error(
-        (boost::format("Invalid Memory Address ID: %1%") % mem_ptr).str());
-  }
-
-  return mem_ptr;
-}
@@ -0,0 +1,110 @@
+#include <interp/io_loop.hxx>
+#include <array>
+#include <cerrno>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+IoLoop::IoLoop() : m_epoll_fd(epoll_create1(EPOLL_CLOEXEC)) {
+  if (m_epoll_fd < 0) {
+    throw std::runtime_error(
+        (boost::format("Failed to create epoll instance (errno: %1%)") % errno)
+            .str());
+  }
+}
+
+IoLoop::~IoLoop() { close(m_epoll_fd); }
+
+uint32_t IoLoop::attach_handle(VirtualMachine &vm, int fd) {
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  return vm.m_interp.attach_handle(fd);
+}
+
+void IoLoop::spawn(VirtualMachine &vm, FinishedCallback on_finished) {
+  vm.m_interp.set_async_io(true);
+  m_live_tasks++;
+  m_ready.push_back(drive(vm, std::move(on_finished)).handle);
+}
+
+IoLoop::Task IoLoop::drive(VirtualMachine &vm, FinishedCallback on_finished) {
+  auto &interp = vm.m_interp;
+
+  for (;;) {
+    auto status = interp.run_for(TIME_SLICE_BUDGET);
+
+    if (status == RunStatus::WAITING_FOR_IO) {
+      interp.complete_io(co_await Waiter{*this, interp, 0, {}});
+    } else if (status == RunStatus::PREEMPTED) {
+      co_await Yield{*this};
+    } else {
+      if (on_finished) {
+        on_finished(vm, status);
+      }
+      m_live_tasks--;
+      co_return;
+    }
+  }
+}
+
+void IoLoop::run() {
+  while (m_live_tasks > 0) {
+    while (!m_ready.empty()) {
+      auto handle = m_ready.front();
+      m_ready.pop_front();
+      handle.resume();
+    }
+
+    if (m_waiting > 0) {
+      wait_for_events();
+    }
+  }
+}
+
+// NOTE: The request is attempted right away, only when the descriptor is not
+// ready the machine is parked in epoll.
+bool IoLoop::Waiter::await_ready() {
+  result = interp.perform_io(interp.pending_io());
+  return result != -EAGAIN && result != -EWOULDBLOCK;
+}
+
+void IoLoop::Waiter::await_suspend(std::coroutine_handle<> h) {
+  handle = h;
+
+  epoll_event event{};
+  event.events = EPOLLONESHOT | (interp.pending_io().kind ==
+                                         Interpreter::IoRequest::READ
+                                     ? EPOLLIN
+                                     : EPOLLOUT);
+  event.data.ptr = this;
+
+  int fd = interp.pending_io().fd;
+  if (epoll_ctl(loop.m_epoll_fd, EPOLL_CTL_MOD, fd, &event) < 0 &&
+      epoll_ctl(loop.m_epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+    result = -errno;
+    loop.m_ready.push_back(h);
+    return;
+  }
+
+  loop.m_waiting++;
+}
+
+void IoLoop::wait_for_events() {
+  std::array<epoll_event, 64> events;
+
+  int count = epoll_wait(m_epoll_fd, events.data(), events.size(), -1);
+
+  for (int i = 0; i < count; i++) {
+    auto &waiter = *static_cast<Waiter *>(events[i].data.ptr);
+
+    if (!waiter.await_ready()) {
+      // Spurious wake up, park the machine again.
+      m_waiting--;
+      waiter.await_suspend(waiter.handle);
+      continue;
+    }
+
+    m_waiting--;
+    m_ready.push_back(waiter.handle);
+  }
+}
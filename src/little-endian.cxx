@@ -1,46 +1,36 @@
+#include <interp/numeric.hxx>
 #include <iostream>
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
-#include <cmath>
 
+// NOTE: Decimal conversion goes through numeric.hxx, anything that isn't a
+// number stops the tool.
 int32_t str_to_i32(const char* str) 
 {
-	bool negative = false;
-	if(*str == '-') {
-		negative = true;
-		str++;
-	}			
-
-	//std::cout << "FIRST CHAR: " << *str << std::endl;
-
 	int32_t num = 0;
-	size_t  len = strlen(str);
-	size_t	idx = 0;
-
-	while(*str != '\0') {
-		num += (*str - '0') * pow(10, (len-idx)-1);	
-		//std::cout << "dig: " << *str << ", len-idx: " << len-idx << ", pow(10, (len-idx)-1): " << pow(10, (len-idx)-1) << std::endl;
+	const char* last = str + strlen(str);
+	numeric::Result result = numeric::parse_i32(str, last, num);
 
-		idx++;
-		str++;
-	}	
+	if(!result.ok() || result.end != last) {
+		std::cerr << "Invalid signed number: " << str << std::endl;
+		exit(1);
+	}
 
-	return negative ? -num : num;
+	return num;
 }
 
 uint32_t str_to_u32(const char* str) 
 {
 	uint32_t num = 0;
-	size_t  len = strlen(str);
-	size_t	idx = 0;
-
-	while(*str != '\0') {
-		num += (*str - '0') * pow(10, (len-idx)-1);	
-		//std::cout << "dig: " << *str << ", len-idx: " << len-idx << ", pow(10, (len-idx)-1): " << pow(10, (len-idx)-1) << std::endl;
+	const char* last = str + strlen(str);
+	numeric::Result result = numeric::parse_u32(str, last, num);
 
-		idx++;
-		str++;
-	}	
+	if(!result.ok() || result.end != last) {
+		std::cerr << "Invalid unsigned number: " << str << std::endl;
+		exit(1);
+	}
 
 	return num;
 }
@@ -1,23 +1,29 @@
+#include <interp/disassembler.hxx>
 #include <interp/instructions.hxx>
 #include <interp/interpreter.hxx>
+#include <interp/optimizer.hxx>
 #include <interp/parse/parse.hxx>
 #include <interp/parse/syntax.hxx>
+#include <interp/perf_counters.hxx>
+#include <interp/trace.hxx>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
 #include <cstring>
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <list>
+#include <optional>
 #include <sstream>
 #include <string>
+#include <thread>
 
 /*/ NOTE: Instruction can be stored as a function pointers in an associative
 *** array and excecuted there after by indexing into the array
 *** and calling the function the pointer is pointing to.
 ***
-*** TODO: Write dissassebler to analyze memory contents better.
-***  When we analyze instructions in memory they are printed out as raw bytes,
-***  we need an dissasable to make it easier for us to analyze the code.
-***
 *** TODO: Implement BytecodeBuffer builder class.
 *** + We want code generator functions
 *** + It doen't neccerraly have to be a seperate class from BytecodeBuffer,
@@ -64,6 +70,9 @@
   (imm & 0x000000ff) >> 0, (imm & 0x0000ff00) >> 8, (imm & 0x00ff0000) >> 16,  \
       (imm & 0xff000000) << 24
 
+// NOTE: Records the drainer can fall behind by before the oldest are lost.
+constexpr size_t TRACE_CAPACITY = 1 << 16;
+
 int main(int argc, char **argv) {
   using OPC = VM::OpCodes;
 
@@ -95,9 +104,115 @@ int main(int argc, char **argv) {
     };
     // clang-format on
 
+    // NOTE: interp [--image <file>] [--native <so>] [--perf-json <file>]
+    // [--optimize] [--metrics <segment>] [--trace <file>], the flags combine.
+    // --image runs a raw image (as written by the assembler) instead of the
+    // built in program.
+    // --native loads the image translated by the aot tool.
+    // --perf-json measures the run with the host counters and writes the
+    // report for the benchmark scripts.
+    // --optimize runs the hot blocks in the optimizing tier.
+    // --metrics publishes the counters for vm_metrics.
+    // --trace writes the binary trace for trace_decode and disassemble
+    // --hits, drained by a second thread while the machine runs.
+    const char *image_path = nullptr;
+    const char *native_path = nullptr;
+    const char *perf_path = nullptr;
+    const char *trace_path = nullptr;
+    std::optional<PerfCounters> perf;
+    std::optional<OptimizingTier> tier;
+
+    for (int i = 1; i < argc; i++) {
+      if (std::strcmp(argv[i], "--image") == 0 && i + 1 < argc) {
+        image_path = argv[++i];
+      } else if (std::strcmp(argv[i], "--native") == 0 && i + 1 < argc) {
+        native_path = argv[++i];
+      } else if (std::strcmp(argv[i], "--perf-json") == 0 && i + 1 < argc) {
+        perf_path = argv[++i];
+        vm.m_interp.m_perf = &perf.emplace();
+      } else if (std::strcmp(argv[i], "--optimize") == 0) {
+        vm.m_interp.m_tier = &tier.emplace(vm.m_interp);
+      } else if (std::strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+        vm.export_metrics(argv[++i]);
+      } else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+        trace_path = argv[++i];
+      } else {
+        std::cerr << argv[0]
+                  << ": [--image <file>] [--native <so>] [--perf-json <file>] "
+                     "[--optimize] [--metrics <segment>] [--trace <file>]"
+                  << std::endl;
+        return 1;
+      }
+    }
+
+    if (image_path) {
+      std::ifstream image(image_path, std::ios::binary);
+      if (!image) {
+        throw std::runtime_error(
+            (boost::format("Failed to open image: %1%") % image_path).str());
+      }
+      bb.assign(std::istreambuf_iterator<char>(image),
+                std::istreambuf_iterator<char>());
+    }
+
+    std::optional<TraceBuffer> trace;
+    std::ofstream trace_file;
+    std::atomic<bool> tracing{false};
+    std::thread trace_drainer;
+    if (trace_path) {
+      trace_file.open(trace_path, std::ios::binary);
+      if (!trace_file) {
+        throw std::runtime_error(
+            (boost::format("Failed to open trace file: %1%") % trace_path)
+                .str());
+      }
+      TraceBuffer::write_header(trace_file);
+      vm.m_interp.m_trace = &trace.emplace(TRACE_CAPACITY);
+    }
+
     vm.m_interp.start();
     vm.m_interp.load_program(bb);
-    vm.m_interp.run();
+    if (native_path) {
+      vm.m_interp.load_native(native_path);
+    }
+
+    if (trace) {
+      tracing = true;
+      trace_drainer = std::thread([&]() {
+        while (tracing.load(std::memory_order_relaxed)) {
+          trace->drain(trace_file);
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+      });
+    }
+    auto status = vm.m_interp.run();
+
+    if (trace) {
+      tracing = false;
+      trace_drainer.join();
+      trace->drain(trace_file);
+      if (trace->dropped()) {
+        std::cerr << "Trace dropped " << trace->dropped() << " records"
+                  << std::endl;
+      }
+    }
+
+    if (status == Interpreter::RunStatus::TRAPPED) {
+      auto &trap = vm.m_interp.last_trap();
+      std::cout << "TRAP: " << trap_name(trap.trap) << " (pc: " << trap.pc
+                << ", address: " << trap.address << ")" << std::endl;
+
+      // NOTE: The program as it is in memory now, see disassembler.hxx.
+      Disassembler disassembler(
+          [](std::string_view text) { std::cout << text; });
+      disassembler.disassemble({vm.m_interp.m_mb.memory.data(), bb.size()},
+                               0);
+    }
+
+    if (perf) {
+      std::ofstream report(perf_path);
+      perf->write_json(report);
+    }
 
     vm.m_interp.m_mb.print_registers();
 
@@ -0,0 +1,98 @@
+#include <interp/interpreter.hxx>
+#include <interp/metrics.hxx>
+#include <boost/format.hpp>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using fmt = boost::format;
+using RunStatus = Interpreter::RunStatus;
+
+static_assert(MetricsLayout::HALTED == uint64_t(RunStatus::HALTED) &&
+              MetricsLayout::PREEMPTED == uint64_t(RunStatus::PREEMPTED) &&
+              MetricsLayout::WAITING_FOR_IO ==
+                  uint64_t(RunStatus::WAITING_FOR_IO) &&
+              MetricsLayout::END_OF_MEMORY ==
+                  uint64_t(RunStatus::END_OF_MEMORY) &&
+              MetricsLayout::TRAPPED == uint64_t(RunStatus::TRAPPED));
+
+VmMetrics::VmMetrics(const std::string &name) : m_name(name) {
+  int fd = shm_open(name.c_str(), O_CREAT | O_TRUNC | O_RDWR, 0644);
+  if (fd < 0) {
+    throw std::runtime_error(
+        (fmt("Could not create the metrics segment %1%: %2%") % name %
+         std::strerror(errno))
+            .str());
+  }
+
+  void *memory = MAP_FAILED;
+  if (ftruncate(fd, sizeof(MetricsLayout)) == 0) {
+    memory = mmap(nullptr, sizeof(MetricsLayout), PROT_READ | PROT_WRITE,
+                  MAP_SHARED, fd, 0);
+  }
+  int error = errno;
+  close(fd);
+
+  if (memory == MAP_FAILED) {
+    shm_unlink(name.c_str());
+    throw std::runtime_error(
+        (fmt("Could not map the metrics segment %1%: %2%") % name %
+         std::strerror(error))
+            .str());
+  }
+
+  m_layout = new (memory) MetricsLayout;
+  m_layout->pid = getpid();
+}
+
+VmMetrics::~VmMetrics() {
+  m_layout->~MetricsLayout();
+  munmap(m_layout, sizeof(MetricsLayout));
+  shm_unlink(m_name.c_str());
+}
+
+MetricsReader::MetricsReader(const std::string &name) {
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    throw std::runtime_error((fmt("Could not open the metrics segment %1%: %2%") %
+                              name % std::strerror(errno))
+                                 .str());
+  }
+
+  struct stat status;
+  void *memory = MAP_FAILED;
+  if (fstat(fd, &status) == 0 &&
+      size_t(status.st_size) >= sizeof(MetricsLayout)) {
+    m_size = status.st_size;
+    memory = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+
+  if (memory == MAP_FAILED) {
+    throw std::runtime_error(
+        (fmt("Not a metrics segment or written by an older version: %1%") %
+         name)
+            .str());
+  }
+
+  m_layout = static_cast<const MetricsLayout *>(memory);
+  MetricsLayout expected;
+  if (std::memcmp(m_layout->magic, expected.magic, sizeof(expected.magic)) ||
+      m_layout->version < expected.version ||
+      m_layout->size < sizeof(MetricsLayout)) {
+    munmap(memory, m_size);
+    throw std::runtime_error(
+        (fmt("Not a metrics segment or written by an older version: %1%") %
+         name)
+            .str());
+  }
+}
+
+MetricsReader::~MetricsReader() {
+  munmap(const_cast<MetricsLayout *>(m_layout), m_size);
+}
@@ -0,0 +1,96 @@
+#include <interp/metrics.hxx>
+#include <interp/numeric.hxx>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+// NOTE: vm_metrics <SEGMENT> [INTERVAL MS] [SAMPLES]
+// Samples the counters a machine publishes (see metrics.hxx), one line per
+// sample with the instruction rate since the previous one. Runs until it is
+// interrupted when no sample count is given.
+
+const char *state_name(uint64_t state) {
+  switch (state) {
+  case MetricsLayout::HALTED:
+    return "HALTED";
+  case MetricsLayout::PREEMPTED:
+    return "PREEMPTED";
+  case MetricsLayout::WAITING_FOR_IO:
+    return "WAITING_FOR_IO";
+  case MetricsLayout::END_OF_MEMORY:
+    return "END_OF_MEMORY";
+  case MetricsLayout::TRAPPED:
+    return "TRAPPED";
+  case MetricsLayout::RUNNING:
+    return "RUNNING";
+  case MetricsLayout::IDLE:
+    return "IDLE";
+  default:
+    return "???";
+  }
+}
+
+bool parse_argument(const char *arg, uint32_t &value) {
+  const char *last = arg + std::strlen(arg);
+  auto result = numeric::parse_u32(arg, last, value);
+  return result.ok() && result.end == last;
+}
+
+int main(int argc, char **argv) {
+  uint32_t interval_ms = 1000;
+  uint32_t samples = 0;
+
+  if (argc < 2 || (argc > 2 && !parse_argument(argv[2], interval_ms)) ||
+      (argc > 3 && !parse_argument(argv[3], samples))) {
+    std::cerr << argv[0] << ": <SEGMENT> [INTERVAL MS] [SAMPLES]" << std::endl;
+    return 1;
+  }
+
+  try {
+    MetricsReader reader(argv[1]);
+    auto &layout = reader.layout();
+    auto load = [](const std::atomic<uint64_t> &counter) {
+      return MetricsReader::load(counter);
+    };
+
+    std::cout << "pid " << layout.pid << ", layout version " << layout.version
+              << '\n'
+              << std::setw(15) << "state" << std::setw(16) << "instructions"
+              << std::setw(14) << "instr/s" << std::setw(14) << "blocks"
+              << std::setw(8) << "traps" << std::setw(12) << "run ms"
+              << std::setw(8) << "stack" << std::setw(8) << "heap"
+              << std::setw(8) << "heap hw" << std::endl;
+
+    uint64_t previous = load(layout.instructions);
+    auto previous_time = std::chrono::steady_clock::now();
+
+    for (uint32_t sample = 0; samples == 0 || sample < samples; sample++) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+
+      auto now = std::chrono::steady_clock::now();
+      uint64_t instructions = load(layout.instructions);
+      double seconds = std::chrono::duration<double>(now - previous_time).count();
+      double rate = seconds > 0 ? (instructions - previous) / seconds : 0;
+
+      std::cout << std::setw(15) << state_name(load(layout.state))
+                << std::setw(16) << instructions << std::setw(14)
+                << uint64_t(rate) << std::setw(14) << load(layout.blocks)
+                << std::setw(8) << load(layout.traps) << std::setw(12)
+                << load(layout.run_nanoseconds) / 1000000 << std::setw(8)
+                << load(layout.stack_high_water) << std::setw(8)
+                << load(layout.heap_bytes_in_use) << std::setw(8)
+                << load(layout.heap_high_water) << std::endl;
+
+      previous = instructions;
+      previous_time = now;
+    }
+  } catch (std::runtime_error &error) {
+    std::cerr << error.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,291 @@
+#include <interp/numeric.hxx>
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstring>
+
+namespace {
+
+using numeric::Result;
+using numeric::Status;
+
+// NOTE: The first character ends up in the lowest byte whatever the host's
+// byte order is.
+uint64_t load_word(const char *ptr) {
+  uint64_t word;
+  std::memcpy(&word, ptr, sizeof(word));
+  if constexpr (std::endian::native == std::endian::big) {
+    word = __builtin_bswap64(word);
+  }
+  return word;
+}
+
+// NOTE: A byte is a digit when neither adding 0x46 nor subtracting 0x30
+// carries into its top bit.
+bool is_eight_digits(uint64_t word) {
+  return (((word + 0x4646464646464646) | (word - 0x3030303030303030)) &
+          0x8080808080808080) == 0;
+}
+
+// NOTE: Combines neighbouring digits into 2, 4 and then 8 digit numbers,
+// every step is one multiplication over all the lanes.
+uint32_t eight_digits(uint64_t word) {
+  constexpr uint64_t mask = 0x000000ff000000ff;
+  constexpr uint64_t mul1 = 100 + (uint64_t(1000000) << 32);
+  constexpr uint64_t mul2 = 1 + (uint64_t(10000) << 32);
+
+  word -= 0x3030303030303030;
+  word = word * 10 + (word >> 8);
+  word = ((word & mask) * mul1 + ((word >> 16) & mask) * mul2) >> 32;
+  return static_cast<uint32_t>(word);
+}
+
+bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+int hex_digit(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  c |= 0x20; // Lower case.
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  return -1;
+}
+
+// NOTE: Up to eight digits are padded with leading zeros to a full word, the
+// literal is converted without a digit loop.
+bool parse_short(std::string_view digits, uint64_t &value) {
+  if (digits.empty() || digits.size() > 8) {
+    return false;
+  }
+  char buffer[8];
+  std::memset(buffer, '0', sizeof(buffer));
+  std::memcpy(buffer + sizeof(buffer) - digits.size(), digits.data(),
+              digits.size());
+
+  uint64_t word = load_word(buffer);
+  if (!is_eight_digits(word)) {
+    return false;
+  }
+  value = eight_digits(word);
+  return true;
+}
+
+Result apply_sign(Result result, uint64_t magnitude, bool negative,
+                  uint64_t max, int64_t &value) {
+  if (!result.ok()) {
+    return result;
+  }
+  if (magnitude > max + negative) {
+    return {result.end, Status::OUT_OF_RANGE};
+  }
+  value = negative ? static_cast<int64_t>(0 - magnitude)
+                   : static_cast<int64_t>(magnitude);
+  return result;
+}
+
+template <typename T>
+Result parse_floating(const char *first, const char *last, T &value) {
+  // NOTE: from_chars also takes "inf" and "nan", literals start with a
+  // digit or the decimal point.
+  const char *digits = first != last && *first == '-' ? first + 1 : first;
+  if (digits == last || (!is_digit(*digits) && *digits != '.')) {
+    return {first, Status::INVALID};
+  }
+
+  T parsed;
+  auto [end, error] = std::from_chars(first, last, parsed);
+  if (error == std::errc::invalid_argument) {
+    return {first, Status::INVALID};
+  }
+  if (error == std::errc::result_out_of_range) {
+    return {end, Status::OUT_OF_RANGE};
+  }
+  value = parsed;
+  return {end, Status::OK};
+}
+
+} // namespace
+
+namespace numeric {
+
+Result parse_decimal(const char *first, const char *last, uint64_t &value) {
+  const char *ptr = first;
+  uint64_t sum = 0;
+  bool overflow = false;
+
+  while (last - ptr >= 8) {
+    uint64_t word = load_word(ptr);
+    if (!is_eight_digits(word)) {
+      break;
+    }
+    overflow |= __builtin_mul_overflow(sum, 100000000, &sum);
+    overflow |= __builtin_add_overflow(sum, eight_digits(word), &sum);
+    ptr += 8;
+  }
+
+  while (ptr != last && is_digit(*ptr)) {
+    overflow |= __builtin_mul_overflow(sum, 10, &sum);
+    overflow |= __builtin_add_overflow(sum, *ptr - '0', &sum);
+    ptr++;
+  }
+
+  if (ptr == first) {
+    return {first, Status::INVALID};
+  }
+  if (overflow) {
+    return {ptr, Status::OUT_OF_RANGE};
+  }
+  value = sum;
+  return {ptr, Status::OK};
+}
+
+Result parse_hex(const char *first, const char *last, uint64_t &value) {
+  const char *ptr = first;
+  uint64_t sum = 0;
+  bool overflow = false;
+
+  for (int digit; ptr != last && (digit = hex_digit(*ptr)) >= 0; ptr++) {
+    overflow |= (sum >> 60) != 0;
+    sum = (sum << 4) | digit;
+  }
+
+  if (ptr == first) {
+    return {first, Status::INVALID};
+  }
+  if (overflow) {
+    return {ptr, Status::OUT_OF_RANGE};
+  }
+  value = sum;
+  return {ptr, Status::OK};
+}
+
+Result parse_binary(const char *first, const char *last, uint64_t &value) {
+  const char *ptr = first;
+  uint64_t sum = 0;
+  bool overflow = false;
+
+  for (; ptr != last && (*ptr == '0' || *ptr == '1'); ptr++) {
+    overflow |= (sum >> 63) != 0;
+    sum = (sum << 1) | (*ptr - '0');
+  }
+
+  if (ptr == first) {
+    return {first, Status::INVALID};
+  }
+  if (overflow) {
+    return {ptr, Status::OUT_OF_RANGE};
+  }
+  value = sum;
+  return {ptr, Status::OK};
+}
+
+Result parse_i32(const char *first, const char *last, int32_t &value) {
+  bool negative = first != last && *first == '-';
+  uint64_t magnitude = 0;
+  auto result = parse_decimal(first + negative, last, magnitude);
+  if (result.status == Status::INVALID) {
+    return {first, Status::INVALID};
+  }
+
+  int64_t wide;
+  result = apply_sign(result, magnitude, negative, INT32_MAX, wide);
+  if (result.ok()) {
+    value = static_cast<int32_t>(wide);
+  }
+  return result;
+}
+
+Result parse_u32(const char *first, const char *last, uint32_t &value) {
+  uint64_t wide = 0;
+  auto result = parse_decimal(first, last, wide);
+  if (!result.ok()) {
+    return result;
+  }
+  if (wide > UINT32_MAX) {
+    return {result.end, Status::OUT_OF_RANGE};
+  }
+  value = static_cast<uint32_t>(wide);
+  return result;
+}
+
+Result parse_integer(const char *first, const char *last, int64_t &value) {
+  bool negative = first != last && *first == '-';
+  const char *digits = first + negative;
+  uint64_t magnitude = 0;
+  Result result;
+
+  if (last - digits > 2 && digits[0] == '0' && (digits[1] | 0x20) == 'x') {
+    result = parse_hex(digits + 2, last, magnitude);
+  } else if (last - digits > 2 && digits[0] == '0' &&
+             (digits[1] | 0x20) == 'b') {
+    result = parse_binary(digits + 2, last, magnitude);
+  } else {
+    result = parse_decimal(digits, last, magnitude);
+  }
+
+  if (result.status == Status::INVALID) {
+    return {first, Status::INVALID};
+  }
+  return apply_sign(result, magnitude, negative, INT64_MAX, value);
+}
+
+Result parse_double(const char *first, const char *last, double &value) {
+  return parse_floating(first, last, value);
+}
+
+Result parse_float(const char *first, const char *last, float &value) {
+  return parse_floating(first, last, value);
+}
+
+size_t parse_integers(std::span<const std::string_view> literals,
+                      std::span<int64_t> values) {
+  size_t count = std::min(literals.size(), values.size());
+
+  for (size_t i = 0; i < count; i++) {
+    std::string_view literal = literals[i];
+    bool negative = !literal.empty() && literal[0] == '-';
+
+    uint64_t magnitude;
+    if (parse_short(literal.substr(negative), magnitude)) {
+      values[i] = negative ? -static_cast<int64_t>(magnitude)
+                           : static_cast<int64_t>(magnitude);
+      continue;
+    }
+
+    const char *last = literal.data() + literal.size();
+    auto result = parse_integer(literal.data(), last, values[i]);
+    if (!result.ok() || result.end != last) {
+      return i;
+    }
+  }
+  return count;
+}
+
+size_t parse_doubles(std::span<const std::string_view> literals,
+                     std::span<double> values) {
+  size_t count = std::min(literals.size(), values.size());
+
+  for (size_t i = 0; i < count; i++) {
+    std::string_view literal = literals[i];
+    bool negative = !literal.empty() && literal[0] == '-';
+
+    // NOTE: Integers of up to eight digits are exact doubles.
+    uint64_t magnitude;
+    if (parse_short(literal.substr(negative), magnitude)) {
+      values[i] = negative ? -static_cast<double>(magnitude)
+                           : static_cast<double>(magnitude);
+      continue;
+    }
+
+    const char *last = literal.data() + literal.size();
+    auto result = parse_double(literal.data(), last, values[i]);
+    if (!result.ok() || result.end != last) {
+      return i;
+    }
+  }
+  return count;
+}
+
+} // namespace numeric
@@ -0,0 +1,995 @@
+#include <interp/optimizer.hxx>
+#include <interp/instructions.hxx>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <map>
+#include <optional>
+#include <tuple>
+
+using OpCodes = VM::OpCodes;
+using MicroOpcode = OptimizingTier::MicroOpcode;
+using MicroOp = OptimizingTier::MicroOp;
+using Condition = OptimizingTier::Condition;
+
+namespace {
+
+constexpr uint32_t NO_VALUE = 0xffffffff;
+constexpr uint32_t COMPARE_BITS =
+    MemoryBank::ZERO_FLAG_BIT | MemoryBank::SIGN_FLAG_BIT;
+
+// NOTE: SSA value, defined once by the instruction that computes it. The
+// opcode is the micro-op it is lowered into, GET_GP and GET_FL are the
+// register values the region starts with. Stores are values too so they keep
+// their place among the loads.
+struct Value {
+  MicroOpcode op;
+  uint32_t a = NO_VALUE;
+  uint32_t b = NO_VALUE;
+  uint32_t c = NO_VALUE;
+  uint32_t imm = 0;
+};
+
+bool is_pure(MicroOpcode op) {
+  switch (op) {
+  case MicroOpcode::LOAD32:
+  case MicroOpcode::LOAD16:
+  case MicroOpcode::LOAD8:
+  case MicroOpcode::STORE32:
+  case MicroOpcode::STORE8:
+    return false;
+  default:
+    return true;
+  }
+}
+
+bool is_commutative(MicroOpcode op) {
+  switch (op) {
+  case MicroOpcode::ADD:
+  case MicroOpcode::MUL:
+  case MicroOpcode::OR:
+  case MicroOpcode::AND:
+  case MicroOpcode::XOR:
+    return true;
+  default:
+    return false;
+  }
+}
+
+uint32_t compare_bits(auto v1, auto v2) {
+  if (v1 == v2) {
+    return MemoryBank::ZERO_FLAG_BIT;
+  }
+  return v1 > v2 ? MemoryBank::SIGN_FLAG_BIT : 0;
+}
+
+float as_float(uint32_t bits) { return std::bit_cast<float>(bits); }
+uint32_t as_bits(float value) { return std::bit_cast<uint32_t>(value); }
+
+// NOTE: Same expressions as the callbacks in interpreter.cxx, a folded value
+// has to be exactly what the instruction would have computed. Shifts by 32 or
+// more are left to run time.
+std::optional<uint32_t> fold(MicroOpcode op, uint32_t x, uint32_t y) {
+  switch (op) {
+  case MicroOpcode::ADD:
+    return x + y;
+  case MicroOpcode::SUB:
+    return x - y;
+  case MicroOpcode::MUL:
+    return x * y;
+  case MicroOpcode::DIV:
+    return x / y;
+  case MicroOpcode::SHL:
+    return y < 32 ? std::optional<uint32_t>(x << y) : std::nullopt;
+  case MicroOpcode::SHR:
+    return y < 32 ? std::optional<uint32_t>(x >> y) : std::nullopt;
+  case MicroOpcode::OR:
+    return x | y;
+  case MicroOpcode::AND:
+    return x & y;
+  case MicroOpcode::XOR:
+    return x ^ y;
+  case MicroOpcode::NOT:
+    return ~x;
+  case MicroOpcode::LOGICAL_NOT:
+    return !x;
+  case MicroOpcode::FADD:
+    return as_bits(as_float(x) + as_float(y));
+  case MicroOpcode::FSUB:
+    return as_bits(as_float(x) - as_float(y));
+  case MicroOpcode::FMUL:
+    return as_bits(as_float(x) * as_float(y));
+  case MicroOpcode::FDIV:
+    return as_bits(as_float(x) / as_float(y));
+  default:
+    return std::nullopt;
+  }
+}
+
+// NOTE: Lifts a region into SSA values. Every register holds the value last
+// assigned to it, instructions look their operands up and assign their
+// result, so copies and overwritten results simply stop being referenced.
+// New values go through constant folding, algebraic simplification and value
+// numbering before they are added.
+class RegionBuilder {
+public:
+  RegionBuilder() {
+    m_gp_in.fill(NO_VALUE);
+    m_gp.fill(NO_VALUE);
+    m_fl_in.fill(NO_VALUE);
+    m_fl.fill(NO_VALUE);
+  }
+
+  uint32_t gp(RegID r) {
+    if (m_gp[r] == NO_VALUE) {
+      m_gp[r] = m_gp_in[r] = add({.op = MicroOpcode::GET_GP, .imm = r});
+    }
+    return m_gp[r];
+  }
+
+  uint32_t fl(RegID r) {
+    if (m_fl[r] == NO_VALUE) {
+      m_fl[r] = m_fl_in[r] = add({.op = MicroOpcode::GET_FL, .imm = r});
+    }
+    return m_fl[r];
+  }
+
+  void set_gp(RegID r, uint32_t value) {
+    gp(r);
+    m_gp[r] = value;
+  }
+
+  void set_fl(RegID r, uint32_t value) {
+    fl(r);
+    m_fl[r] = value;
+  }
+
+  std::optional<uint32_t> constant_of(uint32_t value) const {
+    if (m_values[value].op == MicroOpcode::CONST) {
+      return m_values[value].imm;
+    }
+    return std::nullopt;
+  }
+
+  uint32_t constant(uint32_t bits) {
+    return number({.op = MicroOpcode::CONST, .imm = bits});
+  }
+
+  uint32_t unary(MicroOpcode op, uint32_t a) {
+    if (auto x = constant_of(a)) {
+      return constant(*fold(op, *x, 0));
+    }
+    return number({op, a});
+  }
+
+  uint32_t binary(MicroOpcode op, uint32_t a, uint32_t b) {
+    auto x = constant_of(a);
+    auto y = constant_of(b);
+
+    if (x && y) {
+      if (auto folded = fold(op, *x, *y)) {
+        return constant(*folded);
+      }
+    }
+
+    if (is_commutative(op) && (x || (!y && b < a))) {
+      std::swap(a, b);
+      std::swap(x, y);
+    }
+
+    if (y) {
+      switch (op) {
+      case MicroOpcode::ADD:
+      case MicroOpcode::SUB:
+      case MicroOpcode::OR:
+      case MicroOpcode::XOR:
+      case MicroOpcode::SHL:
+      case MicroOpcode::SHR:
+        if (*y == 0) {
+          return a;
+        }
+        break;
+      case MicroOpcode::MUL:
+        if (*y == 0) {
+          return b;
+        }
+        [[fallthrough]];
+      case MicroOpcode::DIV:
+        if (*y == 1) {
+          return a;
+        }
+        break;
+      case MicroOpcode::AND:
+        if (*y == 0) {
+          return b;
+        }
+        if (*y == 0xffffffff) {
+          return a;
+        }
+        break;
+      default:
+        break;
+      }
+    }
+
+    if (a == b) {
+      switch (op) {
+      case MicroOpcode::SUB:
+      case MicroOpcode::XOR:
+        return constant(0);
+      case MicroOpcode::OR:
+      case MicroOpcode::AND:
+        return a;
+      default:
+        break;
+      }
+    }
+
+    return number({op, a, b});
+  }
+
+  // NOTE: A compare only replaces the zero and sign bits, so the flags of a
+  // compare that feed another compare are not needed by it.
+  uint32_t compare(MicroOpcode op, uint32_t flags, uint32_t a, uint32_t b) {
+    MicroOpcode flags_op = m_values[flags].op;
+    if (flags_op == MicroOpcode::CMP || flags_op == MicroOpcode::FCMP) {
+      flags = m_values[flags].a;
+    }
+
+    std::optional<uint32_t> bits;
+    auto x = constant_of(a);
+    auto y = constant_of(b);
+    if (op == MicroOpcode::CMP && (a == b || (x && y))) {
+      bits = a == b ? MemoryBank::ZERO_FLAG_BIT : compare_bits(*x, *y);
+    } else if (op == MicroOpcode::FCMP && x && y) {
+      bits = compare_bits(as_float(*x), as_float(*y));
+    }
+
+    if (bits) {
+      return binary(MicroOpcode::OR,
+                    binary(MicroOpcode::AND, flags, constant(~COMPARE_BITS)),
+                    constant(*bits));
+    }
+    return number({op, flags, a, b});
+  }
+
+  // NOTE: Memory is tracked by address, a load of a value the region already
+  // loaded or stored is that value. A store forgets everything it overlaps.
+  uint32_t load(MicroOpcode op, MemPtr address, uint32_t size) {
+    auto key = std::make_pair(address, size);
+    if (auto it = m_memory.find(key); it != m_memory.end()) {
+      return it->second;
+    }
+    return m_memory[key] = add({.op = op, .imm = address});
+  }
+
+  void store(MicroOpcode op, MemPtr address, uint32_t size, uint32_t value) {
+    std::erase_if(m_memory, [&](auto &entry) {
+      auto [entry_address, entry_size] = entry.first;
+      return entry_address < address + size &&
+             address < entry_address + entry_size;
+    });
+    add({.op = op, .a = value, .imm = address});
+
+    m_memory[{address, size}] =
+        size == sizeof(uint32_t) ? value
+                                 : binary(MicroOpcode::AND, value,
+                                          constant(0xff));
+  }
+
+  const std::vector<Value> &values() const { return m_values; }
+  uint32_t gp_input(RegID r) const { return m_gp_in[r]; }
+  uint32_t fl_input(RegID r) const { return m_fl_in[r]; }
+  uint32_t gp_final(RegID r) const { return m_gp[r]; }
+  uint32_t fl_final(RegID r) const { return m_fl[r]; }
+
+  bool gp_written(RegID r) const { return m_gp[r] != m_gp_in[r]; }
+  bool fl_written(RegID r) const { return m_fl[r] != m_fl_in[r]; }
+
+private:
+  uint32_t add(Value value) {
+    m_values.push_back(value);
+    return m_values.size() - 1;
+  }
+
+  uint32_t number(Value value) {
+    auto key = std::make_tuple(value.op, value.a, value.b, value.c, value.imm);
+    if (auto it = m_numbering.find(key); it != m_numbering.end()) {
+      return it->second;
+    }
+    return m_numbering[key] = add(value);
+  }
+
+  std::vector<Value> m_values;
+  std::array<uint32_t, MemoryBank::GP_REGS_32_COUNT> m_gp_in;
+  std::array<uint32_t, MemoryBank::GP_REGS_32_COUNT> m_gp;
+  std::array<uint32_t, MemoryBank::FL_REGS_32_COUNT> m_fl_in;
+  std::array<uint32_t, MemoryBank::FL_REGS_32_COUNT> m_fl;
+  std::map<std::tuple<MicroOpcode, uint32_t, uint32_t, uint32_t, uint32_t>,
+           uint32_t>
+      m_numbering;
+  std::map<std::pair<MemPtr, uint32_t>, uint32_t> m_memory;
+};
+
+bool in_data_memory(MemPtr address, uint32_t size) {
+  return uint64_t(address) + size <= MemoryBank::DEVICE_LOWER_LIMIT;
+}
+
+uint32_t line_of(uint64_t address) { return address >> CodeMap::LINE_SHIFT; }
+
+struct Region {
+  MemPtr end;
+  uint32_t instructions = 0;
+  Condition condition = Condition::NEVER;
+  uint32_t flags = NO_VALUE;
+  MemPtr target = 0;
+};
+
+// NOTE: Lifts the straight-line code at start until the first control
+// transfer (included) or the first instruction the tier leaves to the
+// interpreter (not included).
+//
+// A region never contains code its own stores overwrite, the store or the
+// instruction it would overwrite ends the region instead. The stores can
+// still invalidate other blocks.
+Region lift(MemoryBank::MemoryBuffer &memory, MemPtr start,
+            RegionBuilder &ir) {
+  using namespace VM::parameters;
+
+  Region region{start};
+  uint32_t store_first_line = 0xffffffff;
+  uint32_t store_last_line = 0;
+
+  while (region.instructions < OptimizingTier::MAX_REGION_INSTRUCTIONS &&
+         region.end < memory.size()) {
+    uint8_t opcode = memory[region.end];
+    uint32_t next = region.end + 1;
+
+    auto overwritten = [&](uint32_t first, uint32_t last) {
+      return first <= store_last_line && store_first_line <= last;
+    };
+    auto is_pc = [](RegID r) {
+      return r == MemoryBank::PROGRAM_COUNTER_REG;
+    };
+
+#define DECODE(op)                                                             \
+  ParameterList<OpCodes::op> p;                                                \
+  if (parse_parameters(memory, next, p) != Trap::NONE) {                       \
+    return region;                                                             \
+  }                                                                            \
+  if (overwritten(line_of(region.end), line_of(next - 1))) {                   \
+    return region;                                                             \
+  }
+
+#define BINARY(op, micro_op, source1, source2, source2_register)               \
+  {                                                                            \
+    DECODE(op);                                                                \
+    if (is_pc(p.source1) || is_pc(source2_register) ||                         \
+        is_pc(p.destination)) {                                                \
+      return region;                                                           \
+    }                                                                          \
+    ir.set_gp(p.destination,                                                   \
+              ir.binary(MicroOpcode::micro_op, ir.gp(p.source1), source2));    \
+    break;                                                                     \
+  }
+
+#define BINARY_FLOAT(op, micro_op, source1, source2)                           \
+  {                                                                            \
+    DECODE(op);                                                                \
+    ir.set_fl(p.destination,                                                   \
+              ir.binary(MicroOpcode::micro_op, ir.fl(p.source1), source2));    \
+    break;                                                                     \
+  }
+
+#define LOAD(op, micro_op, size)                                               \
+  {                                                                            \
+    DECODE(op);                                                                \
+    if (!in_data_memory(p.source, size) || is_pc(p.destination)) {            \
+      return region;                                                           \
+    }                                                                          \
+    ir.set_gp(p.destination, ir.load(MicroOpcode::micro_op, p.source, size));  \
+    break;                                                                     \
+  }
+
+#define LOAD_IMMEDIATE(op, value)                                              \
+  {                                                                            \
+    DECODE(op);                                                                \
+    if (is_pc(p.destination)) {                                                \
+      return region;                                                           \
+    }                                                                          \
+    ir.set_gp(p.destination, ir.constant(value));                              \
+    break;                                                                     \
+  }
+
+#define STORE(op, micro_op, size)                                              \
+  {                                                                            \
+    DECODE(op);                                                                \
+    if (!in_data_memory(p.destination, size) || is_pc(p.source) ||            \
+        (line_of(p.destination) <= line_of(next - 1) &&                        \
+         line_of(start) <= line_of(p.destination + size - 1))) {              \
+      return region;                                                           \
+    }                                                                          \
+    ir.store(MicroOpcode::micro_op, p.destination, size, ir.gp(p.source));     \
+    store_first_line = std::min(store_first_line, line_of(p.destination));     \
+    store_last_line =                                                          \
+        std::max(store_last_line, line_of(p.destination + size - 1));          \
+    break;                                                                     \
+  }
+
+#define JUMP(op, jump_condition)                                               \
+  {                                                                            \
+    DECODE(op);                                                                \
+    if (p.jump_address >= MemoryBank::MEMORY_SIZE) {                           \
+      return region;                                                           \
+    }                                                                          \
+    region.condition = jump_condition;                                         \
+    region.flags = ir.gp(MemoryBank::FLAGS_REG);                               \
+    region.target = p.jump_address;                                           \
+    region.end = next;                                                         \
+    region.instructions++;                                                     \
+    return region;                                                             \
+  }
+
+    switch (opcode) {
+    case OpCodes::NOP: {
+      DECODE(NOP);
+      break;
+    }
+    case OpCodes::LOAD:
+      LOAD(LOAD, LOAD32, sizeof(uint32_t));
+    case OpCodes::LOAD_BYTE:
+      LOAD(LOAD_BYTE, LOAD8, sizeof(uint8_t));
+    case OpCodes::LOAD_HALF_WORD:
+      LOAD(LOAD_HALF_WORD, LOAD16, sizeof(uint16_t));
+    case OpCodes::LOAD_IMMEDIATE:
+      LOAD_IMMEDIATE(LOAD_IMMEDIATE, p.immediate_value);
+    case OpCodes::LOAD_BYTE_IMMEDIATE:
+      LOAD_IMMEDIATE(LOAD_BYTE_IMMEDIATE, p.immediate_value);
+    case OpCodes::LOAD_HALF_WORD_IMMEDIATE:
+      LOAD_IMMEDIATE(LOAD_HALF_WORD_IMMEDIATE, p.immediate_value);
+    case OpCodes::LOAD_FLOAT_IMMEDIATE: {
+      DECODE(LOAD_FLOAT_IMMEDIATE);
+      ir.set_fl(p.destination, ir.constant(as_bits(p.immediate_value)));
+      break;
+    }
+    // NOTE: The half word store only writes the low byte, see shw_cb.
+    case OpCodes::STORE:
+      STORE(STORE, STORE32, sizeof(uint32_t));
+    case OpCodes::STORE_BYTE:
+      STORE(STORE_BYTE, STORE8, sizeof(uint8_t));
+    case OpCodes::STORE_HALF_WORD:
+      STORE(STORE_HALF_WORD, STORE8, sizeof(uint8_t));
+    case OpCodes::SHIFT_LEFT:
+      BINARY(SHIFT_LEFT, SHL, source, ir.gp(p.shift_by), p.shift_by);
+    case OpCodes::SHIFT_RIGHT:
+      BINARY(SHIFT_RIGHT, SHR, source, ir.gp(p.shift_by), p.shift_by);
+    case OpCodes::SHIFT_IMMEDIATE_LEFT:
+      BINARY(SHIFT_IMMEDIATE_LEFT, SHL, source, ir.constant(p.shift_by),
+             p.source);
+    case OpCodes::SHIFT_IMMEDIATE_RIGHT:
+      BINARY(SHIFT_IMMEDIATE_RIGHT, SHR, source, ir.constant(p.shift_by),
+             p.source);
+    case OpCodes::OR:
+      BINARY(OR, OR, source1, ir.gp(p.source2), p.source2);
+    case OpCodes::AND:
+      BINARY(AND, AND, source1, ir.gp(p.source2), p.source2);
+    case OpCodes::XOR:
+      BINARY(XOR, XOR, source1, ir.gp(p.source2), p.source2);
+    case OpCodes::OR_IMMEDIATE:
+      BINARY(OR_IMMEDIATE, OR, source1, ir.constant(p.immediate_value),
+             p.source1);
+    case OpCodes::AND_IMMEDIATE:
+      BINARY(AND_IMMEDIATE, AND, source1, ir.constant(p.immediate_value),
+             p.source1);
+    case OpCodes::XOR_IMMEDIATE:
+      BINARY(XOR_IMMEDIATE, XOR, source1, ir.constant(p.immediate_value),
+             p.source1);
+    // NOTE: nor and nand are logical, the immediate forms bitwise, see
+    // nor_cb and nori_cb.
+    case OpCodes::NOR: {
+      DECODE(NOR);
+      if (is_pc(p.source1) || is_pc(p.source2) || is_pc(p.destination)) {
+        return region;
+      }
+      ir.set_gp(p.destination,
+                ir.unary(MicroOpcode::LOGICAL_NOT,
+                         ir.binary(MicroOpcode::OR, ir.gp(p.source1),
+                                   ir.gp(p.source2))));
+      break;
+    }
+    case OpCodes::NAND: {
+      DECODE(NAND);
+      if (is_pc(p.source1) || is_pc(p.source2) || is_pc(p.destination)) {
+        return region;
+      }
+      ir.set_gp(p.destination,
+                ir.unary(MicroOpcode::LOGICAL_NOT,
+                         ir.binary(MicroOpcode::AND, ir.gp(p.source1),
+                                   ir.gp(p.source2))));
+      break;
+    }
+    case OpCodes::NOR_IMMEDIATE: {
+      DECODE(NOR_IMMEDIATE);
+      if (is_pc(p.source1) || is_pc(p.destination)) {
+        return region;
+      }
+      ir.set_gp(p.destination,
+                ir.unary(MicroOpcode::NOT,
+                         ir.binary(MicroOpcode::OR, ir.gp(p.source1),
+                                   ir.constant(p.immediate_value))));
+      break;
+    }
+    case OpCodes::NAND_IMMEDIATE: {
+      DECODE(NAND_IMMEDIATE);
+      if (is_pc(p.source1) || is_pc(p.destination)) {
+        return region;
+      }
+      ir.set_gp(p.destination,
+                ir.unary(MicroOpcode::NOT,
+                         ir.binary(MicroOpcode::AND, ir.gp(p.source1),
+                                   ir.constant(p.immediate_value))));
+      break;
+    }
+    case OpCodes::ADD_INT:
+      BINARY(ADD_INT, ADD, source1, ir.gp(p.source2), p.source2);
+    case OpCodes::SUB_INT:
+      BINARY(SUB_INT, SUB, source1, ir.gp(p.source2), p.source2);
+    case OpCodes::MULT_INT:
+      BINARY(MULT_INT, MUL, source1, ir.gp(p.source2), p.source2);
+    // NOTE: Only divisions that can't trap, the divisor has to be a known
+    // constant after propagation.
+    case OpCodes::DIV_INT: {
+      DECODE(DIV_INT);
+      auto divisor = ir.constant_of(ir.gp(p.source2));
+      if (!divisor || *divisor == 0 || is_pc(p.source1) ||
+          is_pc(p.source2) || is_pc(p.destination)) {
+        return region;
+      }
+      ir.set_gp(p.destination, ir.binary(MicroOpcode::DIV, ir.gp(p.source1),
+                                         ir.gp(p.source2)));
+      break;
+    }
+    case OpCodes::ADD_INT_IMMEDIATE:
+      BINARY(ADD_INT_IMMEDIATE, ADD, source, ir.constant(p.immediate_value),
+             p.source);
+    case OpCodes::SUB_INT_IMMEDIATE:
+      BINARY(SUB_INT_IMMEDIATE, SUB, source, ir.constant(p.immediate_value),
+             p.source);
+    case OpCodes::MULT_INT_IMMEDIATE:
+      BINARY(MULT_INT_IMMEDIATE, MUL, source, ir.constant(p.immediate_value),
+             p.source);
+    case OpCodes::DIV_INT_IMMEDIATE: {
+      DECODE(DIV_INT_IMMEDIATE);
+      if (p.immediate_value == 0 || is_pc(p.source) || is_pc(p.destination)) {
+        return region;
+      }
+      ir.set_gp(p.destination, ir.binary(MicroOpcode::DIV, ir.gp(p.source),
+                                         ir.constant(p.immediate_value)));
+      break;
+    }
+    case OpCodes::ADD_FLOAT:
+      BINARY_FLOAT(ADD_FLOAT, FADD, source1, ir.fl(p.source2));
+    case OpCodes::SUB_FLOAT:
+      BINARY_FLOAT(SUB_FLOAT, FSUB, source1, ir.fl(p.source2));
+    case OpCodes::MULT_FLOAT:
+      BINARY_FLOAT(MULT_FLOAT, FMUL, source1, ir.fl(p.source2));
+    case OpCodes::DIV_FLOAT:
+      BINARY_FLOAT(DIV_FLOAT, FDIV, source1, ir.fl(p.source2));
+    case OpCodes::ADD_FLOAT_IMMEDIATE:
+      BINARY_FLOAT(ADD_FLOAT_IMMEDIATE, FADD, source,
+                   ir.constant(as_bits(p.immediate_value)));
+    case OpCodes::SUB_FLOAT_IMMEDIATE:
+      BINARY_FLOAT(SUB_FLOAT_IMMEDIATE, FSUB, source,
+                   ir.constant(as_bits(p.immediate_value)));
+    case OpCodes::MULT_FLOAT_IMMEDIATE:
+      BINARY_FLOAT(MULT_FLOAT_IMMEDIATE, FMUL, source,
+                   ir.constant(as_bits(p.immediate_value)));
+    case OpCodes::DIV_FLOAT_IMMEDIATE:
+      BINARY_FLOAT(DIV_FLOAT_IMMEDIATE, FDIV, source,
+                   ir.constant(as_bits(p.immediate_value)));
+    case OpCodes::COMPARE: {
+      DECODE(COMPARE);
+      if (is_pc(p.register1) || is_pc(p.register2)) {
+        return region;
+      }
+      ir.set_gp(MemoryBank::FLAGS_REG,
+                ir.compare(MicroOpcode::CMP, ir.gp(MemoryBank::FLAGS_REG),
+                           ir.gp(p.register1), ir.gp(p.register2)));
+      break;
+    }
+    case OpCodes::COMPARE_FLOAT: {
+      DECODE(COMPARE_FLOAT);
+      ir.set_gp(MemoryBank::FLAGS_REG,
+                ir.compare(MicroOpcode::FCMP, ir.gp(MemoryBank::FLAGS_REG),
+                           ir.fl(p.register1), ir.fl(p.register2)));
+      break;
+    }
+    case OpCodes::JUMP:
+      JUMP(JUMP, Condition::ALWAYS);
+    case OpCodes::JUMP_ZERO:
+      JUMP(JUMP_ZERO, Condition::ZERO);
+    case OpCodes::JUMP_EQUAL:
+      JUMP(JUMP_EQUAL, Condition::ZERO);
+    case OpCodes::JUMP_LESS_THAN:
+      JUMP(JUMP_LESS_THAN, Condition::LESS);
+    case OpCodes::JUMP_GREATER_THAN:
+      JUMP(JUMP_GREATER_THAN, Condition::GREATER);
+    default:
+      return region;
+    }
+
+#undef DECODE
+#undef BINARY
+#undef BINARY_FLOAT
+#undef LOAD
+#undef LOAD_IMMEDIATE
+#undef STORE
+#undef JUMP
+
+    region.end = next;
+    region.instructions++;
+  }
+
+  return region;
+}
+
+// NOTE: Same conditions as the jump callbacks.
+bool taken(Condition condition, uint32_t flags) {
+  bool zero = flags & MemoryBank::ZERO_FLAG_BIT;
+  bool sign = flags & MemoryBank::SIGN_FLAG_BIT;
+
+  switch (condition) {
+  case Condition::NEVER:
+    return false;
+  case Condition::ALWAYS:
+    return true;
+  case Condition::ZERO:
+    return zero;
+  case Condition::LESS:
+    return !zero || !sign;
+  case Condition::GREATER:
+    return !zero && sign;
+  }
+  return false;
+}
+
+// NOTE: Only the values the block's exit needs are kept (the registers it
+// wrote, its stores and the flags its jump reads), everything else is dead.
+// In a loop the values that only depend on constants and registers the loop
+// doesn't write go to the preheader.
+void lower(const RegionBuilder &ir, const Region &region,
+           OptimizingTier::Block &block) {
+  auto &values = ir.values();
+  std::vector<bool> live(values.size(), false);
+
+  for (RegID r = 0; r < MemoryBank::GP_REGS_32_COUNT; r++) {
+    if (ir.gp_written(r)) {
+      live[ir.gp_final(r)] = true;
+    }
+  }
+  for (RegID r = 0; r < MemoryBank::FL_REGS_32_COUNT; r++) {
+    if (ir.fl_written(r)) {
+      live[ir.fl_final(r)] = true;
+    }
+  }
+  for (size_t v = 0; v < values.size(); v++) {
+    if (values[v].op == MicroOpcode::STORE32 ||
+        values[v].op == MicroOpcode::STORE8) {
+      live[v] = true;
+    }
+  }
+
+  block.condition = region.condition;
+  bool reads_flags = block.condition != Condition::NEVER &&
+                     block.condition != Condition::ALWAYS;
+  if (reads_flags) {
+    if (auto flags = ir.constant_of(region.flags)) {
+      block.condition = taken(block.condition, *flags) ? Condition::ALWAYS
+                                                       : Condition::NEVER;
+      reads_flags = false;
+    } else {
+      live[region.flags] = true;
+    }
+  }
+  block.loops =
+      block.condition != Condition::NEVER && region.target == block.start;
+
+  // NOTE: Operands are always defined before the values using them.
+  for (size_t v = values.size(); v-- > 0;) {
+    if (!live[v]) {
+      continue;
+    }
+    for (uint32_t operand : {values[v].a, values[v].b, values[v].c}) {
+      if (operand != NO_VALUE) {
+        live[operand] = true;
+      }
+    }
+  }
+
+  std::vector<bool> invariant(values.size(), false);
+  std::vector<uint16_t> slot(values.size(), 0);
+  uint16_t slot_count = 0;
+
+  for (size_t v = 0; v < values.size(); v++) {
+    if (!live[v]) {
+      continue;
+    }
+    auto &value = values[v];
+    slot[v] = slot_count++;
+
+    switch (value.op) {
+    case MicroOpcode::CONST:
+    case MicroOpcode::GET_GP:
+    case MicroOpcode::GET_FL:
+      invariant[v] = true;
+      break;
+    default:
+      invariant[v] = is_pure(value.op);
+      for (uint32_t operand : {value.a, value.b, value.c}) {
+        if (operand == NO_VALUE) {
+          continue;
+        }
+        // NOTE: A register the loop writes has a new value every iteration.
+        auto &source = values[operand];
+        bool written =
+            (source.op == MicroOpcode::GET_GP && ir.gp_written(source.imm)) ||
+            (source.op == MicroOpcode::GET_FL && ir.fl_written(source.imm));
+        invariant[v] = invariant[v] && invariant[operand] &&
+                       (!block.loops || !written);
+      }
+      // NOTE: Without a loop the preheader only reads the registers.
+      invariant[v] = invariant[v] && block.loops;
+      break;
+    }
+
+    MicroOp op{value.op, slot[v],
+               uint16_t(value.a == NO_VALUE ? 0 : slot[value.a]),
+               uint16_t(value.b == NO_VALUE ? 0 : slot[value.b]),
+               uint16_t(value.c == NO_VALUE ? 0 : slot[value.c]), value.imm};
+    (invariant[v] ? block.preheader : block.body).push_back(op);
+  }
+
+  for (RegID r = 0; r < MemoryBank::GP_REGS_32_COUNT; r++) {
+    if (ir.gp_written(r)) {
+      block.gp_out.push_back({r, slot[ir.gp_final(r)]});
+      if (block.loops && live[ir.gp_input(r)]) {
+        block.loop_moves.push_back(
+            {slot[ir.gp_final(r)], slot[ir.gp_input(r)]});
+      }
+    }
+  }
+  for (RegID r = 0; r < MemoryBank::FL_REGS_32_COUNT; r++) {
+    if (ir.fl_written(r)) {
+      block.fl_out.push_back({r, slot[ir.fl_final(r)]});
+      if (block.loops && live[ir.fl_input(r)]) {
+        block.loop_moves.push_back(
+            {slot[ir.fl_final(r)], slot[ir.fl_input(r)]});
+      }
+    }
+  }
+
+  // NOTE: A copy between registers (mov r1, r2 in a loop) makes one
+  // register's new value another one's old value, the moves then have to go
+  // through scratch slots.
+  for (auto [from, to] : block.loop_moves) {
+    for (auto [other_from, other_to] : block.loop_moves) {
+      block.loop_moves_overlap = block.loop_moves_overlap || from == other_to;
+    }
+  }
+
+  block.flags = reads_flags ? slot[region.flags] : 0;
+  block.target = region.target;
+  block.fallthrough = region.end;
+  block.slot_count = slot_count;
+}
+
+} // namespace
+
+OptimizingTier::OptimizingTier(Interpreter &interp)
+    : m_interp(interp), m_heat(MemoryBank::MEMORY_SIZE, 0) {
+  m_listener = m_interp.m_mb.code_map.add_listener(
+      [this](uint32_t first, uint32_t last) { invalidate(first, last); });
+}
+
+OptimizingTier::~OptimizingTier() {
+  m_interp.m_mb.code_map.remove_listener(m_listener);
+}
+
+void OptimizingTier::clear() {
+  m_blocks.clear();
+  std::fill(m_heat.begin(), m_heat.end(), 0);
+}
+
+const OptimizingTier::Block *OptimizingTier::compile(MemPtr pc) {
+  RegionBuilder ir;
+  Region region = lift(m_interp.m_mb.memory, pc, ir);
+
+  // NOTE: The head is registered either way, so a store that changes the
+  // code gives it another chance.
+  m_interp.m_mb.code_map.mark_code(pc, std::max(region.end, pc + 1));
+
+  if (region.instructions < 2) {
+    m_heat[pc] = NEVER;
+    return nullptr;
+  }
+
+  auto block = std::make_unique<Block>();
+  block->start = pc;
+  block->end = region.end;
+  block->guest_instructions = region.instructions;
+  lower(ir, region, *block);
+
+  // NOTE: Room for the scratch copies of the loop moves, the condition of a
+  // block without a jump reads slot 0.
+  m_slots.resize(
+      std::max<size_t>(m_slots.size(), block->slot_count * 2 + 1));
+
+  m_stats.blocks_compiled++;
+  m_stats.guest_instructions += block->guest_instructions;
+  m_stats.body_micro_ops += block->body.size();
+  return (m_blocks[pc] = std::move(block)).get();
+}
+
+void OptimizingTier::invalidate(uint32_t first_line, uint32_t last_line) {
+  m_stats.blocks_invalidated += std::erase_if(m_blocks, [&](auto &entry) {
+    auto &block = *entry.second;
+    return line_of(block.start) <= last_line &&
+           first_line <= line_of(block.end - 1);
+  });
+
+  uint64_t begin = uint64_t(first_line) << CodeMap::LINE_SHIFT;
+  uint64_t end = std::min<uint64_t>(uint64_t(last_line + 1)
+                                        << CodeMap::LINE_SHIFT,
+                                    m_heat.size());
+  std::fill(m_heat.begin() + begin, m_heat.begin() + end, 0);
+}
+
+void OptimizingTier::run(const std::vector<MicroOp> &ops) {
+  auto &mb = m_interp.m_mb;
+  uint32_t *v = m_slots.data();
+
+  for (const MicroOp &op : ops) {
+    switch (op.op) {
+    case MicroOpcode::CONST:
+      v[op.dst] = op.imm;
+      break;
+    case MicroOpcode::GET_GP:
+      v[op.dst] = mb.gp_regs_32[op.imm];
+      break;
+    case MicroOpcode::GET_FL:
+      v[op.dst] = as_bits(mb.fl_regs_32[op.imm]);
+      break;
+    case MicroOpcode::MOVE:
+      v[op.dst] = v[op.a];
+      break;
+    case MicroOpcode::ADD:
+      v[op.dst] = v[op.a] + v[op.b];
+      break;
+    case MicroOpcode::SUB:
+      v[op.dst] = v[op.a] - v[op.b];
+      break;
+    case MicroOpcode::MUL:
+      v[op.dst] = v[op.a] * v[op.b];
+      break;
+    case MicroOpcode::DIV:
+      v[op.dst] = v[op.a] / v[op.b];
+      break;
+    case MicroOpcode::SHL:
+      v[op.dst] = v[op.a] << v[op.b];
+      break;
+    case MicroOpcode::SHR:
+      v[op.dst] = v[op.a] >> v[op.b];
+      break;
+    case MicroOpcode::OR:
+      v[op.dst] = v[op.a] | v[op.b];
+      break;
+    case MicroOpcode::AND:
+      v[op.dst] = v[op.a] & v[op.b];
+      break;
+    case MicroOpcode::XOR:
+      v[op.dst] = v[op.a] ^ v[op.b];
+      break;
+    case MicroOpcode::NOT:
+      v[op.dst] = ~v[op.a];
+      break;
+    case MicroOpcode::LOGICAL_NOT:
+      v[op.dst] = !v[op.a];
+      break;
+    case MicroOpcode::FADD:
+      v[op.dst] = as_bits(as_float(v[op.a]) + as_float(v[op.b]));
+      break;
+    case MicroOpcode::FSUB:
+      v[op.dst] = as_bits(as_float(v[op.a]) - as_float(v[op.b]));
+      break;
+    case MicroOpcode::FMUL:
+      v[op.dst] = as_bits(as_float(v[op.a]) * as_float(v[op.b]));
+      break;
+    case MicroOpcode::FDIV:
+      v[op.dst] = as_bits(as_float(v[op.a]) / as_float(v[op.b]));
+      break;
+    case MicroOpcode::CMP:
+      v[op.dst] = (v[op.a] & ~COMPARE_BITS) | compare_bits(v[op.b], v[op.c]);
+      break;
+    case MicroOpcode::FCMP:
+      v[op.dst] = (v[op.a] & ~COMPARE_BITS) |
+                  compare_bits(as_float(v[op.b]), as_float(v[op.c]));
+      break;
+    case MicroOpcode::LOAD32:
+      std::memcpy(&v[op.dst], &mb.memory[op.imm], sizeof(uint32_t));
+      break;
+    case MicroOpcode::LOAD16: {
+      uint16_t value;
+      std::memcpy(&value, &mb.memory[op.imm], sizeof(uint16_t));
+      v[op.dst] = value;
+      break;
+    }
+    case MicroOpcode::LOAD8:
+      v[op.dst] = mb.memory[op.imm];
+      break;
+    case MicroOpcode::STORE32:
+      std::memcpy(&mb.memory[op.imm], &v[op.a], sizeof(uint32_t));
+      mb.code_map.note_store(op.imm, sizeof(uint32_t));
+      break;
+    case MicroOpcode::STORE8:
+      mb.memory[op.imm] = static_cast<uint8_t>(v[op.a]);
+      mb.code_map.note_store(op.imm, 1);
+      break;
+    }
+  }
+}
+
+uint64_t OptimizingTier::execute(const Block &block) {
+  auto &mb = m_interp.m_mb;
+  auto &pc = mb.gp_regs_32[MemoryBank::PROGRAM_COUNTER_REG];
+  uint32_t *v = m_slots.data();
+
+  auto write_back = [&]() {
+    for (auto [r, s] : block.gp_out) {
+      mb.gp_regs_32[r] = v[s];
+    }
+    for (auto [r, s] : block.fl_out) {
+      mb.fl_regs_32[r] = as_float(v[s]);
+    }
+  };
+
+  m_stats.block_runs++;
+  run(block.preheader);
+
+  for (uint64_t iterations = 1;; iterations++) {
+    run(block.body);
+
+    if (!taken(block.condition, v[block.flags])) {
+      write_back();
+      pc = block.fallthrough;
+      return iterations;
+    }
+
+    if (!block.loops) {
+      write_back();
+      pc = block.target;
+      m_interp.charge_block();
+      return iterations;
+    }
+
+    // NOTE: Preempted at the back edge, the state is the one at the head.
+    m_interp.charge_block();
+    if (!m_interp.is_running()) {
+      write_back();
+      pc = block.start;
+      return iterations;
+    }
+
+    if (block.loop_moves_overlap) {
+      for (auto [from, to] : block.loop_moves) {
+        v[block.slot_count + to] = v[from];
+      }
+      for (auto [from, to] : block.loop_moves) {
+        v[to] = v[block.slot_count + to];
+      }
+    } else {
+      for (auto [from, to] : block.loop_moves) {
+        v[to] = v[from];
+      }
+    }
+  }
+}
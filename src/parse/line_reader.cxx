@@ -0,0 +1,130 @@
+#include <interp/parse/line_reader.hxx>
+#include <boost/format.hpp>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+generic_ling::LineReader::LineReader(const std::string &path, char delimiter)
+    : m_delimiter(delimiter) {
+  m_fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (m_fd < 0) {
+    throw std::runtime_error((boost::format("Failed to open %1%: %2%") % path %
+                              std::strerror(errno))
+                                 .str());
+  }
+  m_owns_fd = true;
+
+  struct stat st;
+  if (::fstat(m_fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    void *map =
+        ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+    if (map != MAP_FAILED) {
+      ::madvise(map, st.st_size, MADV_SEQUENTIAL);
+      m_map = static_cast<const char *>(map);
+      m_map_size = st.st_size;
+      return;
+    }
+  }
+
+  m_buffers[0].resize(BUFFER_SIZE);
+  m_buffers[1].resize(BUFFER_SIZE);
+}
+
+generic_ling::LineReader::LineReader(int fd, char delimiter)
+    : m_fd(fd), m_delimiter(delimiter) {
+  m_buffers[0].resize(BUFFER_SIZE);
+  m_buffers[1].resize(BUFFER_SIZE);
+}
+
+generic_ling::LineReader::~LineReader() {
+  if (m_map) {
+    ::munmap(const_cast<char *>(m_map), m_map_size);
+  }
+  if (m_owns_fd) {
+    ::close(m_fd);
+  }
+}
+
+std::optional<std::string_view> generic_ling::LineReader::next() {
+  return m_map ? next_mapped() : next_buffered();
+}
+
+std::optional<std::string_view> generic_ling::LineReader::next_mapped() {
+  // NOTE: Everything before the offset has been consumed, the previous line
+  // is no longer in use either.
+  if (m_offset - m_released >= RELEASE_INTERVAL) {
+    size_t page = ::sysconf(_SC_PAGESIZE);
+    size_t release_to = m_offset / page * page;
+    ::madvise(const_cast<char *>(m_map) + m_released, release_to - m_released,
+              MADV_DONTNEED);
+    m_released = release_to;
+  }
+
+  if (m_offset >= m_map_size) {
+    return std::nullopt;
+  }
+
+  const char *start = m_map + m_offset;
+  size_t remaining = m_map_size - m_offset;
+  auto found =
+      static_cast<const char *>(std::memchr(start, m_delimiter, remaining));
+  size_t length = found ? found - start : remaining;
+
+  m_offset += found ? length + 1 : length;
+  return std::string_view(start, length);
+}
+
+std::optional<std::string_view> generic_ling::LineReader::next_buffered() {
+  for (;;) {
+    auto &buffer = m_buffers[m_current];
+    const char *start = buffer.data() + m_begin;
+    auto found = static_cast<const char *>(
+        std::memchr(start, m_delimiter, m_end - m_begin));
+
+    if (found) {
+      size_t length = found - start;
+      m_begin += length + 1;
+      return std::string_view(start, length);
+    }
+
+    if (m_eof) {
+      if (m_begin == m_end) {
+        return std::nullopt;
+      }
+      size_t length = m_end - m_begin;
+      m_begin = m_end;
+      return std::string_view(start, length);
+    }
+
+    // NOTE: Move the unfinished line to the start of the other buffer and
+    // read the rest of it behind it.
+    auto &other = m_buffers[m_current ^ 1];
+    size_t tail = m_end - m_begin;
+    if (tail * 2 > other.size()) {
+      other.resize(other.size() * 2);
+      buffer.resize(other.size());
+    }
+    std::memcpy(other.data(), m_buffers[m_current].data() + m_begin, tail);
+    m_current ^= 1;
+    m_begin = 0;
+    m_end = tail;
+
+    ssize_t res;
+    do {
+      res = ::read(m_fd, other.data() + tail, other.size() - tail);
+    } while (res < 0 && errno == EINTR);
+
+    if (res < 0) {
+      throw std::runtime_error(
+          (boost::format("Failed to read input: %1%") % std::strerror(errno))
+              .str());
+    }
+
+    m_eof = res == 0;
+    m_end += res;
+  }
+}
@@ -0,0 +1,203 @@
+#include <interp/parse/parallel_tokenize.hxx>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// NOTE: Chunks smaller than this aren't worth a thread.
+constexpr size_t MIN_CHUNK_SIZE = 64 * 1024;
+
+struct Chunk {
+  std::string_view text;
+  size_t position;
+
+  std::vector<ExpressionToken> tokens;
+  std::vector<size_t> offsets;
+  SymbolTable symbols;
+  TokenizeError error{.type = TokenizeError::Type::Nothing};
+};
+
+void tokenize_chunk(Chunk &chunk) {
+  // NOTE: Rough guess of one token per four bytes, saves most of the
+  // reallocations on big chunks.
+  chunk.tokens.reserve(chunk.text.size() / 4);
+
+  size_t begin = 0;
+  while (begin < chunk.text.size()) {
+    auto found = static_cast<const char *>(std::memchr(
+        chunk.text.data() + begin, '\n', chunk.text.size() - begin));
+    size_t end = found ? found - chunk.text.data() : chunk.text.size();
+
+    auto line = chunk.text.substr(begin, end - begin);
+    auto err =
+        tokenize(line.begin(), line.end(), chunk.tokens, chunk.symbols);
+    if (err.type != TokenizeError::Type::Nothing) {
+      err.position += chunk.position + begin;
+      chunk.error = err;
+      return;
+    }
+
+    chunk.offsets.push_back(chunk.tokens.size());
+    begin = end + 1;
+  }
+}
+
+std::vector<std::string_view> split_records(std::string_view input,
+                                            unsigned jobs) {
+  std::vector<std::string_view> parts;
+  size_t size = std::max(input.size() / std::max(jobs, 1u), MIN_CHUNK_SIZE);
+
+  size_t begin = 0;
+  while (begin < input.size()) {
+    size_t end = std::min(begin + size, input.size());
+    if (end < input.size()) {
+      size_t newline = input.find('\n', end);
+      end = newline == std::string_view::npos ? input.size() : newline + 1;
+    }
+    parts.push_back(input.substr(begin, end - begin));
+    begin = end;
+  }
+  return parts;
+}
+
+} // namespace
+
+ParallelTokenizer::ParallelTokenizer(unsigned jobs)
+    : m_jobs(std::max(jobs, 1u)) {
+  for (unsigned i = 1; i < m_jobs; i++) {
+    m_workers.emplace_back(&ParallelTokenizer::worker_loop, this);
+  }
+}
+
+ParallelTokenizer::~ParallelTokenizer() {
+  {
+    std::lock_guard lock(m_mutex);
+    m_stopping = true;
+  }
+  m_work_ready.notify_all();
+  for (auto &worker : m_workers) {
+    worker.join();
+  }
+}
+
+void ParallelTokenizer::worker_loop() {
+  std::unique_lock lock(m_mutex);
+  uint64_t generation = 0;
+
+  for (;;) {
+    m_work_ready.wait(
+        lock, [&] { return m_stopping || m_generation != generation; });
+    if (m_stopping) {
+      return;
+    }
+    generation = m_generation;
+    run_tasks(lock);
+  }
+}
+
+// NOTE: Called with the lock held, released while a task runs.
+void ParallelTokenizer::run_tasks(std::unique_lock<std::mutex> &lock) {
+  while (m_next < m_count) {
+    size_t i = m_next++;
+    const auto &task = *m_task;
+
+    lock.unlock();
+    task(i);
+    lock.lock();
+
+    if (++m_finished == m_count) {
+      m_work_done.notify_all();
+    }
+  }
+}
+
+void ParallelTokenizer::for_each(size_t count,
+                                 const std::function<void(size_t)> &task) {
+  std::unique_lock lock(m_mutex);
+  m_task = &task;
+  m_count = count;
+  m_next = 0;
+  m_finished = 0;
+  m_generation++;
+  m_work_ready.notify_all();
+
+  run_tasks(lock);
+  m_work_done.wait(lock, [&] { return m_finished == m_count; });
+  m_task = nullptr;
+}
+
+TokenizeError ParallelTokenizer::tokenize(std::string_view input,
+                                          TokenizedRecords &output,
+                                          SymbolTable &symbols) {
+  auto parts = split_records(input, m_jobs);
+  std::vector<Chunk> chunks(parts.size());
+
+  size_t position = 0;
+  for (size_t i = 0; i < parts.size(); i++) {
+    chunks[i].text = parts[i];
+    chunks[i].position = position;
+    position += parts[i].size();
+  }
+
+  for_each(chunks.size(), [&](size_t i) { tokenize_chunk(chunks[i]); });
+
+  // NOTE: Nothing after the first failing chunk is kept.
+  size_t kept = 0;
+  while (kept < chunks.size() && chunks[kept].error.type ==
+                                     TokenizeError::Type::Nothing) {
+    kept++;
+  }
+  size_t used = std::min(kept + 1, chunks.size());
+
+  std::vector<std::vector<SymbolId>> remaps(used);
+  std::vector<size_t> token_base(used + 1, output.tokens.size());
+  std::vector<size_t> record_base(used + 1, output.offsets.size());
+
+  for (size_t i = 0; i < used; i++) {
+    auto &chunk = chunks[i];
+    remaps[i].resize(chunk.symbols.size());
+    for (SymbolId id = 0; id < chunk.symbols.size(); id++) {
+      remaps[i][id] = symbols.intern(chunk.symbols.name(id));
+    }
+    token_base[i + 1] = token_base[i] + chunk.tokens.size();
+    record_base[i + 1] = record_base[i] + chunk.offsets.size();
+  }
+
+  // NOTE: A failing chunk only contributes the records before the error.
+  if (kept < used) {
+    auto &chunk = chunks[kept];
+    size_t complete = chunk.offsets.empty() ? 0 : chunk.offsets.back();
+    chunk.tokens.resize(complete);
+    token_base[used] = token_base[kept] + complete;
+  }
+
+  output.tokens.resize(token_base[used]);
+  output.offsets.resize(record_base[used]);
+
+  for_each(used, [&](size_t i) {
+    auto &chunk = chunks[i];
+    auto out = output.tokens.begin() + token_base[i];
+    for (auto token : chunk.tokens) {
+      if (token.type == ExpressionToken::Type::IDENTIFIER) {
+        token.value.identifier = remaps[i][token.value.identifier];
+      }
+      *out++ = token;
+    }
+
+    size_t base = token_base[i];
+    std::transform(chunk.offsets.begin(), chunk.offsets.end(),
+                   output.offsets.begin() + record_base[i],
+                   [base](size_t offset) { return base + offset; });
+  });
+
+  return kept < chunks.size()
+             ? chunks[kept].error
+             : TokenizeError{.type = TokenizeError::Type::Nothing};
+}
+
+TokenizeError tokenize_parallel(std::string_view input,
+                                TokenizedRecords &output, SymbolTable &symbols,
+                                unsigned jobs) {
+  ParallelTokenizer tokenizer(jobs);
+  return tokenizer.tokenize(input, output, symbols);
+}
@@ -1,8 +1,10 @@
+#include <interp/numeric.hxx>
 #include <interp/parse/parse.hxx>
 #include <algorithm>
 #include <boost/format.hpp>
 #include <cmath>
 #include <iostream>
+#include <memory>
 #include <sstream>
 
 using fmt = boost::format;
@@ -27,13 +29,6 @@ void skip_whitespaces(CharIter &begin_iter, CharIter end_iter) {
   }
 }
 
-CharIter find_last_digit(CharIter begin_iter, CharIter end_iter) {
-  while (*begin_iter >= '0' && *begin_iter <= '9' && begin_iter != end_iter) {
-    begin_iter++;
-  }
-  return begin_iter;
-}
-
 bool is_space(char c) {
   switch (c) {
   case ' ':
@@ -52,6 +47,12 @@ bool is_digit(char c) {
   }
 }
 
+bool is_identifier_start(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+bool is_identifier_char(char c) { return is_identifier_start(c) || is_digit(c); }
+
 std::pair<bool, CharIter> find_decimal_point_before_space(CharIter begin_iter,
                                                           CharIter end_iter) {
   while (begin_iter != end_iter && !is_space(*begin_iter)) {
@@ -100,112 +101,73 @@ std::pair<MathOperator, CharIter> parse_operator(CharIter begin_iter,
   return {op, ++begin_iter};
 }
 
-std::pair<int, CharIter> parse_int(CharIter begin_iter, CharIter end_iter) {
-  int count = 1;
-  int sum = 0;
-
-  skip_whitespaces(begin_iter, end_iter);
-
-  bool is_negative = *begin_iter == '-' ? true : false;
-  is_negative ? begin_iter++ : begin_iter; // increment iter
-
-  auto last_digit = find_last_digit(begin_iter, end_iter);
-
-  for (auto &i = begin_iter; i != last_digit; i++) {
-    auto c = *i;
-
-    if (!is_digit(c)) {
-      auto msg = fmt("Expected integer literal!\nInvalid digit: '%1%'") % c;
-      throw ParseError(msg.str());
-    }
-
-    int n = c - '0';
-    sum = sum * 10 + n;
-  }
-
-  if (begin_iter != end_iter && !is_space(*begin_iter)) {
-    auto msg =
-        fmt("Unexpected symbol after integer literal: '%1%'") % *begin_iter;
+// NOTE: A literal ends at a space or at the end of the input.
+CharIter end_of_literal(CharIter begin_iter, const char *first,
+                        numeric::Result result, CharIter end_iter) {
+  auto iter = begin_iter + (result.end - first);
+  if (iter != end_iter && !is_space(*iter)) {
+    auto msg = fmt("Unexpected symbol after numeric literal: '%1%'") % *iter;
     throw ParseError(msg.str());
   }
-
-  return {is_negative ? -sum : sum, begin_iter};
+  return iter;
 }
 
-std::pair<double, CharIter> parse_float_decimal_part(CharIter begin_iter,
-                                                     CharIter end_iter) {
-
-  float decimal_place = 0.1f;
-  auto &i = begin_iter;
-  float sum = 0.0f;
-
-  if (*begin_iter == '.') {
-    begin_iter++;
-
-    while (begin_iter != end_iter) {
-
-      char c = *i;
-
-      if (!is_digit(c)) {
-        auto msg = fmt("Expected digit after decimal point while "
-                       "parsing float! (FOUND:  %1%)") %
-                   c;
-        throw ParseError(msg.str());
-      }
+std::pair<int, CharIter> parse_int(CharIter begin_iter, CharIter end_iter) {
+  skip_whitespaces(begin_iter, end_iter);
 
-      sum = sum + decimal_place * c;
-      decimal_place *= 0.1f;
+  const char *first = std::to_address(begin_iter);
+  int32_t value = 0;
+  auto result =
+      numeric::parse_i32(first, first + (end_iter - begin_iter), value);
 
-      return {sum, begin_iter};
-    }
-  } else {
-    return {sum, begin_iter};
+  if (result.status == numeric::Status::INVALID) {
+    auto msg = fmt("Expected integer literal!\nInvalid digit: '%1%'") %
+               (begin_iter != end_iter ? *begin_iter : ' ');
+    throw ParseError(msg.str());
+  }
+  if (result.status == numeric::Status::OUT_OF_RANGE) {
+    throw ParseError("Integer literal out of range!");
   }
 
-  return {sum, i};
+  return {value, end_of_literal(begin_iter, first, result, end_iter)};
 }
 
 std::pair<double, CharIter> parse_float(CharIter begin_iter,
                                         CharIter end_iter) {
-  int count = 1;
-  double sum = 0;
-
   skip_whitespaces(begin_iter, end_iter);
 
-  bool is_negative = *begin_iter == '-' ? true : false;
-  is_negative ? begin_iter++ : begin_iter; // increment iter
+  const char *first = std::to_address(begin_iter);
+  double value = 0;
+  auto result =
+      numeric::parse_double(first, first + (end_iter - begin_iter), value);
 
-  try {
-    auto res = parse_int(begin_iter, end_iter);
-    sum = res.first;
-    begin_iter = res.second;
-  } catch (ParseError err) {
-    auto msg = fmt("Failed while parsing integer part of float with: \n%1%") %
-               err.what();
+  if (result.status == numeric::Status::INVALID) {
+    auto msg = fmt("Expected floating point literal!\nInvalid character: "
+                   "'%1%'") %
+               (begin_iter != end_iter ? *begin_iter : ' ');
     throw ParseError(msg.str());
   }
+  if (result.status == numeric::Status::OUT_OF_RANGE) {
+    throw ParseError("Floating point literal out of range!");
+  }
 
-  if (begin_iter != end_iter) {
-    try {
-      auto res = parse_float_decimal_part(begin_iter, end_iter);
-      sum += res.first;
-      begin_iter = res.second;
+  return {value, end_of_literal(begin_iter, first, result, end_iter)};
+}
 
-    } catch (ParseError err) {
-      auto msg =
-          fmt("Failed while parsing decimal part of a float with: \n %1%") %
-          err.what();
-      throw ParseError(msg.str());
-    }
+std::pair<std::string_view, CharIter> parse_identifier(CharIter begin_iter,
+                                                       CharIter end_iter) {
+  skip_whitespaces(begin_iter, end_iter);
+
+  if (begin_iter == end_iter || !is_identifier_start(*begin_iter)) {
+    throw ParseError("Expected an identifier!");
   }
 
-  if (begin_iter != end_iter && !is_space(*begin_iter)) {
-    auto msg =
-        fmt("Unexpected symbol after integer literal: '%1%'") % *begin_iter;
-    throw ParseError(msg.str());
+  auto first = begin_iter;
+  while (begin_iter != end_iter && is_identifier_char(*begin_iter)) {
+    begin_iter++;
   }
 
-  return {is_negative ? -sum : sum, begin_iter};
+  return {std::string_view(&*first, begin_iter - first), begin_iter};
 }
 
 std::ostream &operator<<(std::ostream &out_strm, MathOperator op) {
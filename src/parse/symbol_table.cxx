@@ -0,0 +1,82 @@
+#include <interp/parse/symbol_table.hxx>
+#include <algorithm>
+#include <cstring>
+
+SymbolTable::SymbolTable() : m_slots(INITIAL_SLOT_COUNT, {0, NO_SYMBOL}) {}
+
+// NOTE: FNV-1a
+uint32_t SymbolTable::hash(std::string_view name) {
+  uint32_t h = 2166136261u;
+  for (char c : name) {
+    h ^= static_cast<uint8_t>(c);
+    h *= 16777619u;
+  }
+  return h;
+}
+
+// Returns the slot holding the name or the empty slot it would go into.
+size_t SymbolTable::probe(std::string_view name, uint32_t hash) const {
+  size_t mask = m_slots.size() - 1;
+  size_t i = hash & mask;
+
+  while (m_slots[i].id != NO_SYMBOL &&
+         (m_slots[i].hash != hash || m_names[m_slots[i].id] != name)) {
+    i = (i + 1) & mask;
+  }
+  return i;
+}
+
+SymbolId SymbolTable::find(std::string_view name) const {
+  return m_slots[probe(name, hash(name))].id;
+}
+
+SymbolId SymbolTable::intern(std::string_view name) {
+  uint32_t h = hash(name);
+  size_t slot = probe(name, h);
+
+  if (m_slots[slot].id != NO_SYMBOL) {
+    return m_slots[slot].id;
+  }
+
+  SymbolId id = m_names.size();
+  m_names.push_back(store(name));
+  m_slots[slot] = {h, id};
+
+  // NOTE: Keep the load factor under 1/2 so probe sequences stay short.
+  if (m_names.size() * 2 > m_slots.size()) {
+    grow();
+  }
+  return id;
+}
+
+std::string_view SymbolTable::store(std::string_view name) {
+  if (m_chunks.empty() || m_chunk_used + name.size() > CHUNK_SIZE) {
+    // NOTE: Names longer than a chunk get a chunk of their own.
+    m_chunks.push_back(
+        std::make_unique<char[]>(std::max(CHUNK_SIZE, name.size())));
+    m_chunk_used = 0;
+  }
+
+  char *dst = m_chunks.back().get() + m_chunk_used;
+  std::memcpy(dst, name.data(), name.size());
+  m_chunk_used += name.size();
+  return {dst, name.size()};
+}
+
+void SymbolTable::grow() {
+  std::vector<Slot> slots(m_slots.size() * 2, {0, NO_SYMBOL});
+  size_t mask = slots.size() - 1;
+
+  for (auto &slot : m_slots) {
+    if (slot.id == NO_SYMBOL) {
+      continue;
+    }
+    size_t i = slot.hash & mask;
+    while (slots[i].id != NO_SYMBOL) {
+      i = (i + 1) & mask;
+    }
+    slots[i] = slot;
+  }
+
+  m_slots = std::move(slots);
+}
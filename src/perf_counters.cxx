@@ -0,0 +1,212 @@
+#include <interp/perf_counters.hxx>
+#include <chrono>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace {
+
+uint64_t read_tsc() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+constexpr uint64_t cache_event(uint64_t cache, uint64_t op, uint64_t result) {
+  return cache | (op << 8) | (result << 16);
+}
+
+int open_counter(uint32_t type, uint64_t config) {
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format =
+      PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  return syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+} // namespace
+
+PerfCounters::PerfCounters() {
+  m_fds[CYCLES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+  m_fds[INSTRUCTIONS] =
+      open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+  m_fds[BRANCH_MISSES] =
+      open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+  m_fds[L1I_MISSES] = open_counter(
+      PERF_TYPE_HW_CACHE,
+      cache_event(PERF_COUNT_HW_CACHE_L1I, PERF_COUNT_HW_CACHE_OP_READ,
+                  PERF_COUNT_HW_CACHE_RESULT_MISS));
+  m_fds[L1D_MISSES] = open_counter(
+      PERF_TYPE_HW_CACHE,
+      cache_event(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ,
+                  PERF_COUNT_HW_CACHE_RESULT_MISS));
+  m_fds[ITLB_MISSES] = open_counter(
+      PERF_TYPE_HW_CACHE,
+      cache_event(PERF_COUNT_HW_CACHE_ITLB, PERF_COUNT_HW_CACHE_OP_READ,
+                  PERF_COUNT_HW_CACHE_RESULT_MISS));
+}
+
+PerfCounters::~PerfCounters() {
+  for (int fd : m_fds) {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+}
+
+bool PerfCounters::has_hardware_counters() const {
+  for (int fd : m_fds) {
+    if (fd >= 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void PerfCounters::start() {
+  if (m_counting) {
+    return;
+  }
+  m_counting = true;
+
+  for (int fd : m_fds) {
+    if (fd >= 0) {
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+  // NOTE: Read last so the counters' own setup isn't in the interval.
+  m_tsc_start = read_tsc();
+}
+
+void PerfCounters::stop() {
+  if (!m_counting) {
+    return;
+  }
+  m_tsc_ticks += read_tsc() - m_tsc_start;
+
+  for (int fd : m_fds) {
+    if (fd >= 0) {
+      ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+  }
+  m_counting = false;
+
+  // NOTE: The kernel keeps the running totals, the values are read again
+  // from scratch after every interval.
+  for (size_t i = 0; i < COUNTER_COUNT; i++) {
+    if (m_fds[i] < 0) {
+      continue;
+    }
+
+    struct {
+      uint64_t value;
+      uint64_t time_enabled;
+      uint64_t time_running;
+    } data;
+
+    if (::read(m_fds[i], &data, sizeof(data)) != sizeof(data)) {
+      continue;
+    }
+
+    // NOTE: With more counters than the PMU has the kernel multiplexes them,
+    // the value is scaled up to the whole time the counter was enabled.
+    m_values[i] = data.time_running
+                      ? static_cast<uint64_t>(
+                            static_cast<double>(data.value) *
+                            data.time_enabled / data.time_running)
+                      : 0;
+  }
+}
+
+void PerfCounters::reset() {
+  stop();
+  for (int fd : m_fds) {
+    if (fd >= 0) {
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    }
+  }
+  m_values.fill(0);
+  m_tsc_ticks = 0;
+  m_dispatches = 0;
+  m_native_entries = 0;
+  m_compiled_instructions = 0;
+  m_marked = false;
+}
+
+void PerfCounters::mark(MarkAction action) {
+  // NOTE: The first mark switches from counting the whole run to counting
+  // only the marked regions, whatever was counted before it is dropped.
+  if (!m_marked) {
+    reset();
+    m_marked = true;
+  }
+
+  switch (action) {
+  case BEGIN_REGION:
+    start();
+    break;
+  case END_REGION:
+    stop();
+    break;
+  }
+}
+
+double PerfCounters::cycles_per_instruction() const {
+  uint64_t cycles = is_available(CYCLES) ? m_values[CYCLES] : m_tsc_ticks;
+  uint64_t instructions = guest_instructions();
+  return instructions ? static_cast<double>(cycles) / instructions : 0.0;
+}
+
+double PerfCounters::mispredicts_per_dispatch() const {
+  uint64_t dispatches = m_dispatches + m_native_entries;
+  return dispatches ? static_cast<double>(m_values[BRANCH_MISSES]) / dispatches
+                    : 0.0;
+}
+
+void PerfCounters::write_json(std::ostream &out) const {
+  constexpr const char *names[COUNTER_COUNT] = {
+      "cycles",     "instructions", "branch_misses",
+      "l1i_misses", "l1d_misses",   "itlb_misses"};
+
+  out << "{\"source\": \""
+      << (has_hardware_counters() ? "perf_event" : "rdtsc") << "\"";
+  out << ", \"guest_instructions\": " << guest_instructions();
+  out << ", \"compiled_instructions\": " << m_compiled_instructions;
+  out << ", \"native_entries\": " << m_native_entries;
+  out << ", \"tsc_ticks\": " << m_tsc_ticks;
+
+  for (size_t i = 0; i < COUNTER_COUNT; i++) {
+    out << ", \"" << names[i] << "\": ";
+    if (m_fds[i] >= 0) {
+      out << m_values[i];
+    } else {
+      out << "null";
+    }
+  }
+
+  out << ", \"cycles_per_guest_instruction\": " << cycles_per_instruction();
+  out << ", \"mispredicts_per_dispatch\": ";
+  if (is_available(BRANCH_MISSES)) {
+    out << mispredicts_per_dispatch();
+  } else {
+    out << "null";
+  }
+  out << "}\n";
+}
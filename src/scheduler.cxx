@@ -0,0 +1,84 @@
+#include <interp/scheduler.hxx>
+
+Scheduler::Scheduler(size_t worker_count, std::chrono::microseconds time_slice)
+    : m_time_slice(time_slice) {
+  m_workers.reserve(worker_count);
+  for (size_t i = 0; i < worker_count; i++) {
+    m_workers.emplace_back([this]() { worker_loop(); });
+  }
+}
+
+Scheduler::~Scheduler() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+  m_work_available.notify_all();
+
+  for (auto &worker : m_workers) {
+    worker.join();
+  }
+}
+
+void Scheduler::submit(VirtualMachine &vm, FinishedCallback on_finished) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_run_queue.push_back({&vm, std::move(on_finished)});
+    m_unfinished++;
+  }
+  m_work_available.notify_one();
+}
+
+void Scheduler::wait_idle() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_idle.wait(lock, [this]() { return m_unfinished == 0; });
+}
+
+// NOTE: Once the scheduler is stopping no machine gets another slice, the
+// preempted and the queued ones are handed back as they are.
+void Scheduler::worker_loop() {
+  for (;;) {
+    Job job;
+    bool stopping;
+
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_work_available.wait(
+          lock, [this]() { return m_stopping || !m_run_queue.empty(); });
+
+      if (m_run_queue.empty()) {
+        return;
+      }
+
+      job = std::move(m_run_queue.front());
+      m_run_queue.pop_front();
+      stopping = m_stopping;
+    }
+
+    auto status = RunStatus::PREEMPTED;
+    if (!stopping) {
+      auto deadline = Interpreter::Clock::now() + m_time_slice;
+      status = job.vm->m_interp.run_until(deadline);
+    }
+
+    if (status == RunStatus::PREEMPTED) {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      if (!m_stopping) {
+        m_run_queue.push_back(std::move(job));
+        lock.unlock();
+        m_work_available.notify_one();
+        continue;
+      }
+    }
+
+    if (job.on_finished) {
+      job.on_finished(*job.vm, status);
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_unfinished--;
+    }
+    m_idle.notify_all();
+  }
+}
@@ -0,0 +1,85 @@
+#include <interp/instructions.hxx>
+#include <interp/trace.hxx>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <iomanip>
+
+TraceBuffer::TraceBuffer(size_t capacity)
+    : m_records(new std::atomic<uint64_t>[std::bit_ceil(
+          std::max<size_t>(capacity, 1)) * RECORD_WORDS]()),
+      m_mask(std::bit_ceil(std::max<size_t>(capacity, 1)) - 1) {}
+
+void TraceBuffer::write_header(std::ostream &out) {
+  TraceFileHeader header;
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+}
+
+size_t TraceBuffer::drain(std::ostream &out) {
+  uint64_t capacity = m_mask + 1;
+  uint64_t head = m_head.load(std::memory_order_acquire);
+
+  if (head - m_tail > capacity) {
+    m_dropped += head - m_tail - capacity;
+    m_tail = head - capacity;
+  }
+
+  m_scratch.resize(head - m_tail);
+  for (uint64_t i = m_tail; i < head; i++) {
+    const auto *slot = &m_records[(i & m_mask) * RECORD_WORDS];
+    uint64_t words[RECORD_WORDS];
+    for (size_t w = 0; w < RECORD_WORDS; w++) {
+      words[w] = slot[w].load(std::memory_order_relaxed);
+    }
+    std::memcpy(&m_scratch[i - m_tail], words, sizeof(TraceRecord));
+  }
+
+  // NOTE: The producer may have lapped us while we were copying, the records
+  // it overwrote are not trustworthy anymore. The record at new_head is
+  // written before new_head + 1 is published, so its slot (the one of
+  // new_head - capacity) may be torn as well. The fence pairs with the one in
+  // record(), the head loaded below is at least as new as any record the
+  // copy above saw a piece of.
+  std::atomic_thread_fence(std::memory_order_acquire);
+  uint64_t new_head = m_head.load(std::memory_order_relaxed);
+  uint64_t first_valid =
+      new_head + 1 > capacity ? new_head + 1 - capacity : 0;
+  size_t skip = first_valid > m_tail ? std::min(first_valid - m_tail,
+                                                uint64_t(m_scratch.size()))
+                                     : 0;
+  m_dropped += skip;
+
+  out.write(reinterpret_cast<const char *>(m_scratch.data() + skip),
+            (m_scratch.size() - skip) * sizeof(TraceRecord));
+
+  m_tail = head;
+  return m_scratch.size() - skip;
+}
+
+void print_trace_record(std::ostream &out, const TraceRecord &record) {
+  out << std::hex << std::setfill('0') << std::setw(8) << record.pc << "  "
+      << std::setfill(' ') << std::left << std::setw(8);
+
+  if (record.opcode < VM::instruction_keywords.size()) {
+    out << VM::instruction_keywords[record.opcode];
+  } else {
+    out << "???";
+  }
+
+  out << std::right << std::dec;
+
+  if (record.reg != TraceRecord::NO_REGISTER) {
+    if (record.reg & TraceRecord::FLOAT_REGISTER_BIT) {
+      out << "  f" << (int)(record.reg & ~TraceRecord::FLOAT_REGISTER_BIT)
+          << " = " << std::bit_cast<float>(record.reg_value);
+    } else {
+      out << "  r" << (int)record.reg << " = " << record.reg_value;
+    }
+  }
+
+  if (record.address != TraceRecord::NO_ADDRESS) {
+    out << "  [0x" << std::hex << record.address << std::dec << "]";
+  }
+
+  out << '\n';
+}
@@ -0,0 +1,39 @@
+#include <interp/trace.hxx>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// NOTE: Decodes a binary trace written by TraceBuffer into a readable
+// listing, one executed instruction per line (see print_trace_record).
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    std::cerr << argv[0] << ": <TRACE FILE>" << std::endl;
+    return 1;
+  }
+
+  std::ifstream in(argv[1], std::ios::binary);
+  if (!in) {
+    std::cerr << "Failed to open trace file: " << argv[1] << std::endl;
+    return 1;
+  }
+
+  TraceFileHeader expected;
+  TraceFileHeader header;
+  in.read(reinterpret_cast<char *>(&header), sizeof(header));
+
+  if (!in || std::memcmp(header.magic, expected.magic, sizeof(header.magic)) ||
+      header.version != expected.version ||
+      header.record_size != expected.record_size) {
+    std::cerr << "Not a trace file or unsupported version: " << argv[1]
+              << std::endl;
+    return 1;
+  }
+
+  TraceRecord record;
+  while (in.read(reinterpret_cast<char *>(&record), sizeof(record))) {
+    print_trace_record(std::cout, record);
+  }
+
+  return 0;
+}
@@ -0,0 +1,681 @@
+#include <interp/wide_interpreter.hxx>
+#include <interp/instructions.hxx>
+#include <boost/format.hpp>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+using OpCodes = VM::OpCodes;
+
+namespace {
+
+template <size_t N> using IntLanes = std::array<uint32_t, N>;
+template <size_t N> using FloatLanes = std::array<float, N>;
+
+// NOTE: The active lane mask is expanded into all ones / all zeros words so
+// that writing only the active lanes is a branch free blend.
+template <size_t N> IntLanes<N> expand_mask(uint32_t mask) {
+  IntLanes<N> out;
+  for (size_t l = 0; l < N; l++) {
+    out[l] = 0u - ((mask >> l) & 1u);
+  }
+  return out;
+}
+
+template <size_t N, typename T> std::array<T, N> broadcast(T value) {
+  std::array<T, N> out;
+  out.fill(value);
+  return out;
+}
+
+// NOTE: Operations that have an AVX2 equivalent pass it alongside the scalar
+// one, without AVX2 the vector operation is simply nullptr and the scalar
+// lane loop is used.
+#ifdef __AVX2__
+#define VEC_INT(expr) [](__m256i a, __m256i b) { return expr; }
+#define VEC_FLOAT(expr) [](__m256 a, __m256 b) { return expr; }
+#else
+#define VEC_INT(expr) nullptr
+#define VEC_FLOAT(expr) nullptr
+#endif
+
+template <size_t N, typename ScalarOp, typename VecOp>
+void blend_int(IntLanes<N> &dst, const IntLanes<N> &a, const IntLanes<N> &b,
+               const IntLanes<N> &select, ScalarOp scalar, VecOp vec) {
+#ifdef __AVX2__
+  if constexpr (!std::is_same_v<VecOp, std::nullptr_t>) {
+    auto load = [](const uint32_t *p) {
+      return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    };
+    for (size_t l = 0; l < N; l += 8) {
+      __m256i result = vec(load(&a[l]), load(&b[l]));
+      _mm256_storeu_si256(
+          reinterpret_cast<__m256i *>(&dst[l]),
+          _mm256_blendv_epi8(load(&dst[l]), result, load(&select[l])));
+    }
+    return;
+  }
+#endif
+  (void)vec;
+  for (size_t l = 0; l < N; l++) {
+    dst[l] = (scalar(a[l], b[l]) & select[l]) | (dst[l] & ~select[l]);
+  }
+}
+
+template <size_t N, typename ScalarOp, typename VecOp>
+void blend_float(FloatLanes<N> &dst, const FloatLanes<N> &a,
+                 const FloatLanes<N> &b, const IntLanes<N> &select,
+                 ScalarOp scalar, VecOp vec) {
+#ifdef __AVX2__
+  if constexpr (!std::is_same_v<VecOp, std::nullptr_t>) {
+    for (size_t l = 0; l < N; l += 8) {
+      __m256 mask = _mm256_castsi256_ps(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&select[l])));
+      __m256 result = vec(_mm256_loadu_ps(&a[l]), _mm256_loadu_ps(&b[l]));
+      _mm256_storeu_ps(&dst[l],
+                       _mm256_blendv_ps(_mm256_loadu_ps(&dst[l]), result, mask));
+    }
+    return;
+  }
+#endif
+  (void)vec;
+  for (size_t l = 0; l < N; l++) {
+    dst[l] = select[l] ? scalar(a[l], b[l]) : dst[l];
+  }
+}
+
+bool in_memory(uint32_t address, uint32_t width) {
+  return uint64_t(address) + width <= MemoryBank::MEMORY_SIZE;
+}
+
+} // namespace
+
+template <size_t LANES> WideInterpreter<LANES>::WideInterpreter() {
+  m_lane_memory.resize(LANES);
+  reset();
+}
+
+template <size_t LANES> void WideInterpreter<LANES>::reset() {
+  for (auto &reg : gp_regs_32) {
+    reg.fill(0);
+  }
+  for (auto &reg : fl_regs_32) {
+    reg.fill(0.0f);
+  }
+  gp_regs_32[MemoryBank::STACK_PTR_REG].fill(MemoryBank::STACK_UPPER_LIMIT);
+  m_code.fill(0);
+  for (auto &memory : m_lane_memory) {
+    memory.fill(0);
+  }
+  m_halted = 0;
+  m_trap_state = {};
+}
+
+template <size_t LANES>
+void WideInterpreter<LANES>::load_program(Interpreter::BytecodeBuffer &buffer) {
+  if (buffer.size() > m_code.size()) {
+    throw std::runtime_error(
+        (boost::format("Program too large for VM memory!(size: %1%)") %
+         buffer.size())
+            .str());
+  }
+
+  // NOTE: Every lane gets a copy of the program too, so data embedded in the
+  // image is readable the same way as on the scalar interpreter.
+  std::copy(begin(buffer), end(buffer), begin(m_code));
+  for (auto &memory : m_lane_memory) {
+    std::copy(begin(buffer), end(buffer), begin(memory));
+  }
+}
+
+template <size_t LANES> Trap WideInterpreter<LANES>::run() {
+  auto &pcs = gp_regs_32[MemoryBank::PROGRAM_COUNTER_REG];
+
+  for (;;) {
+    LaneMask live = ALL_LANES & ~m_halted;
+    if (!live) {
+      return Trap::NONE;
+    }
+
+    uint32_t pc = std::numeric_limits<uint32_t>::max();
+    for (size_t l = 0; l < LANES; l++) {
+      if ((live >> l) & 1) {
+        pc = std::min(pc, pcs[l]);
+      }
+    }
+
+    LaneMask active = 0;
+    for (size_t l = 0; l < LANES; l++) {
+      active |= LaneMask(((live >> l) & 1) && pcs[l] == pc) << l;
+    }
+
+    if (pc >= MemoryBank::MEMORY_SIZE) {
+      // NOTE: The lowest live program counter is past the end of memory, so
+      // all of the remaining lanes are.
+      m_halted = ALL_LANES;
+      return Trap::NONE;
+    }
+
+    // NOTE: A trap stops all of the lanes with the faulting instruction not
+    // executed, same as on the scalar interpreter without a handler.
+    if (Trap trap = execute(pc, active); trap != Trap::NONE) [[unlikely]] {
+      m_trap_state = {trap, pc,
+                      m_fault_address != NO_FAULT_ADDRESS ? m_fault_address
+                                                          : pc};
+      m_fault_address = NO_FAULT_ADDRESS;
+      return trap;
+    }
+  }
+}
+
+#define LANE_GP(reg) gp_regs_32[reg]
+#define LANE_FL(reg) fl_regs_32[reg]
+
+template <size_t LANES>
+Trap WideInterpreter<LANES>::execute(uint32_t pc, LaneMask active) {
+  using namespace VM::parameters;
+
+  auto &pcs = gp_regs_32[MemoryBank::PROGRAM_COUNTER_REG];
+  auto &flags = gp_regs_32[MemoryBank::FLAGS_REG];
+  const IntLanes<LANES> select = expand_mask<LANES>(active);
+
+  uint8_t opcode = m_code[pc];
+  uint32_t next = pc + 1;
+
+  auto for_each_active = [&](auto &&fn) {
+    for (size_t l = 0; l < LANES; l++) {
+      if ((active >> l) & 1) {
+        fn(l);
+      }
+    }
+  };
+
+  // NOTE: Lanes in `taken` continue at their entry in `targets`, the rest of
+  // the active lanes fall through. A target past the end of memory traps
+  // before any of the lanes moves, same as the scalar jumps.
+  auto branch = [&](LaneMask taken, const IntLanes<LANES> &targets) {
+    for (size_t l = 0; l < LANES; l++) {
+      if (((taken >> l) & 1) && !in_memory(targets[l], 1)) [[unlikely]] {
+        m_fault_address = targets[l];
+        return Trap::INVALID_ADDRESS;
+      }
+    }
+    for_each_active([&](size_t l) {
+      pcs[l] = ((taken >> l) & 1) ? targets[l] : next;
+    });
+    return Trap::NONE;
+  };
+
+  auto zero_lanes = [&](const IntLanes<LANES> &values) {
+    LaneMask zero = 0;
+    for (size_t l = 0; l < LANES; l++) {
+      zero |= LaneMask(values[l] == 0) << l;
+    }
+    return zero & active;
+  };
+
+  auto taken_if = [&](auto &&condition) {
+    LaneMask taken = 0;
+    for (size_t l = 0; l < LANES; l++) {
+      bool zero = flags[l] & MemoryBank::ZERO_FLAG_BIT;
+      bool sign = flags[l] & MemoryBank::SIGN_FLAG_BIT;
+      taken |= LaneMask(condition(zero, sign)) << l;
+    }
+    return taken & active;
+  };
+
+  auto always = [](bool, bool) { return true; };
+  auto if_zero = [](bool zero, bool) { return zero; };
+  auto if_less = [](bool zero, bool sign) { return !zero || !sign; };
+  auto if_greater = [](bool zero, bool sign) { return !zero && sign; };
+
+  auto compare = [&](const auto &v1, const auto &v2) {
+    IntLanes<LANES> result;
+    for (size_t l = 0; l < LANES; l++) {
+      uint32_t f = flags[l] &
+                   ~(MemoryBank::ZERO_FLAG_BIT | MemoryBank::SIGN_FLAG_BIT);
+      if (v1[l] == v2[l]) {
+        f |= MemoryBank::ZERO_FLAG_BIT;
+      } else if (v1[l] > v2[l]) {
+        f |= MemoryBank::SIGN_FLAG_BIT;
+      }
+      result[l] = f;
+    }
+    blend_int(flags, result, result, select,
+              [](uint32_t a, uint32_t) { return a; }, nullptr);
+  };
+
+  auto add = [](auto a, auto b) { return a + b; };
+  auto sub = [](auto a, auto b) { return a - b; };
+  auto mul = [](auto a, auto b) { return a * b; };
+  auto div_int = [](uint32_t a, uint32_t b) { return b ? a / b : 0u; };
+  auto div_float = [](float a, float b) { return a / b; };
+
+#define DECODE(op)                                                             \
+  ParameterList<OpCodes::op> p;                                                \
+  if (Trap trap = parse_parameters(m_code, next, p); trap != Trap::NONE)       \
+      [[unlikely]]                                                             \
+  return trap
+
+#define CHECK_ADDRESS(address, width)                                          \
+  if (!in_memory(address, width)) [[unlikely]] {                               \
+    m_fault_address = address;                                                 \
+    return Trap::INVALID_ADDRESS;                                              \
+  }
+
+  switch (opcode) {
+  case OpCodes::NOP: {
+    break;
+  }
+  // NOTE: Counters are only attached to the scalar interpreter.
+  case OpCodes::PERF_MARK: {
+    DECODE(PERF_MARK);
+    break;
+  }
+  case OpCodes::LOAD: {
+    DECODE(LOAD);
+    CHECK_ADDRESS(p.source, sizeof(uint32_t));
+    for_each_active([&](size_t l) {
+      std::memcpy(&LANE_GP(p.destination)[l], &m_lane_memory[l][p.source],
+                  sizeof(uint32_t));
+    });
+    break;
+  }
+  case OpCodes::LOAD_BYTE: {
+    DECODE(LOAD_BYTE);
+    CHECK_ADDRESS(p.source, sizeof(uint8_t));
+    for_each_active([&](size_t l) {
+      LANE_GP(p.destination)[l] = m_lane_memory[l][p.source];
+    });
+    break;
+  }
+  case OpCodes::LOAD_HALF_WORD: {
+    DECODE(LOAD_HALF_WORD);
+    CHECK_ADDRESS(p.source, sizeof(uint16_t));
+    for_each_active([&](size_t l) {
+      uint16_t value;
+      std::memcpy(&value, &m_lane_memory[l][p.source], sizeof(uint16_t));
+      LANE_GP(p.destination)[l] = value;
+    });
+    break;
+  }
+  case OpCodes::LOAD_FLOAT: {
+    // NOTE: Same as lf_cb, loads a single byte.
+    DECODE(LOAD_FLOAT);
+    CHECK_ADDRESS(p.source, sizeof(uint8_t));
+    for_each_active([&](size_t l) {
+      LANE_FL(p.destination)[l] = m_lane_memory[l][p.source];
+    });
+    break;
+  }
+  case OpCodes::LOAD_IMMEDIATE: {
+    DECODE(LOAD_IMMEDIATE);
+    auto value = broadcast<LANES>(uint32_t(p.immediate_value));
+    blend_int(LANE_GP(p.destination), value, value, select,
+              [](uint32_t a, uint32_t) { return a; }, nullptr);
+    break;
+  }
+  case OpCodes::LOAD_BYTE_IMMEDIATE: {
+    DECODE(LOAD_BYTE_IMMEDIATE);
+    auto value = broadcast<LANES>(uint32_t(p.immediate_value));
+    blend_int(LANE_GP(p.destination), value, value, select,
+              [](uint32_t a, uint32_t) { return a; }, nullptr);
+    break;
+  }
+  case OpCodes::LOAD_HALF_WORD_IMMEDIATE: {
+    DECODE(LOAD_HALF_WORD_IMMEDIATE);
+    auto value = broadcast<LANES>(uint32_t(p.immediate_value));
+    blend_int(LANE_GP(p.destination), value, value, select,
+              [](uint32_t a, uint32_t) { return a; }, nullptr);
+    break;
+  }
+  case OpCodes::LOAD_FLOAT_IMMEDIATE: {
+    DECODE(LOAD_FLOAT_IMMEDIATE);
+    auto value = broadcast<LANES>(float(p.immediate_value));
+    blend_float(LANE_FL(p.destination), value, value, select,
+                [](float a, float) { return a; }, nullptr);
+    break;
+  }
+  case OpCodes::STORE: {
+    DECODE(STORE);
+    CHECK_ADDRESS(p.destination, sizeof(uint32_t));
+    for_each_active([&](size_t l) {
+      std::memcpy(&m_lane_memory[l][p.destination], &LANE_GP(p.source)[l],
+                  sizeof(uint32_t));
+    });
+    break;
+  }
+  case OpCodes::STORE_BYTE: {
+    DECODE(STORE_BYTE);
+    CHECK_ADDRESS(p.destination, sizeof(uint8_t));
+    for_each_active([&](size_t l) {
+      m_lane_memory[l][p.destination] =
+          static_cast<uint8_t>(LANE_GP(p.source)[l] & 0xff);
+    });
+    break;
+  }
+  case OpCodes::STORE_HALF_WORD: {
+    // NOTE: Same as shw_cb, only the low byte reaches memory.
+    DECODE(STORE_HALF_WORD);
+    CHECK_ADDRESS(p.destination, sizeof(uint8_t));
+    for_each_active([&](size_t l) {
+      m_lane_memory[l][p.destination] =
+          static_cast<uint16_t>(LANE_GP(p.source)[l] & 0xffff);
+    });
+    break;
+  }
+  case OpCodes::STORE_FLOAT: {
+    DECODE(STORE_FLOAT);
+    CHECK_ADDRESS(p.destination, sizeof(uint8_t));
+    for_each_active([&](size_t l) {
+      m_lane_memory[l][p.destination] = LANE_FL(p.source)[l];
+    });
+    break;
+  }
+  case OpCodes::SHIFT_LEFT: {
+    DECODE(SHIFT_LEFT);
+    blend_int(LANE_GP(p.destination), LANE_GP(p.source), LANE_GP(p.shift_by),
+              select,
+              [](uint32_t a, uint32_t b) { return b < 32 ? a << b : 0u; },
+              VEC_INT(_mm256_sllv_epi32(a, b)));
+    break;
+  }
+  case OpCodes::SHIFT_RIGHT: {
+    DECODE(SHIFT_RIGHT);
+    blend_int(LANE_GP(p.destination), LANE_GP(p.source), LANE_GP(p.shift_by),
+              select,
+              [](uint32_t a, uint32_t b) { return b < 32 ? a >> b : 0u; },
+              VEC_INT(_mm256_srlv_epi32(a, b)));
+    break;
+  }
+  case OpCodes::SHIFT_IMMEDIATE_LEFT: {
+    DECODE(SHIFT_IMMEDIATE_LEFT);
+    blend_int(LANE_GP(p.destination), LANE_GP(p.source),
+              broadcast<LANES>(uint32_t(p.shift_by)), select,
+              [](uint32_t a, uint32_t b) { return b < 32 ? a << b : 0u; },
+              VEC_INT(_mm256_sllv_epi32(a, b)));
+    break;
+  }
+  case OpCodes::SHIFT_IMMEDIATE_RIGHT: {
+    DECODE(SHIFT_IMMEDIATE_RIGHT);
+    blend_int(LANE_GP(p.destination), LANE_GP(p.source),
+              broadcast<LANES>(uint32_t(p.shift_by)), select,
+              [](uint32_t a, uint32_t b) { return b < 32 ? a >> b : 0u; },
+              VEC_INT(_mm256_srlv_epi32(a, b)));
+    break;
+  }
+  case OpCodes::OR: {
+    DECODE(OR);
+    blend_int(LANE_GP(p.destination), LANE_GP(p.source1), LANE_GP(p.source2),
+              select, [](uint32_t a, uint32_t b) { return a | b; },
+              VEC_INT(_mm256_or_si256(a, b)));
+    break;
+  }
+  case OpCodes::AND: {
+    DECODE(AND);
+    blend_int(LANE_GP(p.destination), LANE_GP(p.source1), LANE_GP(p.source2),
+              select, [](uint32_t a, uint32_t b) { return a & b; },
+              VEC_INT(_mm256_and_si256(a, b)));
+    break;
+  }
+  case OpCodes::XOR: {
+    DECODE(XOR);
+    blend_int(LANE_GP(p.destination), LANE_GP(p.source1), LANE_GP(p.source2),
+              select, [](uint32_t a, uint32_t b) { return a ^ b; },
+              VEC_INT(_mm256_xor_si256(a, b)));
+    break;
+  }
+  case OpCodes::NOR: {
+    // NOTE: Same as nor_cb, logical not of the result.
+    DECODE(NOR);
+    blend_int(LANE_GP(p.destination), LANE_GP(p.source1), LANE_GP(p.source2),
+              select,
+              [](uint32_t a, uint32_t b) { return uint32_t(!(a | b)); },
+              nullptr);
+    break;
+  }
+  case OpCodes::NAND: {
+    DECODE(NAND);
+    blend_int(LANE_GP(p.destination), LANE_GP(p.source1), LANE_GP(p.source2),
+              select,
+              [](uint32_t a, uint32_t b) { return uint32_t(!(a & b)); },
+              nullptr);
+    break;
+  }
+  case OpCodes::OR_IMMEDIATE: {
+    DECODE(OR_IMMEDIATE);
+    blend_int(LANE_GP(p.destination), LANE_GP(p.source1),
+              broadcast<LANES>(uint32_t(p.immediate_value)), select,
+              [](uint32_t a, uint32_t b) { return a | b; },
+              VEC_INT(_mm256_or_si256(a, b)));
+    break;
+  }
+  case OpCodes::AND_IMMEDIATE: {
+    DECODE(AND_IMMEDIATE);
+    blend_int(LANE_GP(p.destination), LANE_GP(p.source1),
+              broadcast<LANES>(uint32_t(p.immediate_value)), select,
+              [](uint32_t a, uint32_t b) { return a & b; },
+              VEC_INT(_mm256_and_si256(a, b)));
+    break;
+  }
+  case OpCodes::XOR_IMMEDIATE: {
+    DECODE(XOR_IMMEDIATE);
+    blend_int(LANE_GP(p.destination), LANE_GP(p.source1),
+              broadcast<LANES>(uint32_t(p.immediate_value)), select,
+              [](uint32_t a, uint32_t b) { return a ^ b; },
+              VEC_INT(_mm256_xor_si256(a, b)));
+    break;
+  }
+  case OpCodes::NOR_IMMEDIATE: {
+    DECODE(NOR_IMMEDIATE);
+    blend_int(LANE_GP(p.destination), LANE_GP(p.source1),
+              broadcast<LANES>(uint32_t(p.immediate_value)), select,
+              [](uint32_t a, uint32_t b) { return ~(a | b); }, nullptr);
+    break;
+  }
+  case OpCodes::NAND_IMMEDIATE: {
+    DECODE(NAND_IMMEDIATE);
+    blend_int(LANE_GP(p.destination), LANE_GP(p.source1),
+              broadcast<LANES>(uint32_t(p.immediate_value)), select,
+              [](uint32_t a, uint32_t b) { return ~(a & b); }, nullptr);
+    break;
+  }
+  case OpCodes::ADD_INT: {
+    DECODE(ADD_INT);
+    blend_int(LANE_GP(p.destination), LANE_GP(p.source1), LANE_GP(p.source2),
+              select, add, VEC_INT(_mm256_add_epi32(a, b)));
+    break;
+  }
+  case OpCodes::SUB_INT: {
+    DECODE(SUB_INT);
+    blend_int(LANE_GP(p.destination), LANE_GP(p.source1), LANE_GP(p.source2),
+              select, sub, VEC_INT(_mm256_sub_epi32(a, b)));
+    break;
+  }
+  case OpCodes::MULT_INT: {
+    DECODE(MULT_INT);
+    blend_int(LANE_GP(p.destination), LANE_GP(p.source1), LANE_GP(p.source2),
+              select, mul, VEC_INT(_mm256_mullo_epi32(a, b)));
+    break;
+  }
+  case OpCodes::DIV_INT: {
+    // NOTE: Only a zero divisor on an active lane traps. Inactive lanes are
+    // computed too and their result is thrown away, a zero divisor there
+    // gives zero.
+    DECODE(DIV_INT);
+    if (zero_lanes(LANE_GP(p.source2))) [[unlikely]] {
+      return Trap::DIVIDE_BY_ZERO;
+    }
+    blend_int(LANE_GP(p.destination), LANE_GP(p.source1), LANE_GP(p.source2),
+              select, div_int, nullptr);
+    break;
+  }
+  case OpCodes::ADD_INT_IMMEDIATE: {
+    DECODE(ADD_INT_IMMEDIATE);
+    blend_int(LANE_GP(p.destination), LANE_GP(p.source),
+              broadcast<LANES>(uint32_t(p.immediate_value)), select, add,
+              VEC_INT(_mm256_add_epi32(a, b)));
+    break;
+  }
+  case OpCodes::SUB_INT_IMMEDIATE: {
+    DECODE(SUB_INT_IMMEDIATE);
+    blend_int(LANE_GP(p.destination), LANE_GP(p.source),
+              broadcast<LANES>(uint32_t(p.immediate_value)), select, sub,
+              VEC_INT(_mm256_sub_epi32(a, b)));
+    break;
+  }
+  case OpCodes::MULT_INT_IMMEDIATE: {
+    DECODE(MULT_INT_IMMEDIATE);
+    blend_int(LANE_GP(p.destination), LANE_GP(p.source),
+              broadcast<LANES>(uint32_t(p.immediate_value)), select, mul,
+              VEC_INT(_mm256_mullo_epi32(a, b)));
+    break;
+  }
+  case OpCodes::DIV_INT_IMMEDIATE: {
+    DECODE(DIV_INT_IMMEDIATE);
+    if (p.immediate_value == 0) [[unlikely]] {
+      return Trap::DIVIDE_BY_ZERO;
+    }
+    blend_int(LANE_GP(p.destination), LANE_GP(p.source),
+              broadcast<LANES>(uint32_t(p.immediate_value)), select, div_int,
+              nullptr);
+    break;
+  }
+  case OpCodes::ADD_FLOAT: {
+    DECODE(ADD_FLOAT);
+    blend_float(LANE_FL(p.destination), LANE_FL(p.source1),
+                LANE_FL(p.source2), select, add,
+                VEC_FLOAT(_mm256_add_ps(a, b)));
+    break;
+  }
+  case OpCodes::SUB_FLOAT: {
+    DECODE(SUB_FLOAT);
+    blend_float(LANE_FL(p.destination), LANE_FL(p.source1),
+                LANE_FL(p.source2), select, sub,
+                VEC_FLOAT(_mm256_sub_ps(a, b)));
+    break;
+  }
+  case OpCodes::MULT_FLOAT: {
+    DECODE(MULT_FLOAT);
+    blend_float(LANE_FL(p.destination), LANE_FL(p.source1),
+                LANE_FL(p.source2), select, mul,
+                VEC_FLOAT(_mm256_mul_ps(a, b)));
+    break;
+  }
+  case OpCodes::DIV_FLOAT: {
+    DECODE(DIV_FLOAT);
+    blend_float(LANE_FL(p.destination), LANE_FL(p.source1),
+                LANE_FL(p.source2), select, div_float,
+                VEC_FLOAT(_mm256_div_ps(a, b)));
+    break;
+  }
+  case OpCodes::ADD_FLOAT_IMMEDIATE: {
+    DECODE(ADD_FLOAT_IMMEDIATE);
+    blend_float(LANE_FL(p.destination), LANE_FL(p.source),
+                broadcast<LANES>(float(p.immediate_value)), select, add,
+                VEC_FLOAT(_mm256_add_ps(a, b)));
+    break;
+  }
+  case OpCodes::SUB_FLOAT_IMMEDIATE: {
+    DECODE(SUB_FLOAT_IMMEDIATE);
+    blend_float(LANE_FL(p.destination), LANE_FL(p.source),
+                broadcast<LANES>(float(p.immediate_value)), select, sub,
+                VEC_FLOAT(_mm256_sub_ps(a, b)));
+    break;
+  }
+  case OpCodes::MULT_FLOAT_IMMEDIATE: {
+    DECODE(MULT_FLOAT_IMMEDIATE);
+    blend_float(LANE_FL(p.destination), LANE_FL(p.source),
+                broadcast<LANES>(float(p.immediate_value)), select, mul,
+                VEC_FLOAT(_mm256_mul_ps(a, b)));
+    break;
+  }
+  case OpCodes::DIV_FLOAT_IMMEDIATE: {
+    DECODE(DIV_FLOAT_IMMEDIATE);
+    blend_float(LANE_FL(p.destination), LANE_FL(p.source),
+                broadcast<LANES>(float(p.immediate_value)), select, div_float,
+                VEC_FLOAT(_mm256_div_ps(a, b)));
+    break;
+  }
+  case OpCodes::COMPARE: {
+    DECODE(COMPARE);
+    compare(LANE_GP(p.register1), LANE_GP(p.register2));
+    break;
+  }
+  case OpCodes::COMPARE_FLOAT: {
+    DECODE(COMPARE_FLOAT);
+    compare(LANE_FL(p.register1), LANE_FL(p.register2));
+    break;
+  }
+  case OpCodes::JUMP: {
+    DECODE(JUMP);
+    return branch(taken_if(always),
+                  broadcast<LANES>(uint32_t(p.jump_address)));
+  }
+  case OpCodes::JUMP_ZERO: {
+    DECODE(JUMP_ZERO);
+    return branch(taken_if(if_zero),
+                  broadcast<LANES>(uint32_t(p.jump_address)));
+  }
+  case OpCodes::JUMP_EQUAL: {
+    DECODE(JUMP_EQUAL);
+    return branch(taken_if(if_zero),
+                  broadcast<LANES>(uint32_t(p.jump_address)));
+  }
+  case OpCodes::JUMP_LESS_THAN: {
+    DECODE(JUMP_LESS_THAN);
+    return branch(taken_if(if_less),
+                  broadcast<LANES>(uint32_t(p.jump_address)));
+  }
+  case OpCodes::JUMP_GREATER_THAN: {
+    DECODE(JUMP_GREATER_THAN);
+    return branch(taken_if(if_greater),
+                  broadcast<LANES>(uint32_t(p.jump_address)));
+  }
+  case OpCodes::JUMP_REGISTER: {
+    DECODE(JUMP_REGISTER);
+    return branch(taken_if(always), LANE_GP(p.jump_register));
+  }
+  case OpCodes::JUMP_REGISTER_ZERO: {
+    DECODE(JUMP_REGISTER_ZERO);
+    return branch(taken_if(if_zero), LANE_GP(p.jump_register));
+  }
+  case OpCodes::JUMP_REGISTER_EQUAL: {
+    DECODE(JUMP_REGISTER_EQUAL);
+    return branch(taken_if(if_zero), LANE_GP(p.jump_register));
+  }
+  case OpCodes::JUMP_REGISTER_LESS_THAN: {
+    DECODE(JUMP_REGISTER_LESS_THAN);
+    return branch(taken_if(if_less), LANE_GP(p.jump_register));
+  }
+  case OpCodes::JUMP_REGISTER_GREATER_THAN: {
+    DECODE(JUMP_REGISTER_GREATER_THAN);
+    return branch(taken_if(if_greater), LANE_GP(p.jump_register));
+  }
+  case OpCodes::HALT: {
+    m_halted |= active;
+    return Trap::NONE;
+  }
+  // NOTE: Includes the instructions not supported in wide mode.
+  default:
+    return Trap::INVALID_INSTRUCTION;
+  }
+
+#undef DECODE
+#undef CHECK_ADDRESS
+
+  return branch(0, pcs);
+}
+
+#undef LANE_GP
+#undef LANE_FL
+#undef VEC_INT
+#undef VEC_FLOAT
+
+template class WideInterpreter<8>;
+template class WideInterpreter<16>;